@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+
+// SPRITE ATLAS
+// all sprites share one allocation, each one's native pixels followed by its alpha,
+// laid out in id order so the sprites drawn every frame sit next to each other. every
+// sprite keeps its own size; nothing assumes that images of one kind match. a group
+// of recolourings (the cars) is stored once as palette indices, with a palette per
+// colour, when the images allow it.
+
+typedef struct {
+    const uint8_t *rgba;
+    int width;
+    int height;
+} AtlasSource;
+
+typedef struct {
+    SpriteId first;
+    int count;
+    int colors; // shared palette size, 0 = stored as separate sprites
+} AtlasGroup;
+
+#define ATLAS_MAX_GROUPS 4
+
+static AtlasSource sources[SPRITE_COUNT];
+static AtlasGroup groups[ATLAS_MAX_GROUPS];
+static int num_groups = 0;
+static AtlasEntry entries[SPRITE_COUNT];
+static uint8_t *block = NULL;
+static size_t block_size = 0;
+
+static size_t align_up(size_t n) {
+    return (n + ATLAS_ALIGN - 1) & ~(size_t)(ATLAS_ALIGN - 1);
+}
+
+void atlas_add(SpriteId id, const uint8_t *rgba, int width, int height,
+               int pivot_x, int pivot_y, SpriteRect hitbox) {
+    if (id >= SPRITE_COUNT) return;
+    sources[id] = (AtlasSource){ rgba, width, height };
+    entries[id].pivot_x = pivot_x;
+    entries[id].pivot_y = pivot_y;
+    entries[id].hitbox = hitbox;
+}
+
+void atlas_group(SpriteId first, int count) {
+    if (num_groups == ATLAS_MAX_GROUPS || first + count > SPRITE_COUNT) return;
+    groups[num_groups++] = (AtlasGroup){ first, count, 0 };
+}
+
+// the group id belongs to, if it is stored indexed
+static const AtlasGroup *indexed_group(int id) {
+    for (int g = 0; g < num_groups; g++) {
+        if (groups[g].colors && id >= groups[g].first && id < groups[g].first + groups[g].count) {
+            return &groups[g];
+        }
+    }
+    return NULL;
+}
+
+// the group's images, 0 if they are not all there and the same size
+static int group_images(const AtlasGroup *g, const uint8_t **rgba) {
+    if (g->count > SPRITE_MAX_VARIANTS) return 0;
+    for (int v = 0; v < g->count; v++) {
+        const AtlasSource *src = &sources[g->first + v];
+        if (!src->rgba || src->width != sources[g->first].width || src->height != sources[g->first].height) {
+            return 0;
+        }
+        rgba[v] = src->rgba;
+    }
+    return 1;
+}
+
+// can the group share one index map
+static int group_colors(const AtlasGroup *g) {
+    const uint8_t *rgba[SPRITE_MAX_VARIANTS];
+    if (!group_images(g, rgba)) return 0;
+    int colors = sprite_variant_colors(rgba, g->count, sources[g->first].width, sources[g->first].height);
+    return colors > 0 ? colors : 0;
+}
+
+int atlas_pack(PixelFormat format) {
+    atlas_free();
+
+    const uint8_t *rgba[SPRITE_MAX_VARIANTS];
+    size_t total = 0;
+    for (int g = 0; g < num_groups; g++) {
+        AtlasGroup *group = &groups[g];
+        group->colors = group_colors(group);
+        if (group->colors) {
+            const AtlasSource *src = &sources[group->first];
+            total += align_up(sprite_variant_storage(group->count, src->width, src->height, group->colors, format));
+        }
+    }
+    for (int id = 0; id < SPRITE_COUNT; id++) {
+        if (sources[id].rgba && !indexed_group(id)) {
+            total += align_up(sprite_storage(sources[id].width, sources[id].height, format));
+        }
+    }
+    block = (uint8_t *)aligned_alloc(ATLAS_ALIGN, total ? total : ATLAS_ALIGN);
+    if (!block) return -1;
+    block_size = total;
+
+    size_t offset = 0;
+    for (int id = 0; id < SPRITE_COUNT; id++) {
+        const AtlasSource *src = &sources[id];
+        if (!src->rgba) continue;
+
+        const AtlasGroup *group = indexed_group(id);
+        if (!group) {
+            sprite_convert(&entries[id].sprite, src->rgba, src->width, src->height, format, block + offset);
+            offset += align_up(sprite_storage(src->width, src->height, format));
+        } else if (id == group->first) {
+            Sprite variants[SPRITE_MAX_VARIANTS];
+            group_images(group, rgba);
+            sprite_convert_variants(variants, rgba, group->count, src->width, src->height,
+                                    group->colors, format, block + offset);
+            for (int v = 0; v < group->count; v++) entries[id + v].sprite = variants[v];
+            offset += align_up(sprite_variant_storage(group->count, src->width, src->height,
+                                                      group->colors, format));
+        }
+    }
+    return 0;
+}
+
+int atlas_group_colors(SpriteId first) {
+    for (int g = 0; g < num_groups; g++) {
+        if (groups[g].first == first) return groups[g].colors;
+    }
+    return 0;
+}
+
+void atlas_free(void) {
+    free(block);
+    block = NULL;
+    block_size = 0;
+    for (int id = 0; id < SPRITE_COUNT; id++) {
+        memset(&entries[id].sprite, 0, sizeof(Sprite));
+    }
+}
+
+const AtlasEntry *atlas_entry(SpriteId id) {
+    static const AtlasEntry none;
+    return id < SPRITE_COUNT ? &entries[id] : &none;
+}
+
+const Sprite *atlas_sprite(SpriteId id) {
+    return &atlas_entry(id)->sprite;
+}
+
+void atlas_draw(SpriteId id, int x, int y, int flip) {
+    const AtlasEntry *e = atlas_entry(id);
+    sprite_draw(&e->sprite, x - e->pivot_x, y - e->pivot_y, flip);
+}
+
+size_t atlas_bytes(void) {
+    return block_size;
+}
@@ -0,0 +1,58 @@
+// atlas.h -- every game sprite packed into one block, with per-sprite metadata, by compact id
+
+#include <stddef.h>
+#include <stdint.h>
+#include "declarations.h"
+#include "sprite.h"
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+// sprite ids, in the order the atlas stores them (hot sprites first, popups last)
+enum {
+    SPRITE_PLAYER = 0,
+    SPRITE_CAR0,
+    SPRITE_TRAIN = SPRITE_CAR0 + NUM_CAR_SPRITES,
+    SPRITE_SPECIAL0,
+    SPRITE_INTRO0 = SPRITE_SPECIAL0 + TYPE_COUNT,
+    SPRITE_END0 = SPRITE_INTRO0 + NUM_LEVELS,
+    SPRITE_COUNT = SPRITE_END0 + NUM_LEVELS
+};
+typedef uint8_t SpriteId;
+
+#define ATLAS_ALIGN 16 // each sprite's pixels start on this boundary
+
+typedef struct {
+    Sprite sprite;      // pixels and alpha point into the atlas (empty if the image is missing)
+    int pivot_x;        // the point of the sprite placed at the position it is drawn at
+    int pivot_y;
+    SpriteRect hitbox;  // the part that collides, from the top left corner (w = 0: never)
+} AtlasEntry;
+
+// register a sprite's source image before packing. rgba NULL = missing asset, the id
+// then draws nothing. the image only has to stay valid until atlas_pack
+void atlas_add(SpriteId id, const uint8_t *rgba, int width, int height,
+               int pivot_x, int pivot_y, SpriteRect hitbox);
+
+// mark ids first .. first + count - 1 (already added) as recolourings of one shape.
+// if their images are the same size and have few enough colour combinations they are
+// packed as one shared index map plus a small palette each
+void atlas_group(SpriteId first, int count);
+
+// convert everything registered into one allocation in format. -1 if out of memory
+int atlas_pack(PixelFormat format);
+
+// palette size the group starting at first was packed with, 0 = stored as separate sprites
+int atlas_group_colors(SpriteId first);
+void atlas_free(void);
+
+const AtlasEntry *atlas_entry(SpriteId id);
+const Sprite *atlas_sprite(SpriteId id);
+
+// draw a sprite with its pivot at screen (x, y)
+void atlas_draw(SpriteId id, int x, int y, int flip);
+
+// bytes the packed atlas occupies
+size_t atlas_bytes(void);
+
+#endif
@@ -0,0 +1,766 @@
+// bench.c -- timing of the game's hot paths, run from the repo root
+//
+//   make bench
+//   ./bench            (every benchmark)
+//   ./bench rewind     (just the named ones: rewind, upscale, fbcopy, blit, raster)
+//
+// like seedminer it mostly needs sprite sizes (blit and raster load a few sprites), so
+// it runs on a laptop or on the board.
+// fbcopy and raster write into /dev/fb0 when they can open it, scribbling over the console.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+
+#include "declarations.h"
+#include "vehicle.h"
+#include "level.h"
+#include "rewind.h"
+#include "solver.h"
+#include "upscale.h"
+#include "fb_copy.h"
+#include "sprite.h"
+#include "atlas.h"
+#include "raster.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+/******** HELPERS ********/
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// generation only needs sprite sizes, not pixels (keep paths in sync with main.c)
+static int load_sizes(void) {
+    int n;
+    if (!stbi_info("assets/guy1.png", &img_width, &img_height, &n) ||
+        !stbi_info("assets/car1.png", &car_width, &car_height, &n) ||
+        !stbi_info("assets/T2.png", &train_width, &train_height, &n) ||
+        !stbi_info("assets/bus2.png", &special_w[BUS], &special_h[BUS], &n)) {
+        fprintf(stderr, "Error: could not read sprite sizes from assets/\n");
+        return -1;
+    }
+
+    // spawn_special_in_lane only checks that the bus sprite exists
+    static unsigned char present;
+    special_data[BUS] = &present;
+    num_lane_types = 6;
+    return 0;
+}
+
+// one game tick without input or drawing
+static void sim_tick(void) {
+    update_cars();
+    update_trains();
+    update_specials();
+}
+
+/******** REWIND ********/
+
+#define REWIND_BENCH_TICKS 6000
+#define HISTORY (REWIND_MAX_FRAMES + 1)
+
+// flip words of the world in place (a second call puts them back): 300 to 900 of
+// them from a place that moves every tick, so deltas are big and uneven in size
+static void scramble_world(int f) {
+    uint32_t *w = (uint32_t *)&world;
+    size_t words = sizeof(World) / sizeof(uint32_t);
+    size_t len = 300 + (size_t)(f * 7919) % 601;
+    if (len > words) len = words;
+    size_t start = (size_t)(f * 104729) % (words - len + 1);
+    for (size_t i = 0; i < len; i++) w[start + i] ^= 0x9E3779B9u * (uint32_t)(i + 1);
+}
+
+// record REWIND_BENCH_TICKS ticks then scrub all the way back, checking every frame.
+// scramble_every > 0 records a scrambled world every that many ticks, which fills
+// the ring well before REWIND_MAX_FRAMES and makes it wrap with laps of any length
+static void rewind_case(const char *name, int scramble_every) {
+    // the busiest level, with a player hopping about so their fields change too
+    generate_level(NUM_LEVELS - 1, 12345);
+    rewind_reset();
+
+    // full copies of the most recent ticks, to check every restored frame
+    GameFrame *history = malloc(sizeof(GameFrame) * HISTORY);
+    if (!history) {
+        perror("malloc history");
+        return;
+    }
+
+    double record_ns = 0;
+    for (int f = 0; f < REWIND_BENCH_TICKS; f++) {
+        sim_tick();
+        if (f % 12 == 0) image_x_pos = (image_x_pos + MOVE_STEP) % (screen_width - img_width);
+        if (f % 30 == 0) camera_y = (camera_y + LANE_HEIGHT) % (total_lanes_current * LANE_HEIGHT);
+        int scrambled = scramble_every > 0 && f % scramble_every == 0;
+        if (scrambled) scramble_world(f);
+
+        double t0 = now_ns();
+        rewind_record();
+        record_ns += now_ns() - t0;
+
+        GameFrame *h = &history[f % HISTORY];
+        rewind_capture(h);
+        if (scrambled) scramble_world(f); // the game carries on from the real world
+    }
+
+    int kept = rewind_frames();
+    size_t used = rewind_bytes_used();
+
+    // scrub all the way back, comparing against the full copies
+    double step_ns = 0;
+    int steps = 0, mismatches = 0;
+    for (int f = REWIND_BENCH_TICKS - 2; f >= REWIND_BENCH_TICKS - 1 - kept; f--) {
+        double t0 = now_ns();
+        if (!rewind_step()) break;
+        step_ns += now_ns() - t0;
+        steps++;
+
+        if (f < 0) continue; // back to the level's starting state
+        const GameFrame *h = &history[f % HISTORY];
+        if (memcmp(&h->world, &world, sizeof(World)) != 0 || h->camera_y != camera_y ||
+            h->image_x_pos != image_x_pos || h->player_facing_left != player_facing_left) {
+            mismatches++;
+        }
+    }
+    free(history);
+
+    double frame_mb = sizeof(GameFrame) / 1e6;
+    printf("rewind%s: frame %zu bytes, %d ticks kept (%.1f s at 60 Hz) in %zu of %d bytes\n",
+           name, sizeof(GameFrame), kept, kept / 60.0, used, REWIND_BUFFER_BYTES);
+    printf("rewind%s: avg delta %.0f bytes (%.1fx smaller than a full frame)\n",
+           name, (double)used / kept, (double)sizeof(GameFrame) * kept / used);
+    printf("rewind%s: record %.0f ns/tick (%.0f MB/s of frames)\n",
+           name, record_ns / REWIND_BENCH_TICKS, frame_mb * REWIND_BENCH_TICKS / (record_ns / 1e9));
+    printf("rewind%s: step   %.0f ns/tick (%.0f MB/s of frames), %d steps, %d mismatches\n",
+           name, step_ns / steps, frame_mb * steps / (step_ns / 1e9), steps, mismatches);
+}
+
+static void bench_rewind(void) {
+    rewind_case("", 0);
+    rewind_case(" (large deltas)", 5);
+}
+
+/******** SOLVER ********/
+
+#define SOLVER_BENCH_SEEDS 300
+
+// what prepare_level pays per attempt when there is no catalog, against the budget it
+// gives each level (run it on the board)
+static void bench_solve(void) {
+    for (int level = 0; level < NUM_LEVELS; level++) {
+        long total_us = 0, worst_us = 0, budget = 0;
+        int over = 0, crossable = 0;
+        for (int s = 0; s < SOLVER_BENCH_SEEDS; s++) {
+            generate_level(level, (uint32_t)s + 1);
+            budget = solver_budget_us(total_lanes_current);
+            SolveResult r;
+            crossable += solve_level(&r, SOLVER_NO_BUDGET) == 1;
+            total_us += r.elapsed_us;
+            if (r.elapsed_us > worst_us) worst_us = r.elapsed_us;
+            over += r.elapsed_us > budget;
+        }
+        printf("solve: level %d (%d lanes) avg %ld us, max %ld us, budget %ld us (%d over), "
+               "%d of %d crossable\n", level + 1, total_lanes_current,
+               total_us / SOLVER_BENCH_SEEDS, worst_us, budget, over, crossable, SOLVER_BENCH_SEEDS);
+    }
+}
+
+/******** UPSCALE ********/
+
+#define UPSCALE_BENCH_FRAMES 200
+#define HDMI_W 1920
+#define HDMI_H 1080
+
+static uint8_t *upscale_dst = NULL;
+static size_t upscale_dst_stride = 0;
+
+static void *upscale_dst_row(int y) {
+    return y < HDMI_H ? upscale_dst + (size_t)y * upscale_dst_stride : NULL;
+}
+
+// ms per frame to scale a 480x272 frame by `scale` into a 1080p sized buffer
+static double time_upscale(const uint8_t *src, int bytes, int scale, UpscaleFilter filter) {
+    double t0 = now_ns();
+    for (int f = 0; f < UPSCALE_BENCH_FRAMES; f++) {
+        upscale_frame(src, (size_t)screen_width * bytes, screen_width, screen_height, bytes,
+                      scale, filter, upscale_dst_row);
+    }
+    return (now_ns() - t0) / 1e6 / UPSCALE_BENCH_FRAMES;
+}
+
+static void bench_upscale(void) {
+    int bytes = 2;
+    upscale_dst_stride = (size_t)HDMI_W * bytes;
+    upscale_dst = (uint8_t *)calloc(HDMI_H, upscale_dst_stride);
+    uint16_t *src = (uint16_t *)malloc((size_t)screen_width * screen_height * bytes);
+    uint16_t *full = (uint16_t *)malloc((size_t)HDMI_W * HDMI_H * bytes);
+    if (!upscale_dst || !src || !full) {
+        fprintf(stderr, "upscale: out of memory\n");
+        return;
+    }
+    for (int i = 0; i < screen_width * screen_height; i++) {
+        src[i] = (uint16_t)((i / 7) * 2654435761u >> 16); // runs of equal pixels, like sprites
+    }
+
+    // what drawing the background natively at 1080p costs (one row copy per row)
+    double t0 = now_ns();
+    for (int f = 0; f < UPSCALE_BENCH_FRAMES; f++) {
+        for (int y = 0; y < HDMI_H; y++) {
+            memcpy(upscale_dst_row(y), full + (size_t)y * HDMI_W, upscale_dst_stride);
+        }
+    }
+    double native_ms = (now_ns() - t0) / 1e6 / UPSCALE_BENCH_FRAMES;
+
+    double x1 = time_upscale((const uint8_t *)src, bytes, 1, UPSCALE_NEAREST);
+    double x2 = time_upscale((const uint8_t *)src, bytes, 2, UPSCALE_NEAREST);
+    double epx = time_upscale((const uint8_t *)src, bytes, 2, UPSCALE_SCALE2X);
+    double x3 = time_upscale((const uint8_t *)src, bytes, 3, UPSCALE_NEAREST);
+
+    // nearest must reproduce every source pixel as a whole block
+    int scale = upscale_factor(screen_width, screen_height, HDMI_W, HDMI_H);
+    time_upscale((const uint8_t *)src, bytes, scale, UPSCALE_NEAREST);
+    int mismatches = 0;
+    for (int y = 0; y < screen_height * scale; y++) {
+        const uint16_t *row = (const uint16_t *)upscale_dst_row(y);
+        for (int x = 0; x < screen_width * scale; x++) {
+            if (row[x] != src[(y / scale) * screen_width + x / scale]) mismatches++;
+        }
+    }
+
+    printf("upscale: %dx%d rgb565, 1080p native row copy %.3f ms/frame\n",
+           screen_width, screen_height, native_ms);
+    printf("upscale: x1 %.3f  x2 %.3f  scale2x %.3f  x3 %.3f ms/frame\n", x1, x2, epx, x3);
+    printf("upscale: x%d nearest %d mismatches\n", scale, mismatches);
+
+    free(full);
+    free(src);
+    free(upscale_dst);
+    upscale_dst = NULL;
+}
+
+/******** FBCOPY ********/
+
+// /dev/fb0 mapped for writing, NULL if there is none (*size is then left alone).
+// *size gets the bytes of the visible screen, *stride those of a row
+static uint8_t *map_fb0(int *fd, size_t *size, size_t *stride, int *bpp) {
+    uint8_t *fb = NULL;
+    *fd = open("/dev/fb0", O_RDWR);
+    if (*fd < 0) return NULL;
+
+    struct fb_var_screeninfo v;
+    struct fb_fix_screeninfo fix;
+    if (ioctl(*fd, FBIOGET_VSCREENINFO, &v) == 0 && ioctl(*fd, FBIOGET_FSCREENINFO, &fix) == 0) {
+        fb = (uint8_t *)mmap(NULL, (size_t)fix.line_length * v.yres, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, *fd, 0);
+        if (fb == MAP_FAILED) {
+            fb = NULL;
+        } else {
+            *size = (size_t)fix.line_length * v.yres;
+            *stride = fix.line_length;
+            *bpp = (int)v.bits_per_pixel;
+        }
+    }
+    return fb;
+}
+
+#define FBCOPY_BENCH_FRAMES 200
+
+// ms per copy of size bytes into dst
+static double time_copy(void (*copy)(void *, const void *, size_t), uint8_t *dst,
+                        const uint8_t *src, size_t size) {
+    double t0 = now_ns();
+    for (int f = 0; f < FBCOPY_BENCH_FRAMES; f++) {
+        copy(dst, src, size);
+    }
+    return (now_ns() - t0) / 1e6 / FBCOPY_BENCH_FRAMES;
+}
+
+static void libc_memcpy(void *dst, const void *src, size_t n) {
+    memcpy(dst, src, n);
+}
+
+static void bench_fbcopy(void) {
+    // the real mapping if there is one (that is what the copy is for), plain ram otherwise
+    size_t size = (size_t)screen_width * screen_height * 2;
+    size_t stride;
+    int fd, bpp;
+    uint8_t *dst = map_fb0(&fd, &size, &stride, &bpp);
+    int mapped = dst != NULL;
+    if (!mapped) dst = (uint8_t *)malloc(size);
+
+    uint8_t *src = (uint8_t *)malloc(size + FB_COPY_BURST);
+    if (!dst || !src) {
+        fprintf(stderr, "fbcopy: out of memory\n");
+        goto done;
+    }
+    for (size_t i = 0; i < size + FB_COPY_BURST; i++) {
+        src[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+
+    double libc_ms = time_copy(libc_memcpy, dst, src, size);
+    double fb_ms = time_copy(fb_copy, dst, src, size);
+
+    // every alignment of both ends against a plain copy into ram
+    int mismatches = 0;
+    uint8_t *check = (uint8_t *)malloc(4 * FB_COPY_BURST + 64);
+    for (int off = 0; check && off < FB_COPY_BURST; off += 2) {
+        for (int len = 0; len <= 3 * FB_COPY_BURST; len += 2) {
+            memset(check, 0xAA, 4 * FB_COPY_BURST + 64);
+            fb_copy(check + off, src + off, (size_t)len);
+            for (int i = 0; i < 4 * FB_COPY_BURST + 64; i++) {
+                int inside = i >= off && i < off + len;
+                if (check[i] != (inside ? src[i] : 0xAA)) mismatches++;
+            }
+        }
+    }
+    free(check);
+
+    printf("fbcopy: %zu bytes into %s\n", size, mapped ? "/dev/fb0" : "ram (no /dev/fb0)");
+    printf("fbcopy: memcpy %.3f ms (%.0f MB/s)  fb_copy %.3f ms (%.0f MB/s), %d mismatches\n",
+           libc_ms, size / 1e3 / libc_ms, fb_ms, size / 1e3 / fb_ms, mismatches);
+
+done:
+    free(src);
+    if (mapped) munmap(dst, size);
+    else free(dst);
+    if (fd >= 0) close(fd);
+}
+
+/******** BLIT ********/
+
+#define BLIT_BENCH_FRAMES 500
+#define BLIT_BENCH_SPRITES 4
+
+// sprite.c and raster.c draw through these: into the raster bench's target, nowhere
+// otherwise (the blit bench calls the kernels directly)
+static uint8_t *draw_target = NULL;
+static size_t draw_stride = 0;
+
+void *framebuffer_row(int y) {
+    if (!draw_target || y < 0 || y >= screen_height) return NULL;
+    return draw_target + (size_t)y * draw_stride;
+}
+
+void framebuffer_dirty(int x, int y, int w, int h) {
+    (void)x; (void)y; (void)w; (void)h;
+}
+
+int display_pixel_format(void) {
+    return PIXEL_RGB565;
+}
+
+// what the kernels did before alpha blending: copy a pixel if it is mostly opaque
+static void threshold_blit16(void *dst, const void *src, const uint8_t *alpha, int n,
+                             int src_step) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    for (int i = 0; i < n; i++, s += src_step, alpha += src_step) {
+        if (*alpha >= 128) d[i] = *s;
+    }
+}
+
+// every sprite over the whole screen on a grid, every other column mirrored
+static void blit_scene(uint16_t *fb, const Sprite *sprites, int count, PixelBlitFn blit) {
+    for (int i = 0; i < count; i++) {
+        const Sprite *s = &sprites[i];
+        SpriteRect b = s->bounds;
+        for (int x = 0, col = 0; x + s->width <= screen_width; x += 53, col++) {
+            int step = (col & 1) ? -1 : 1;
+            int first = step > 0 ? b.x : b.x + b.w - 1;
+            for (int y = 0; y + s->height <= screen_height; y += 31) {
+                for (int r = b.y; r < b.y + b.h; r++) {
+                    size_t src = (size_t)r * s->width + first;
+                    blit(fb + (size_t)(y + r) * screen_width + x + b.x, s->pixels + src * 2,
+                         s->alpha + src, b.w, step);
+                }
+            }
+        }
+    }
+}
+
+static double time_blit(uint16_t *fb, const Sprite *sprites, int count, PixelBlitFn blit) {
+    double t0 = now_ns();
+    for (int f = 0; f < BLIT_BENCH_FRAMES; f++) {
+        blit_scene(fb, sprites, count, blit);
+    }
+    return (now_ns() - t0) / 1e6 / BLIT_BENCH_FRAMES;
+}
+
+#define RAMP_WIDTH 83 // not a whole number of eight pixel runs
+#define RAMP_ROWS 3
+#define RAMP_VARIANTS 2
+
+// a sprite with every kind of alpha over changing colours: a row of whole transparent
+// and opaque runs then a ramp, a smooth ramp, and scattered alphas
+static void ramp_image(uint8_t *rgba, int variant) {
+    for (int y = 0; y < RAMP_ROWS; y++) {
+        for (int x = 0; x < RAMP_WIDTH; x++) {
+            uint8_t *p = rgba + ((size_t)y * RAMP_WIDTH + x) * 4;
+            int a;
+            if (y == 0) a = x < 24 ? 0 : x < 48 ? 255 : (x - 48) * 7;
+            else if (y == 1) a = x * 255 / (RAMP_WIDTH - 1);
+            else a = (x * 97 + 31) & 255;
+            p[0] = (uint8_t)(x * 29 + variant * 80);
+            p[1] = (uint8_t)(x * 13 + y * 70);
+            p[2] = (uint8_t)(255 - x * 3 - variant * 40);
+            p[3] = (uint8_t)a;
+        }
+    }
+}
+
+// the channels of a pixel in format, at their own width (5, 6 or 8 bits)
+static void unpack(PixelFormat format, const uint8_t *p, int c[3]) {
+    if (pixel_bytes(format) == 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        c[0] = (v >> 16) & 0xFF;
+        c[1] = (v >> 8) & 0xFF;
+        c[2] = v & 0xFF;
+        return;
+    }
+    uint16_t v;
+    memcpy(&v, p, 2);
+    if (format == PIXEL_RGB565_SWAPPED) v = (uint16_t)((v << 8) | (v >> 8));
+    c[0] = v >> 11;
+    c[1] = (v >> 5) & 0x3F;
+    c[2] = v & 0x1F;
+}
+
+// blit one row of s over bg both ways round. counts channels more than 1 off the exact
+// premultiplied blend, and mirrored pixels that differ from the unmirrored ones (only
+// unmirrored runs take the vector path, so that holds it to the scalar one)
+static void check_row(const Sprite *s, int row, const uint8_t *bg, int *errors, int *mirrored) {
+    PixelFormat format = s->format;
+    int bytes = pixel_bytes(format);
+    uint8_t fwd[RAMP_WIDTH * 4], back[RAMP_WIDTH * 4];
+    memcpy(fwd, bg, (size_t)RAMP_WIDTH * bytes);
+    for (int x = 0; x < RAMP_WIDTH; x++) {
+        memcpy(back + (size_t)x * bytes, bg + (size_t)(RAMP_WIDTH - 1 - x) * bytes, bytes);
+    }
+
+    size_t first = (size_t)row * RAMP_WIDTH, last = first + RAMP_WIDTH - 1;
+    if (s->indices) {
+        PixelIndexedBlitFn blit = pixel_indexed_blit_kernel(format);
+        blit(fwd, s->indices + first, s->palette, s->palette_alpha, RAMP_WIDTH, 1);
+        blit(back, s->indices + last, s->palette, s->palette_alpha, RAMP_WIDTH, -1);
+    } else {
+        PixelBlitFn blit = pixel_blit_kernel(format);
+        blit(fwd, s->pixels + first * bytes, s->alpha + first, RAMP_WIDTH, 1);
+        blit(back, s->pixels + last * bytes, s->alpha + last, RAMP_WIDTH, -1);
+    }
+
+    for (int x = 0; x < RAMP_WIDTH; x++) {
+        const uint8_t *src;
+        int a;
+        if (s->indices) {
+            int k = s->indices[first + x];
+            src = s->palette + (size_t)k * bytes;
+            a = s->palette_alpha[k];
+        } else {
+            src = s->pixels + (first + x) * bytes;
+            a = s->alpha[first + x];
+        }
+        int sc[3], dc[3], oc[3];
+        unpack(format, src, sc);
+        unpack(format, bg + (size_t)x * bytes, dc);
+        unpack(format, fwd + (size_t)x * bytes, oc);
+        for (int c = 0; c < 3; c++) {
+            double exact = sc[c] + dc[c] * (255 - a) / 255.0;
+            *errors += oc[c] > exact + 1 || oc[c] < exact - 1;
+        }
+        *mirrored += memcmp(back + (size_t)(RAMP_WIDTH - 1 - x) * bytes, fwd + (size_t)x * bytes,
+                            bytes) != 0;
+    }
+}
+
+// every kernel, plain and through a palette, against the exact blend of a ramp
+static void check_blend(void) {
+    uint8_t ramp[RAMP_VARIANTS][RAMP_WIDTH * RAMP_ROWS * 4];
+    const uint8_t *images[RAMP_VARIANTS];
+    for (int v = 0; v < RAMP_VARIANTS; v++) {
+        ramp_image(ramp[v], v);
+        images[v] = ramp[v];
+    }
+    int colors = sprite_variant_colors(images, RAMP_VARIANTS, RAMP_WIDTH, RAMP_ROWS);
+    if (colors < 0) {
+        fprintf(stderr, "blit: ramp has too many colours\n");
+        return;
+    }
+
+    for (int f = 0; f < PIXEL_FORMATS; f++) {
+        uint8_t bg[RAMP_WIDTH * 4];
+        int bytes = pixel_bytes(f);
+        for (int x = 0; x < RAMP_WIDTH; x++) {
+            uint32_t c = pixel_pack(f, (uint8_t)(x * 71), (uint8_t)(255 - x * 5), (uint8_t)(x * 151 + 9));
+            if (bytes == 2) {
+                uint16_t c16 = (uint16_t)c;
+                memcpy(bg + (size_t)x * 2, &c16, 2);
+            } else {
+                memcpy(bg + (size_t)x * 4, &c, 4);
+            }
+        }
+
+        Sprite plain, indexed[RAMP_VARIANTS];
+        uint8_t *plain_storage = (uint8_t *)malloc(sprite_storage(RAMP_WIDTH, RAMP_ROWS, f));
+        uint8_t *indexed_storage = (uint8_t *)malloc(
+            sprite_variant_storage(RAMP_VARIANTS, RAMP_WIDTH, RAMP_ROWS, colors, f));
+        if (!plain_storage || !indexed_storage) {
+            fprintf(stderr, "blit: out of memory\n");
+            free(plain_storage);
+            free(indexed_storage);
+            return;
+        }
+        sprite_convert(&plain, ramp[0], RAMP_WIDTH, RAMP_ROWS, f, plain_storage);
+        sprite_convert_variants(indexed, images, RAMP_VARIANTS, RAMP_WIDTH, RAMP_ROWS, colors, f,
+                                indexed_storage);
+
+        int errors = 0, mirrored = 0, indexed_errors = 0, indexed_mirrored = 0;
+        for (int y = 0; y < RAMP_ROWS; y++) {
+            check_row(&plain, y, bg, &errors, &mirrored);
+            for (int v = 0; v < RAMP_VARIANTS; v++) {
+                check_row(&indexed[v], y, bg, &indexed_errors, &indexed_mirrored);
+            }
+        }
+        printf("blit: %-14s ramp %d channels off by more than 1, %d mirrored pixels differ;"
+               " indexed %d, %d\n", pixel_format_name(f), errors, mirrored, indexed_errors,
+               indexed_mirrored);
+        free(plain_storage);
+        free(indexed_storage);
+    }
+}
+
+static void bench_blit(void) {
+    static const char *files[BLIT_BENCH_SPRITES] = {
+        "assets/guy1.png", "assets/car1.png", "assets/T2.png", "assets/bus2.png",
+    };
+    Sprite sprites[BLIT_BENCH_SPRITES];
+    uint8_t *storage[BLIT_BENCH_SPRITES] = { NULL };
+    size_t pixels = (size_t)screen_width * screen_height;
+    uint16_t *blend_fb = (uint16_t *)malloc(pixels * 2);
+    uint16_t *threshold_fb = (uint16_t *)malloc(pixels * 2);
+    int count = 0, edges = 0, drawn = 0;
+    if (!blend_fb || !threshold_fb) {
+        fprintf(stderr, "blit: out of memory\n");
+        goto done;
+    }
+
+    for (; count < BLIT_BENCH_SPRITES; count++) {
+        int w, h, n;
+        uint8_t *rgba = stbi_load(files[count], &w, &h, &n, 4);
+        if (rgba) storage[count] = (uint8_t *)malloc(sprite_storage(w, h, PIXEL_RGB565));
+        if (!storage[count]) {
+            fprintf(stderr, "blit: could not load %s\n", files[count]);
+            stbi_image_free(rgba);
+            goto done;
+        }
+        sprite_convert(&sprites[count], rgba, w, h, PIXEL_RGB565, storage[count]);
+        for (int i = 0; i < w * h; i++) {
+            drawn += rgba[i * 4 + 3] != 0;
+            edges += rgba[i * 4 + 3] != 0 && rgba[i * 4 + 3] != 255;
+        }
+        stbi_image_free(rgba);
+    }
+
+    for (size_t i = 0; i < pixels; i++) blend_fb[i] = threshold_fb[i] = (uint16_t)(i * 40503u);
+    double threshold_ms = time_blit(threshold_fb, sprites, count, threshold_blit16);
+    double blend_ms = time_blit(blend_fb, sprites, count, pixel_blit_kernel(PIXEL_RGB565));
+
+    // with no partly transparent pixels the two must agree exactly
+    int mismatches = 0;
+    for (size_t i = 0; i < pixels; i++) mismatches += blend_fb[i] != threshold_fb[i];
+
+    printf("blit: %d sprites, %d drawn pixels of which %d partly transparent\n",
+           count, drawn, edges);
+    printf("blit: threshold copy %.3f ms/frame  premultiplied blend %.3f ms/frame, %d %s\n",
+           threshold_ms, blend_ms, mismatches,
+           edges ? "pixels differ (edges blend)" : "mismatches");
+
+done:
+    for (int i = 0; i < BLIT_BENCH_SPRITES; i++) free(storage[i]);
+    free(blend_fb);
+    free(threshold_fb);
+    check_blend();
+}
+
+/******** RASTER ********/
+
+#define RASTER_BENCH_FRAMES 500
+#define RASTER_BENCH_LANES 8
+
+static RasterFrame bench_scene;
+
+static void add_bench_sprite(SpriteId id, int x, int y, int flip) {
+    RasterSprite *s = &bench_scene.sprites[bench_scene.num_sprites++];
+    s->id = id;
+    s->flip = (uint8_t)flip;
+    s->x = (int16_t)x;
+    s->y = (int16_t)y;
+}
+
+// a screenful of traffic laid out like the game's: two rail lanes with a train each,
+// cars three to a road lane, a bus and the player
+static void build_bench_scene(void) {
+    bench_scene.num_sprites = 0;
+    for (int lane = 0; lane < RASTER_BENCH_LANES; lane++) {
+        int y = lane * LANE_HEIGHT + (LANE_HEIGHT - car_height) / 2;
+        if (lane == 2 || lane == 3) {
+            add_bench_sprite(SPRITE_TRAIN, (lane * 131) % screen_width - train_width / 2, y, lane & 1);
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            int x = (k * 170 + lane * 53) % (screen_width + car_width) - car_width;
+            add_bench_sprite(SPRITE_CAR0, x, y, lane & 1);
+        }
+    }
+    add_bench_sprite(SPRITE_SPECIAL0 + BUS, 200, 5 * LANE_HEIGHT + 1, 0);
+    add_bench_sprite(SPRITE_PLAYER, (screen_width - img_width) / 2, 6 * LANE_HEIGHT + 1, 0);
+}
+
+// pixels the painter writes on top of the background (drawn sprite pixels on screen)
+static long sprite_writes(void) {
+    long n = 0;
+    for (int i = 0; i < bench_scene.num_sprites; i++) {
+        const RasterSprite *r = &bench_scene.sprites[i];
+        const Sprite *s = atlas_sprite(r->id);
+        for (int y = 0; y < s->height; y++) {
+            if (r->y + y < 0 || r->y + y >= screen_height) continue;
+            for (int x = 0; x < s->width; x++) {
+                int sx = r->flip ? s->width - 1 - x : x;
+                if (r->x + x >= 0 && r->x + x < screen_width && s->alpha &&
+                    s->alpha[(size_t)y * s->width + sx]) {
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+// ms per frame drawn by the painter (spans = 0) or the span compositor into dst
+static double time_raster(int spans, uint8_t *dst, size_t stride) {
+    raster_use_spans(spans);
+    draw_target = dst;
+    draw_stride = stride;
+    double t0 = now_ns();
+    for (int f = 0; f < RASTER_BENCH_FRAMES; f++) {
+        raster_draw(&bench_scene);
+    }
+    double ms = (now_ns() - t0) / 1e6 / RASTER_BENCH_FRAMES;
+    draw_target = NULL;
+    return ms;
+}
+
+static void bench_raster(void) {
+    static const struct { SpriteId id; const char *file; } images[] = {
+        { SPRITE_PLAYER, "assets/guy1.png" },
+        { SPRITE_CAR0, "assets/car1.png" },
+        { SPRITE_TRAIN, "assets/T2.png" },
+        { SPRITE_SPECIAL0 + BUS, "assets/bus2.png" },
+    };
+    int count = (int)(sizeof(images) / sizeof(images[0]));
+    uint8_t *rgba[4] = { NULL };
+    size_t stride = (size_t)screen_width * 2, size = stride * screen_height;
+    uint8_t *bg = (uint8_t *)malloc(size);
+    uint8_t *painter = (uint8_t *)malloc(size);
+    uint8_t *spans = (uint8_t *)malloc(size);
+    if (!bg || !painter || !spans) {
+        fprintf(stderr, "raster: out of memory\n");
+        goto done;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int w, h, n;
+        rgba[i] = stbi_load(images[i].file, &w, &h, &n, 4);
+        if (!rgba[i]) {
+            fprintf(stderr, "raster: could not load %s\n", images[i].file);
+            goto done;
+        }
+        atlas_add(images[i].id, rgba[i], w, h, 0, 0, (SpriteRect){ 0, 0, w, h });
+    }
+    if (atlas_pack(PIXEL_RGB565) != 0) {
+        fprintf(stderr, "raster: out of memory\n");
+        goto done;
+    }
+
+    for (size_t i = 0; i < size / 2; i++) ((uint16_t *)bg)[i] = (uint16_t)((i / 5) * 2654435761u >> 16);
+    bench_scene.bg = bg;
+    bench_scene.bg_rows = screen_height;
+    bench_scene.bg_stride = stride;
+    bench_scene.bg_y = 0;
+    bench_scene.copy_bg = 1;
+    build_bench_scene();
+
+    double painter_ms = time_raster(0, painter, stride);
+    double spans_ms = time_raster(1, spans, stride);
+    int mismatches = 0;
+    for (size_t i = 0; i < size; i++) mismatches += painter[i] != spans[i];
+
+    long pixels = (long)screen_width * screen_height;
+    long overdraw = sprite_writes();
+    printf("raster: %d sprites, painter writes %ld pixels per frame, spans %ld (%.0f%% fewer)\n",
+           bench_scene.num_sprites, pixels + overdraw, pixels, 100.0 * overdraw / (pixels + overdraw));
+    printf("raster: into ram painter %.3f ms/frame  spans %.3f ms/frame, %d mismatches\n",
+           painter_ms, spans_ms, mismatches);
+
+    // and into the display, where the writes cost the most (run it on the board)
+    int fd, bpp = 0;
+    size_t fb_size, fb_stride;
+    uint8_t *fb = map_fb0(&fd, &fb_size, &fb_stride, &bpp);
+    if (fb && bpp == 16 && fb_size >= fb_stride * screen_height) {
+        painter_ms = time_raster(0, fb, fb_stride);
+        spans_ms = time_raster(1, fb, fb_stride);
+        printf("raster: into /dev/fb0 painter %.3f ms/frame  spans %.3f ms/frame\n",
+               painter_ms, spans_ms);
+    }
+    if (fb) munmap(fb, fb_size);
+    if (fd >= 0) close(fd);
+
+done:
+    atlas_free();
+    raster_use_spans(0);
+    for (int i = 0; i < count; i++) stbi_image_free(rgba[i]);
+    free(bg);
+    free(painter);
+    free(spans);
+}
+
+/******** MAIN ********/
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} Bench;
+
+static const Bench benches[] = {
+    { "rewind", bench_rewind },
+    { "solve", bench_solve },
+    { "upscale", bench_upscale },
+    { "fbcopy", bench_fbcopy },
+    { "blit", bench_blit },
+    { "raster", bench_raster },
+};
+
+int main(int argc, char *argv[]) {
+    if (load_sizes() != 0) return 1;
+
+    int n = (int)(sizeof(benches) / sizeof(benches[0]));
+    for (int i = 0; i < n; i++) {
+        int wanted = (argc < 2);
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], benches[i].name) == 0) wanted = 1;
+        }
+        if (wanted) benches[i].run();
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "catalog.h"
+
+// LEVEL SEED CATALOG
+// the file is mapped read-only and used in place, nothing is parsed or copied
+
+static const CatalogHeader *catalog = NULL;
+static const CatalogEntry *entries = NULL;
+static size_t catalog_size = 0;
+
+void catalog_describe(CatalogHeader *h) {
+    h->screen_width   = (uint16_t)screen_width;
+    h->screen_height  = (uint16_t)screen_height;
+    h->img_width      = (uint16_t)img_width;
+    h->img_height     = (uint16_t)img_height;
+    h->car_width      = (uint16_t)car_width;
+    h->car_height     = (uint16_t)car_height;
+    h->train_width    = (uint16_t)train_width;
+    h->train_height   = (uint16_t)train_height;
+    h->bus_width      = (uint16_t)special_w[BUS];
+    h->bus_height     = (uint16_t)special_h[BUS];
+    h->num_lane_types = (uint16_t)num_lane_types;
+}
+
+int catalog_open(const char *path) {
+    catalog_close();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CatalogHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // mapping stays valid
+    if (map == MAP_FAILED) {
+        perror("mmap catalog");
+        return -1;
+    }
+
+    const CatalogHeader *h = (const CatalogHeader *)map;
+    CatalogHeader expect;
+    memset(&expect, 0, sizeof(expect));
+    catalog_describe(&expect);
+
+    // seeds only reproduce their level if the layout inputs match
+    size_t needed = sizeof(CatalogHeader) + (size_t)h->entry_count * sizeof(CatalogEntry);
+    if (h->magic != CATALOG_MAGIC || h->version != CATALOG_VERSION ||
+        (size_t)st.st_size < needed ||
+        memcmp(&h->screen_width, &expect.screen_width,
+               (const char *)&expect.reserved - (const char *)&expect.screen_width) != 0) {
+        fprintf(stderr, "Warning: %s was built for a different layout, ignoring it\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    catalog = h;
+    entries = (const CatalogEntry *)(h + 1);
+    catalog_size = st.st_size;
+    printf("Loaded %s (%u seeds)\n", path, h->entry_count);
+    return 0;
+}
+
+void catalog_close(void) {
+    if (catalog) {
+        munmap((void *)catalog, catalog_size);
+        catalog = NULL;
+        entries = NULL;
+        catalog_size = 0;
+    }
+}
+
+int catalog_pick(int level_index, int bucket, uint32_t r, uint32_t *seed) {
+    if (!catalog || level_index < 0 || level_index >= NUM_LEVELS) return 0;
+    if (bucket < 0) bucket = 0;
+    if (bucket >= CATALOG_BUCKETS) bucket = CATALOG_BUCKETS - 1;
+
+    const CatalogBucket *b = &catalog->buckets[level_index][bucket];
+    if (b->count == 0 || b->first + b->count > catalog->entry_count) return 0;
+
+    *seed = entries[b->first + r % b->count].seed;
+    return 1;
+}
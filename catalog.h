@@ -0,0 +1,57 @@
+// catalog.h -- on-disk index of pre-validated level seeds (written by seedminer, read by the game)
+
+#include "declarations.h"
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#define CATALOG_PATH "assets/levels.cat"
+#define CATALOG_MAGIC 0x54414343U // "CCAT"
+#define CATALOG_VERSION 3         // bump when generation or the solver changes (stored seeds would be wrong)
+#define CATALOG_BUCKETS 3         // easy, normal, hard (equal-sized slices of each level)
+
+// one validated seed, 16 bytes
+typedef struct {
+    uint32_t seed;
+    uint16_t level;
+    uint16_t difficulty;     // higher = harder, entries of a level are sorted by this
+    uint16_t arrival_frame;  // fastest safe crossing found by the solver
+    uint16_t min_free_cells; // narrowest gap along that route
+    uint16_t density;        // average share of road covered by vehicles (1/65535 units)
+    uint16_t reserved;
+} CatalogEntry;
+
+typedef struct {
+    uint32_t first; // index of first entry in this bucket
+    uint32_t count;
+} CatalogBucket;
+
+// the file is this header followed by entry_count entries, sorted by (level, difficulty)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+
+    // a seed only reproduces its level with the same screen and sprite sizes
+    uint16_t screen_width, screen_height;
+    uint16_t img_width, img_height;
+    uint16_t car_width, car_height;
+    uint16_t train_width, train_height;
+    uint16_t bus_width, bus_height;
+    uint16_t num_lane_types;
+    uint16_t reserved;
+
+    CatalogBucket buckets[NUM_LEVELS][CATALOG_BUCKETS];
+} CatalogHeader;
+
+// fill the layout fields of a header from the currently loaded sprites/screen
+void catalog_describe(CatalogHeader *h);
+
+// map a catalog file; returns -1 if missing or built for a different layout
+int catalog_open(const char *path);
+void catalog_close(void);
+
+// O(1): pick entry r (mod bucket size) of a level's difficulty bucket, returns 0 if empty
+int catalog_pick(int level_index, int bucket, uint32_t r, uint32_t *seed);
+
+#endif
@@ -2,6 +2,7 @@
 #define DECLARATIONS_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 //DEFINITIONS -------------------------------------------------
 
@@ -25,6 +26,11 @@
 
 // level timing
 #define LEVEL_START_DELAY 30 // min number of frames before user can move after popup appears
+#define LEVEL_WARMUP_FRAMES 120 // traffic simulated before a level is shown
+
+// hitbox margins (shrink sprite width on each side)
+#define PLAYER_HITBOX_MARGIN 16
+#define TRAIN_HITBOX_MARGIN 4
 
 //gpio definition
 #define GPIO_BTN0 26 //up
@@ -37,9 +43,27 @@
 int  platform_init(void);
 void platform_shutdown(void);
 void clear_screen(void);
-void put_pixel(int x, int y, uint16_t color);
+void put_pixel(int x, int y, uint32_t color); // color already packed in the display format
+void *framebuffer_row(int y); // start of back buffer row y (screen_width pixels), NULL if off screen.
+                              // the back buffer is not cleared or kept between frames, draw every row
+int  display_pixel_format(void); // PixelFormat (pixel_format.h) of the back buffer
+int  background_upload(const void *bg, int rows, size_t stride); // keep a level's background in the display, 0 if it scrolls in hardware
+int  background_scroll(int bg_y); // show background rows from bg_y and erase last frame's sprites, -1 = copy it yourself
+void framebuffer_dirty(int x, int y, int w, int h); // screen rect about to be drawn over the background
 void present_frame(void);
+int  present_waits_for_vsync(void); // 1 if present_frame already paces the loop at the display refresh
+int  present_from_any_thread(void); // 1 if drawing and presenting may move off the main thread
 void poll_input(int *up, int *down, int *left, int *right, int *quit);
+int  rewind_held(void); // rewind control currently held down (call after poll_input)
+
+//Simulation state -- one copy per thread, so the next level can be generated and
+//solved on a worker thread while the current one is still being played (level.h
+//LevelState carries a finished level over to the game thread)
+#define SIM_STATE _Thread_local
+
+//Game PRNG (level.c) -- same sequence on every libc so level seeds are portable
+void game_srand(uint32_t seed);
+int  game_rand(void);
 
 
 //-----------------------------------------------------------
@@ -51,30 +75,31 @@ extern volatile int running;
 extern unsigned char *image_data;
 extern int img_width; 
 extern int img_height;
-extern int image_x_pos;
-extern int image_y_pos;
+extern SIM_STATE int image_x_pos;
+extern SIM_STATE int image_y_pos;
 extern int player_facing_left;
 
+// sub-pixel vehicle positions/speeds are fixed point with this many fraction bits
+#define FIX_SHIFT 8
+
 // Cars
 typedef struct {
     int active;
     int x;
     int y;
-    int speed; // px per frame
+    int speed; // desired px per frame
+    int fx;    // x in fixed point (x == fx >> FIX_SHIFT)
+    int fv;    // current speed in fixed point px per frame
     int dir; // +1 = right, -1 = left
     int lane_index; // which lane this car belongs to
     int sprite_index; // which car sprite (color)
 } Car;
 
-extern int car_speed;
+extern SIM_STATE int car_speed;
 extern unsigned char* car_data[NUM_CAR_SPRITES];
 extern int car_width;
 extern int car_height;
 
-// initialize cars array
-extern Car cars[MAX_CARS];
-extern int frame_counter; // for spawn timing
-
 // special vehicles  (bus, bike, scooter)
 typedef enum {
     BUS = 0,
@@ -86,15 +111,14 @@ typedef enum {
 typedef struct {
     int active;
     int x, y;
-    int speed;
+    int speed;  // desired px per frame
+    int fx, fv; // fixed point x and current speed, like Car
     int dir;
     int lane_index;
     SpecialType type;
 } SpecialVehicle;
 
-extern SpecialVehicle specials[MAX_SPECIAL_VEHICLES];
-extern int special_speed[TYPE_COUNT];
-extern int special_frame_counter;
+extern SIM_STATE int special_speed[TYPE_COUNT];
 
 // special sprites
 extern unsigned char* special_data[TYPE_COUNT];
@@ -116,7 +140,20 @@ typedef struct {
     int moving;     // 0 = parked, 1 = moving
 } Train;
 
-extern Train trains[MAX_TOTAL_LANES]; // there can only be max one train per mbta lane
+// everything the simulation changes while a level is played, kept in one block
+// so a level can be snapshotted and restored with a single memcpy
+typedef struct {
+    Car cars[MAX_CARS];
+    SpecialVehicle specials[MAX_SPECIAL_VEHICLES];
+    Train trains[MAX_TOTAL_LANES]; // there can only be max one train per mbta lane
+    int lane_direction[MAX_TOTAL_LANES]; // +1 = right, -1 = left
+    int mbta_lane_indices[MAX_TOTAL_LANES];
+    int frame_counter; // for spawn timing
+    int special_frame_counter;
+    uint32_t rng_state; // game PRNG state
+} World;
+
+extern SIM_STATE World world;
 
 // screen size
 extern int screen_width;
@@ -140,14 +177,10 @@ extern Lane lane_templates[6];
 extern int num_lane_types;
 extern Lane level_top_building[NUM_LEVELS];     // Top building for each level
 extern Lane level_bottom_building[NUM_LEVELS];  // Bottom building for each level
-extern int camera_y;  // Camera offset in world space
-extern int first_lane_index;  // Which lane is at the top
-extern int mbta_lane_indices[35];  // Support up to 35 lanes max
-extern int current_level;
-extern int total_lanes_current;
-
-// store traffic direction for each lane
-extern int lane_direction[MAX_TOTAL_LANES]; // +1 = right, -1 = left
+extern SIM_STATE int camera_y;  // Camera offset in world space
+extern SIM_STATE int first_lane_index;  // Which lane is at the top
+extern SIM_STATE int current_level;
+extern SIM_STATE int total_lanes_current;
 
 // Level passed popup
 extern unsigned char *level_passed_data;
@@ -0,0 +1,678 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "drm_display.h"
+
+// DRM/KMS DISPLAY
+// two or three dumb buffers are mapped and drawn into directly, then handed to the
+// display controller with a page flip that completes at vblank (no full-frame copy).
+// flips use the atomic API when the driver has it, legacy page flips otherwise, and
+// their completion comes back as an event on the drm fd.
+
+/******** KERNEL UAPI ********/
+// the few definitions needed from the kernel's include/uapi/drm, copied so the
+// static cross build needs neither libdrm nor the kernel drm headers
+
+#define DRM_IOCTL_BASE 'd'
+#define DRM_IOW(nr, type)  _IOW(DRM_IOCTL_BASE, nr, type)
+#define DRM_IOWR(nr, type) _IOWR(DRM_IOCTL_BASE, nr, type)
+
+#define DRM_CAP_DUMB_BUFFER             0x1
+#define DRM_CLIENT_CAP_UNIVERSAL_PLANES 2
+#define DRM_CLIENT_CAP_ATOMIC           3
+
+#define DRM_MODE_TYPE_PREFERRED     (1 << 3)
+#define DRM_MODE_CONNECTED          1
+#define DRM_MODE_OBJECT_CRTC        0xcccccccc
+#define DRM_MODE_OBJECT_CONNECTOR   0xc0c0c0c0
+#define DRM_MODE_OBJECT_PLANE       0xeeeeeeee
+#define DRM_PLANE_TYPE_PRIMARY      1
+
+#define DRM_MODE_PAGE_FLIP_EVENT      0x01
+#define DRM_MODE_ATOMIC_NONBLOCK      0x0200
+#define DRM_MODE_ATOMIC_ALLOW_MODESET 0x0400
+
+#define DRM_EVENT_FLIP_COMPLETE 0x02
+
+#define DRM_FORMAT_RGB565   0x36314752 // fourcc 'R' 'G' '1' '6'
+#define DRM_FORMAT_XRGB8888 0x34325258 // fourcc 'X' 'R' '2' '4'
+
+struct drm_get_cap { uint64_t capability; uint64_t value; };
+struct drm_set_client_cap { uint64_t capability; uint64_t value; };
+
+struct drm_mode_modeinfo {
+    uint32_t clock;
+    uint16_t hdisplay, hsync_start, hsync_end, htotal, hskew;
+    uint16_t vdisplay, vsync_start, vsync_end, vtotal, vscan;
+    uint32_t vrefresh;
+    uint32_t flags;
+    uint32_t type;
+    char name[32];
+};
+
+struct drm_mode_card_res {
+    uint64_t fb_id_ptr, crtc_id_ptr, connector_id_ptr, encoder_id_ptr;
+    uint32_t count_fbs, count_crtcs, count_connectors, count_encoders;
+    uint32_t min_width, max_width, min_height, max_height;
+};
+
+struct drm_mode_crtc {
+    uint64_t set_connectors_ptr;
+    uint32_t count_connectors;
+    uint32_t crtc_id, fb_id, x, y, gamma_size, mode_valid;
+    struct drm_mode_modeinfo mode;
+};
+
+struct drm_mode_get_encoder {
+    uint32_t encoder_id, encoder_type, crtc_id, possible_crtcs, possible_clones;
+};
+
+struct drm_mode_get_connector {
+    uint64_t encoders_ptr, modes_ptr, props_ptr, prop_values_ptr;
+    uint32_t count_modes, count_props, count_encoders;
+    uint32_t encoder_id, connector_id, connector_type, connector_type_id;
+    uint32_t connection, mm_width, mm_height, subpixel, pad;
+};
+
+struct drm_mode_get_property {
+    uint64_t values_ptr, enum_blob_ptr;
+    uint32_t prop_id, flags;
+    char name[32];
+    uint32_t count_values, count_enum_blobs;
+};
+
+struct drm_mode_crtc_page_flip {
+    uint32_t crtc_id, fb_id, flags, reserved;
+    uint64_t user_data;
+};
+
+struct drm_mode_create_dumb {
+    uint32_t height, width, bpp, flags;
+    uint32_t handle, pitch;
+    uint64_t size;
+};
+struct drm_mode_map_dumb { uint32_t handle, pad; uint64_t offset; };
+struct drm_mode_destroy_dumb { uint32_t handle; };
+
+struct drm_mode_get_plane_res { uint64_t plane_id_ptr; uint32_t count_planes; };
+struct drm_mode_get_plane {
+    uint32_t plane_id, crtc_id, fb_id, possible_crtcs, gamma_size, count_format_types;
+    uint64_t format_type_ptr;
+};
+
+struct drm_mode_fb_cmd2 {
+    uint32_t fb_id, width, height, pixel_format, flags;
+    uint32_t handles[4], pitches[4], offsets[4];
+    uint64_t modifier[4];
+};
+
+struct drm_mode_obj_get_properties {
+    uint64_t props_ptr, prop_values_ptr;
+    uint32_t count_props, obj_id, obj_type;
+};
+
+struct drm_mode_atomic {
+    uint32_t flags, count_objs;
+    uint64_t objs_ptr, count_props_ptr, props_ptr, prop_values_ptr, reserved, user_data;
+};
+
+struct drm_mode_create_blob { uint64_t data; uint32_t length, blob_id; };
+struct drm_mode_destroy_blob { uint32_t blob_id; };
+
+struct drm_event { uint32_t type, length; };
+struct drm_event_vblank {
+    struct drm_event base;
+    uint64_t user_data;
+    uint32_t tv_sec, tv_usec, sequence, crtc_id;
+};
+
+#define DRM_IOCTL_GET_CAP                DRM_IOWR(0x0c, struct drm_get_cap)
+#define DRM_IOCTL_SET_CLIENT_CAP         DRM_IOW(0x0d, struct drm_set_client_cap)
+#define DRM_IOCTL_MODE_GETRESOURCES      DRM_IOWR(0xA0, struct drm_mode_card_res)
+#define DRM_IOCTL_MODE_GETCRTC           DRM_IOWR(0xA1, struct drm_mode_crtc)
+#define DRM_IOCTL_MODE_SETCRTC           DRM_IOWR(0xA2, struct drm_mode_crtc)
+#define DRM_IOCTL_MODE_GETENCODER        DRM_IOWR(0xA6, struct drm_mode_get_encoder)
+#define DRM_IOCTL_MODE_GETCONNECTOR      DRM_IOWR(0xA7, struct drm_mode_get_connector)
+#define DRM_IOCTL_MODE_GETPROPERTY       DRM_IOWR(0xAA, struct drm_mode_get_property)
+#define DRM_IOCTL_MODE_RMFB              DRM_IOWR(0xAF, unsigned int)
+#define DRM_IOCTL_MODE_PAGE_FLIP         DRM_IOWR(0xB0, struct drm_mode_crtc_page_flip)
+#define DRM_IOCTL_MODE_CREATE_DUMB       DRM_IOWR(0xB2, struct drm_mode_create_dumb)
+#define DRM_IOCTL_MODE_MAP_DUMB          DRM_IOWR(0xB3, struct drm_mode_map_dumb)
+#define DRM_IOCTL_MODE_DESTROY_DUMB      DRM_IOWR(0xB4, struct drm_mode_destroy_dumb)
+#define DRM_IOCTL_MODE_GETPLANERESOURCES DRM_IOWR(0xB5, struct drm_mode_get_plane_res)
+#define DRM_IOCTL_MODE_GETPLANE          DRM_IOWR(0xB6, struct drm_mode_get_plane)
+#define DRM_IOCTL_MODE_ADDFB2            DRM_IOWR(0xB8, struct drm_mode_fb_cmd2)
+#define DRM_IOCTL_MODE_OBJ_GETPROPERTIES DRM_IOWR(0xB9, struct drm_mode_obj_get_properties)
+#define DRM_IOCTL_MODE_ATOMIC            DRM_IOWR(0xBC, struct drm_mode_atomic)
+#define DRM_IOCTL_MODE_CREATEPROPBLOB    DRM_IOWR(0xBD, struct drm_mode_create_blob)
+#define DRM_IOCTL_MODE_DESTROYPROPBLOB   DRM_IOWR(0xBE, struct drm_mode_destroy_blob)
+
+/******** STATE ********/
+
+#define MAX_IDS 32
+
+typedef struct {
+    uint32_t handle;
+    uint32_t fb_id;
+    uint32_t pitch;
+    uint64_t size;
+    uint8_t *map;
+} DumbBuffer;
+
+static int drm_fd = -1;
+static int atomic = 0;
+static uint32_t connector_id, crtc_id, plane_id, mode_blob;
+static struct drm_mode_modeinfo mode;
+static struct drm_mode_crtc saved_crtc;
+static int have_saved_crtc = 0;
+
+// scanout formats in order of preference (565 moves half the bytes)
+static const struct {
+    uint32_t fourcc;
+    uint32_t bpp;
+    PixelFormat format;
+} scanout_formats[] = {
+    { DRM_FORMAT_RGB565,   16, PIXEL_RGB565 },
+    { DRM_FORMAT_XRGB8888, 32, PIXEL_XRGB8888 },
+};
+#define NUM_SCANOUT_FORMATS (int)(sizeof(scanout_formats) / sizeof(scanout_formats[0]))
+static int scanout = 0; // index into scanout_formats
+
+static DumbBuffer buffers[DRM_NUM_BUFFERS];
+static int num_buffers = 0;
+static int front = -1;   // on screen
+static int pending = -1; // flip queued, not yet on screen
+static int back = -1;    // being drawn
+
+// atomic property ids
+static uint32_t prop_conn_crtc;
+static uint32_t prop_crtc_mode, prop_crtc_active;
+static uint32_t prop_plane_fb, prop_plane_crtc;
+static uint32_t prop_src_x, prop_src_y, prop_src_w, prop_src_h;
+static uint32_t prop_crtc_x, prop_crtc_y, prop_crtc_w, prop_crtc_h;
+
+/******** HELPERS ********/
+
+static int drm_ioctl(unsigned long request, void *arg) {
+    int ret;
+    do {
+        ret = ioctl(drm_fd, request, arg);
+    } while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+    return ret;
+}
+
+static uint64_t ptr(const void *p) {
+    return (uint64_t)(uintptr_t)p;
+}
+
+// id of the named property of a kms object, 0 if it has none
+static uint32_t find_prop(uint32_t obj, uint32_t type, const char *name, uint64_t *value) {
+    uint32_t ids[64];
+    uint64_t values[64];
+    struct drm_mode_obj_get_properties req;
+    memset(&req, 0, sizeof(req));
+    req.obj_id = obj;
+    req.obj_type = type;
+    if (drm_ioctl(DRM_IOCTL_MODE_OBJ_GETPROPERTIES, &req) < 0) return 0;
+    if (req.count_props > 64) req.count_props = 64;
+    req.props_ptr = ptr(ids);
+    req.prop_values_ptr = ptr(values);
+    if (drm_ioctl(DRM_IOCTL_MODE_OBJ_GETPROPERTIES, &req) < 0) return 0;
+
+    for (uint32_t i = 0; i < req.count_props; i++) {
+        struct drm_mode_get_property p;
+        memset(&p, 0, sizeof(p));
+        p.prop_id = ids[i];
+        if (drm_ioctl(DRM_IOCTL_MODE_GETPROPERTY, &p) < 0) continue;
+        if (strncmp(p.name, name, sizeof(p.name)) == 0) {
+            if (value) *value = values[i];
+            return ids[i];
+        }
+    }
+    return 0;
+}
+
+/******** ATOMIC REQUESTS ********/
+
+typedef struct {
+    uint32_t objs[4];
+    uint32_t counts[4];
+    uint32_t props[16];
+    uint64_t values[16];
+    int num_objs;
+    int num_props;
+} AtomicReq;
+
+// properties of one object must be added together
+static void atomic_add(AtomicReq *r, uint32_t obj, uint32_t prop, uint64_t value) {
+    if (r->num_props >= 16) return;
+    if (r->num_objs == 0 || r->objs[r->num_objs - 1] != obj) {
+        if (r->num_objs >= 4) return;
+        r->objs[r->num_objs] = obj;
+        r->counts[r->num_objs] = 0;
+        r->num_objs++;
+    }
+    r->counts[r->num_objs - 1]++;
+    r->props[r->num_props] = prop;
+    r->values[r->num_props] = value;
+    r->num_props++;
+}
+
+static int atomic_commit(AtomicReq *r, uint32_t flags, uint64_t user_data) {
+    struct drm_mode_atomic req;
+    memset(&req, 0, sizeof(req));
+    req.flags = flags;
+    req.count_objs = (uint32_t)r->num_objs;
+    req.objs_ptr = ptr(r->objs);
+    req.count_props_ptr = ptr(r->counts);
+    req.props_ptr = ptr(r->props);
+    req.prop_values_ptr = ptr(r->values);
+    req.user_data = user_data;
+    return drm_ioctl(DRM_IOCTL_MODE_ATOMIC, &req);
+}
+
+/******** SETUP ********/
+
+// a connected connector, its preferred mode and a crtc that can drive it
+static int pick_output(void) {
+    uint32_t crtcs[MAX_IDS], connectors[MAX_IDS];
+    struct drm_mode_card_res res;
+    memset(&res, 0, sizeof(res));
+    if (drm_ioctl(DRM_IOCTL_MODE_GETRESOURCES, &res) < 0) return -1;
+    if (res.count_crtcs > MAX_IDS) res.count_crtcs = MAX_IDS;
+    if (res.count_connectors > MAX_IDS) res.count_connectors = MAX_IDS;
+    res.count_fbs = res.count_encoders = 0;
+    res.crtc_id_ptr = ptr(crtcs);
+    res.connector_id_ptr = ptr(connectors);
+    if (drm_ioctl(DRM_IOCTL_MODE_GETRESOURCES, &res) < 0) return -1;
+
+    for (uint32_t c = 0; c < res.count_connectors; c++) {
+        struct drm_mode_modeinfo modes[MAX_IDS];
+        uint32_t encoders[MAX_IDS];
+        struct drm_mode_get_connector conn;
+        memset(&conn, 0, sizeof(conn));
+        conn.connector_id = connectors[c];
+        if (drm_ioctl(DRM_IOCTL_MODE_GETCONNECTOR, &conn) < 0) continue;
+        if (conn.connection != DRM_MODE_CONNECTED || conn.count_modes == 0) continue;
+
+        if (conn.count_modes > MAX_IDS) conn.count_modes = MAX_IDS;
+        if (conn.count_encoders > MAX_IDS) conn.count_encoders = MAX_IDS;
+        conn.count_props = 0;
+        conn.modes_ptr = ptr(modes);
+        conn.encoders_ptr = ptr(encoders);
+        if (drm_ioctl(DRM_IOCTL_MODE_GETCONNECTOR, &conn) < 0) continue;
+
+        mode = modes[0];
+        for (uint32_t m = 0; m < conn.count_modes; m++) {
+            if (modes[m].type & DRM_MODE_TYPE_PREFERRED) {
+                mode = modes[m];
+                break;
+            }
+        }
+
+        // keep the crtc the encoder already uses, else any crtc it can use
+        for (uint32_t e = 0; e < conn.count_encoders; e++) {
+            struct drm_mode_get_encoder enc;
+            memset(&enc, 0, sizeof(enc));
+            enc.encoder_id = encoders[e];
+            if (drm_ioctl(DRM_IOCTL_MODE_GETENCODER, &enc) < 0) continue;
+
+            for (uint32_t k = 0; k < res.count_crtcs; k++) {
+                int usable = (enc.crtc_id != 0) ? (crtcs[k] == enc.crtc_id)
+                                                : ((enc.possible_crtcs >> k) & 1);
+                if (!usable) continue;
+                connector_id = connectors[c];
+                crtc_id = crtcs[k];
+                return (int)k;
+            }
+        }
+    }
+    return -1;
+}
+
+// the primary plane of our crtc and the first scanout format it takes
+static int pick_plane(int crtc_index) {
+    uint32_t planes[MAX_IDS];
+    struct drm_mode_get_plane_res res;
+    memset(&res, 0, sizeof(res));
+    if (drm_ioctl(DRM_IOCTL_MODE_GETPLANERESOURCES, &res) < 0) return -1;
+    if (res.count_planes > MAX_IDS) res.count_planes = MAX_IDS;
+    res.plane_id_ptr = ptr(planes);
+    if (drm_ioctl(DRM_IOCTL_MODE_GETPLANERESOURCES, &res) < 0) return -1;
+
+    for (uint32_t p = 0; p < res.count_planes; p++) {
+        uint32_t formats[64];
+        struct drm_mode_get_plane plane;
+        memset(&plane, 0, sizeof(plane));
+        plane.plane_id = planes[p];
+        if (drm_ioctl(DRM_IOCTL_MODE_GETPLANE, &plane) < 0) continue;
+        if (!((plane.possible_crtcs >> crtc_index) & 1)) continue;
+
+        uint64_t type = 0;
+        if (!find_prop(planes[p], DRM_MODE_OBJECT_PLANE, "type", &type) || type != DRM_PLANE_TYPE_PRIMARY) continue;
+
+        if (plane.count_format_types > 64) plane.count_format_types = 64;
+        plane.format_type_ptr = ptr(formats);
+        if (drm_ioctl(DRM_IOCTL_MODE_GETPLANE, &plane) < 0) continue;
+        for (scanout = 0; scanout < NUM_SCANOUT_FORMATS; scanout++) {
+            for (uint32_t f = 0; f < plane.count_format_types; f++) {
+                if (formats[f] == scanout_formats[scanout].fourcc) {
+                    plane_id = planes[p];
+                    return 0;
+                }
+            }
+        }
+        fprintf(stderr, "Warning: primary plane %u takes neither RGB565 nor XRGB8888\n", planes[p]);
+        return -1;
+    }
+    return -1;
+}
+
+static int find_atomic_props(void) {
+    prop_conn_crtc   = find_prop(connector_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID", NULL);
+    prop_crtc_mode   = find_prop(crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID", NULL);
+    prop_crtc_active = find_prop(crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE", NULL);
+    prop_plane_fb    = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID", NULL);
+    prop_plane_crtc  = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID", NULL);
+    prop_src_x       = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X", NULL);
+    prop_src_y       = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y", NULL);
+    prop_src_w       = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W", NULL);
+    prop_src_h       = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H", NULL);
+    prop_crtc_x      = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X", NULL);
+    prop_crtc_y      = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y", NULL);
+    prop_crtc_w      = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W", NULL);
+    prop_crtc_h      = find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H", NULL);
+
+    return (prop_conn_crtc && prop_crtc_mode && prop_crtc_active && prop_plane_fb &&
+            prop_plane_crtc && prop_src_x && prop_src_y && prop_src_w && prop_src_h &&
+            prop_crtc_x && prop_crtc_y && prop_crtc_w && prop_crtc_h) ? 0 : -1;
+}
+
+static int create_buffer(DumbBuffer *b, int width, int height) {
+    struct drm_mode_create_dumb create;
+    memset(&create, 0, sizeof(create));
+    create.width = (uint32_t)width;
+    create.height = (uint32_t)height;
+    create.bpp = scanout_formats[scanout].bpp;
+    if (drm_ioctl(DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0) {
+        perror("DRM_IOCTL_MODE_CREATE_DUMB");
+        return -1;
+    }
+    b->handle = create.handle;
+    b->pitch = create.pitch;
+    b->size = create.size;
+
+    struct drm_mode_fb_cmd2 fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.width = (uint32_t)width;
+    fb.height = (uint32_t)height;
+    fb.pixel_format = scanout_formats[scanout].fourcc;
+    fb.handles[0] = b->handle;
+    fb.pitches[0] = b->pitch;
+    if (drm_ioctl(DRM_IOCTL_MODE_ADDFB2, &fb) < 0) {
+        perror("DRM_IOCTL_MODE_ADDFB2");
+        return -1;
+    }
+    b->fb_id = fb.fb_id;
+
+    struct drm_mode_map_dumb map;
+    memset(&map, 0, sizeof(map));
+    map.handle = b->handle;
+    if (drm_ioctl(DRM_IOCTL_MODE_MAP_DUMB, &map) < 0) {
+        perror("DRM_IOCTL_MODE_MAP_DUMB");
+        return -1;
+    }
+    b->map = mmap(NULL, b->size, PROT_READ | PROT_WRITE, MAP_SHARED, drm_fd, (off_t)map.offset);
+    if (b->map == MAP_FAILED) {
+        perror("mmap dumb buffer");
+        b->map = NULL;
+        return -1;
+    }
+    memset(b->map, 0, b->size);
+    return 0;
+}
+
+static void destroy_buffer(DumbBuffer *b) {
+    if (b->map) munmap(b->map, b->size);
+    if (b->fb_id) drm_ioctl(DRM_IOCTL_MODE_RMFB, &b->fb_id);
+    if (b->handle) {
+        struct drm_mode_destroy_dumb destroy = { .handle = b->handle };
+        drm_ioctl(DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+    }
+    memset(b, 0, sizeof(*b));
+}
+
+// light up the output with buffer 0
+static int modeset(void) {
+    int w = mode.hdisplay, h = mode.vdisplay;
+
+    if (atomic) {
+        struct drm_mode_create_blob blob;
+        memset(&blob, 0, sizeof(blob));
+        blob.data = ptr(&mode);
+        blob.length = sizeof(mode);
+        if (drm_ioctl(DRM_IOCTL_MODE_CREATEPROPBLOB, &blob) < 0) return -1;
+        mode_blob = blob.blob_id;
+
+        AtomicReq r;
+        memset(&r, 0, sizeof(r));
+        atomic_add(&r, connector_id, prop_conn_crtc, crtc_id);
+        atomic_add(&r, crtc_id, prop_crtc_mode, mode_blob);
+        atomic_add(&r, crtc_id, prop_crtc_active, 1);
+        atomic_add(&r, plane_id, prop_plane_fb, buffers[0].fb_id);
+        atomic_add(&r, plane_id, prop_plane_crtc, crtc_id);
+        atomic_add(&r, plane_id, prop_src_x, 0);
+        atomic_add(&r, plane_id, prop_src_y, 0);
+        atomic_add(&r, plane_id, prop_src_w, (uint64_t)w << 16);
+        atomic_add(&r, plane_id, prop_src_h, (uint64_t)h << 16);
+        atomic_add(&r, plane_id, prop_crtc_x, 0);
+        atomic_add(&r, plane_id, prop_crtc_y, 0);
+        atomic_add(&r, plane_id, prop_crtc_w, (uint64_t)w);
+        atomic_add(&r, plane_id, prop_crtc_h, (uint64_t)h);
+        return atomic_commit(&r, DRM_MODE_ATOMIC_ALLOW_MODESET, 0);
+    }
+
+    struct drm_mode_crtc set;
+    memset(&set, 0, sizeof(set));
+    set.crtc_id = crtc_id;
+    set.fb_id = buffers[0].fb_id;
+    set.set_connectors_ptr = ptr(&connector_id);
+    set.count_connectors = 1;
+    set.mode = mode;
+    set.mode_valid = 1;
+    return drm_ioctl(DRM_IOCTL_MODE_SETCRTC, &set);
+}
+
+static void close_card(void) {
+    for (int i = 0; i < num_buffers; i++) {
+        destroy_buffer(&buffers[i]);
+    }
+    num_buffers = 0;
+    if (mode_blob) {
+        struct drm_mode_destroy_blob destroy = { .blob_id = mode_blob };
+        drm_ioctl(DRM_IOCTL_MODE_DESTROYPROPBLOB, &destroy);
+        mode_blob = 0;
+    }
+    if (drm_fd >= 0) {
+        close(drm_fd);
+        drm_fd = -1;
+    }
+    front = pending = back = -1;
+    have_saved_crtc = 0;
+}
+
+static int open_card(const char *path) {
+    drm_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (drm_fd < 0) return -1;
+
+    struct drm_get_cap cap = { .capability = DRM_CAP_DUMB_BUFFER };
+    if (drm_ioctl(DRM_IOCTL_GET_CAP, &cap) < 0 || !cap.value) goto fail;
+
+    // atomic needs universal planes; without it fall back to legacy setcrtc/page flip
+    struct drm_set_client_cap planes_cap = { .capability = DRM_CLIENT_CAP_UNIVERSAL_PLANES, .value = 1 };
+    struct drm_set_client_cap atomic_cap = { .capability = DRM_CLIENT_CAP_ATOMIC, .value = 1 };
+    atomic = drm_ioctl(DRM_IOCTL_SET_CLIENT_CAP, &planes_cap) == 0 &&
+             drm_ioctl(DRM_IOCTL_SET_CLIENT_CAP, &atomic_cap) == 0;
+
+    int crtc_index = pick_output();
+    if (crtc_index < 0) goto fail;
+    if (atomic && (pick_plane(crtc_index) != 0 || find_atomic_props() != 0)) goto fail;
+
+    // remember what the console had up, to put it back on exit
+    memset(&saved_crtc, 0, sizeof(saved_crtc));
+    saved_crtc.crtc_id = crtc_id;
+    have_saved_crtc = drm_ioctl(DRM_IOCTL_MODE_GETCRTC, &saved_crtc) == 0;
+
+    // legacy drivers do not list formats, the first buffer they accept decides
+    if (!atomic) {
+        for (scanout = 0; scanout < NUM_SCANOUT_FORMATS; scanout++) {
+            if (create_buffer(&buffers[0], mode.hdisplay, mode.vdisplay) == 0) break;
+            destroy_buffer(&buffers[0]);
+        }
+        if (scanout == NUM_SCANOUT_FORMATS) goto fail;
+    }
+
+    for (num_buffers = atomic ? 0 : 1; num_buffers < DRM_NUM_BUFFERS; num_buffers++) {
+        if (create_buffer(&buffers[num_buffers], mode.hdisplay, mode.vdisplay) != 0) break;
+    }
+    if (num_buffers < 2) goto fail; // need at least a front and a back buffer
+
+    if (modeset() != 0) {
+        perror("drm modeset");
+        goto fail;
+    }
+    front = 0;
+    printf("DRM: %s %ux%u@%u %s, %d buffers, %s flips\n", path, mode.hdisplay, mode.vdisplay,
+           mode.vrefresh, pixel_format_name(scanout_formats[scanout].format), num_buffers,
+           atomic ? "atomic" : "legacy");
+    return 0;
+
+fail:
+    // a partly made buffer still needs freeing
+    if (num_buffers < DRM_NUM_BUFFERS) num_buffers++;
+    close_card();
+    return -1;
+}
+
+int drm_display_open(int *width, int *height, PixelFormat *format) {
+    for (int i = 0; i < DRM_MAX_CARDS; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "/dev/dri/card%d", i);
+        if (open_card(path) == 0) {
+            *width = mode.hdisplay;
+            *height = mode.vdisplay;
+            *format = scanout_formats[scanout].format;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void drm_display_close(void) {
+    if (drm_fd < 0) return;
+
+    // let the last flip land before its buffer goes away
+    if (pending >= 0) {
+        struct pollfd pfd = { .fd = drm_fd, .events = POLLIN };
+        poll(&pfd, 1, DRM_FLIP_TIMEOUT_MS);
+    }
+    if (have_saved_crtc && saved_crtc.mode_valid) {
+        saved_crtc.set_connectors_ptr = ptr(&connector_id);
+        saved_crtc.count_connectors = 1;
+        drm_ioctl(DRM_IOCTL_MODE_SETCRTC, &saved_crtc);
+    }
+    close_card();
+}
+
+/******** FLIPS ********/
+
+// read completed flips off the fd. each flip carries its buffer index as user_data,
+// so a late event for a flip wait_flip already gave up on is not taken for the one
+// queued after it
+static void handle_events(void) {
+    char buf[256];
+    ssize_t len = read(drm_fd, buf, sizeof(buf));
+    for (ssize_t off = 0; off + (ssize_t)sizeof(struct drm_event) <= len; ) {
+        const struct drm_event *e = (const struct drm_event *)(buf + off);
+        if (e->length == 0) break;
+        if (e->type == DRM_EVENT_FLIP_COMPLETE && off + (ssize_t)sizeof(struct drm_event_vblank) <= len &&
+            pending >= 0 && ((const struct drm_event_vblank *)e)->user_data == (uint64_t)pending) {
+            front = pending;
+            pending = -1;
+        }
+        off += e->length;
+    }
+}
+
+// block until the queued flip is on screen (or the display stops answering)
+static void wait_flip(void) {
+    while (pending >= 0) {
+        struct pollfd pfd = { .fd = drm_fd, .events = POLLIN };
+        int r = poll(&pfd, 1, DRM_FLIP_TIMEOUT_MS);
+        if (r > 0) {
+            handle_events();
+        } else if (r == 0) {
+            front = pending;
+            pending = -1;
+        } else if (errno != EINTR) {
+            return;
+        }
+    }
+}
+
+static void pick_back(void) {
+    for (;;) {
+        for (int i = 0; i < num_buffers; i++) {
+            if (i != front && i != pending) {
+                back = i;
+                return;
+            }
+        }
+        wait_flip(); // double buffering: the only other buffer is still queued
+    }
+}
+
+void *drm_display_row(int y) {
+    if (drm_fd < 0 || y < 0 || y >= mode.vdisplay) return NULL;
+    if (back < 0) pick_back();
+    return buffers[back].map + (size_t)y * buffers[back].pitch;
+}
+
+void drm_display_flip(void) {
+    if (drm_fd < 0 || back < 0) return; // nothing drawn since the last flip
+
+    // one flip in flight at a time, so this is where the caller gets vsync-paced
+    wait_flip();
+
+    int ret;
+    if (atomic) {
+        AtomicReq r;
+        memset(&r, 0, sizeof(r));
+        atomic_add(&r, plane_id, prop_plane_fb, buffers[back].fb_id);
+        ret = atomic_commit(&r, DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK, (uint64_t)back);
+    } else {
+        struct drm_mode_crtc_page_flip flip;
+        memset(&flip, 0, sizeof(flip));
+        flip.crtc_id = crtc_id;
+        flip.fb_id = buffers[back].fb_id;
+        flip.flags = DRM_MODE_PAGE_FLIP_EVENT;
+        flip.user_data = (uint64_t)back;
+        ret = drm_ioctl(DRM_IOCTL_MODE_PAGE_FLIP, &flip);
+    }
+
+    if (ret == 0) {
+        pending = back;
+        back = -1;
+    }
+    // on failure keep drawing into the same buffer, the next flip retries it
+}
+
+int drm_display_fd(void) {
+    return drm_fd;
+}
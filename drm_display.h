@@ -0,0 +1,33 @@
+// drm_display.h -- DRM/KMS output: the game draws straight into dumb buffers flipped at vblank
+
+#include <stdint.h>
+#include "declarations.h"
+#include "pixel_format.h"
+
+#ifndef DRM_DISPLAY_H
+#define DRM_DISPLAY_H
+
+#define DRM_MAX_CARDS 8
+#define DRM_NUM_BUFFERS 3       // scanout + queued flip + the one being drawn
+#define DRM_FLIP_TIMEOUT_MS 100 // give up waiting for a flip event (display switched off)
+
+// set up the first /dev/dri/cardN we can drive (connected output, rgb565 or
+// xrgb8888 dumb buffers, modeset allowed) and report its mode size and pixel
+// format. -1 if there is none
+int drm_display_open(int *width, int *height, PixelFormat *format);
+
+// row y of the buffer the next frame is drawn into, NULL if off screen.
+// the first call after a flip may wait until a buffer is off screen
+void *drm_display_row(int y);
+
+// queue the drawn buffer to be shown at the next vblank. waits for the
+// previous flip to complete first, which paces the caller at the refresh rate
+void drm_display_flip(void);
+
+// drm fd, readable when a flip has completed
+int drm_display_fd(void);
+
+// puts back whatever was on screen before drm_display_open
+void drm_display_close(void);
+
+#endif
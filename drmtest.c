@@ -0,0 +1,74 @@
+// drmtest.c -- exercise the DRM/KMS output without the game
+//
+//   make drmtest
+//   ./drmtest [frames]    (default 300; draws a moving bar and reports the flip rate)
+//
+// with no display attached the virtual kms driver works too:
+//   modprobe vkms          (adds a /dev/dri/cardN with one virtual output)
+// run it from a text console or over ssh, a desktop session already owns the output.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "drm_display.h"
+
+static double now_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1e6;
+}
+
+static void draw(int frame, int width, int height, PixelFormat format) {
+    int bar_x = (frame * 4) % width;
+    int bytes = pixel_bytes(format);
+    uint32_t white = pixel_pack(format, 255, 255, 255);
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = drm_display_row(y);
+        if (!row) continue;
+        uint32_t bg = pixel_pack(format, (uint8_t)(y * 255 / height), (uint8_t)(frame * 4), 0);
+        for (int x = 0; x < width; x++) {
+            uint32_t c = (x >= bar_x && x < bar_x + 16) ? white : bg;
+            if (bytes == 2) ((uint16_t *)row)[x] = (uint16_t)c;
+            else ((uint32_t *)row)[x] = c;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int frames = (argc > 1) ? atoi(argv[1]) : 300;
+    if (frames < 2) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    int width, height;
+    PixelFormat format;
+    if (drm_display_open(&width, &height, &format) != 0) {
+        fprintf(stderr, "drmtest: no usable /dev/dri/card* (try modprobe vkms)\n");
+        return 1;
+    }
+
+    double start = now_ms(), last = start;
+    double shortest = 1e9, longest = 0;
+    for (int i = 0; i < frames; i++) {
+        draw(i, width, height, format);
+        drm_display_flip();
+
+        // flip returns once the previous frame is on screen, so this is the vblank interval
+        double t = now_ms();
+        if (i > 1) {
+            if (t - last < shortest) shortest = t - last;
+            if (t - last > longest) longest = t - last;
+        }
+        last = t;
+    }
+    double elapsed = last - start;
+    drm_display_close();
+
+    printf("drmtest: %dx%d %s, %d frames in %.0f ms = %.1f fps, frame interval %.2f..%.2f ms\n",
+           width, height, pixel_format_name(format), frames, elapsed, frames * 1000.0 / elapsed,
+           shortest, longest);
+    return 0;
+}
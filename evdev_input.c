@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <linux/input.h>
+#include "evdev_input.h"
+
+// EVDEV INPUT
+// keyboards and gamepads are read from their event devices without SDL or a
+// display server. keys, d-pads, hats and sticks all map onto the four directions
+// (plus quit and rewind); every device holding a direction keeps it held. new
+// devices are picked up from an inotify watch on /dev/input, unplugged ones
+// release whatever they were holding.
+
+#define INOTIFY_TAG EVDEV_MAX_DEVICES // epoll tag of the inotify fd, devices use their slot
+#define EVENT_BATCH 32
+
+// axes we understand, in pairs of (negative kind, positive kind)
+enum { AXIS_X, AXIS_Y, AXIS_HAT_X, AXIS_HAT_Y, NUM_AXES };
+static const int axis_code[NUM_AXES] = { ABS_X, ABS_Y, ABS_HAT0X, ABS_HAT0Y };
+static const int axis_neg[NUM_AXES] = { INPUT_LEFT, INPUT_UP, INPUT_LEFT, INPUT_UP };
+static const int axis_pos[NUM_AXES] = { INPUT_RIGHT, INPUT_DOWN, INPUT_RIGHT, INPUT_DOWN };
+
+typedef struct {
+    int fd;                 // -1 = free slot
+    int number;             // N of /dev/input/eventN, -1 if attached
+    char name[64];
+    int keys_down[INPUT_KINDS];
+    int axis_min[NUM_AXES];
+    int axis_max[NUM_AXES];
+    int axis_dir[NUM_AXES]; // -1, 0, 1
+} Device;
+
+static Device devices[EVDEV_MAX_DEVICES];
+static int epoll_fd = -1;
+static int inotify_fd = -1;
+static char watch_dir[128];
+static int grab_devices = 0;
+static int kind_levels[INPUT_KINDS];
+
+/******** MAPPING ********/
+
+static int key_kind(int code) {
+    switch (code) {
+        case KEY_UP: case KEY_W: case KEY_KP8: case BTN_DPAD_UP: case BTN_SOUTH:
+            return INPUT_UP;
+        case KEY_DOWN: case KEY_S: case KEY_KP2: case BTN_DPAD_DOWN:
+            return INPUT_DOWN;
+        case KEY_LEFT: case KEY_A: case KEY_KP4: case BTN_DPAD_LEFT:
+            return INPUT_LEFT;
+        case KEY_RIGHT: case KEY_D: case KEY_KP6: case BTN_DPAD_RIGHT:
+            return INPUT_RIGHT;
+        case KEY_BACKSPACE: case BTN_SELECT: case BTN_WEST:
+            return INPUT_REWIND;
+        case KEY_ESC: case KEY_Q:
+            return INPUT_QUIT;
+        default:
+            return -1;
+    }
+}
+
+static int axis_index(int code) {
+    for (int a = 0; a < NUM_AXES; a++) {
+        if (axis_code[a] == code) return a;
+    }
+    return -1;
+}
+
+// stick/hat position as -1, 0 or 1, with a dead zone of half the distance to each end
+static int axis_direction(const Device *d, int a, int value) {
+    int center = (d->axis_min[a] + d->axis_max[a]) / 2;
+    int dead = (d->axis_max[a] - d->axis_min[a]) / 4;
+    if (value < center - dead) return -1;
+    if (value > center + dead) return 1;
+    return 0;
+}
+
+static int device_holds(const Device *d, int kind) {
+    if (d->keys_down[kind] > 0) return 1;
+    for (int a = 0; a < NUM_AXES; a++) {
+        if ((d->axis_dir[a] < 0 && axis_neg[a] == kind) ||
+            (d->axis_dir[a] > 0 && axis_pos[a] == kind)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// recompute the merged level of a kind, appending an event if it changed
+static int update_level(int kind, uint64_t t_ns, InputEvent *out, int *count, int max) {
+    int held = 0;
+    for (int i = 0; i < EVDEV_MAX_DEVICES && !held; i++) {
+        if (devices[i].fd >= 0) held = device_holds(&devices[i], kind);
+    }
+    if (held == kind_levels[kind]) return 0;
+
+    kind_levels[kind] = held;
+    if (*count < max) {
+        out[*count].timestamp_ns = t_ns;
+        out[*count].kind = (uint8_t)kind;
+        out[*count].pressed = (uint8_t)held;
+        (*count)++;
+    }
+    return 1;
+}
+
+/******** DEVICES ********/
+
+static int test_bit(const unsigned long *bits, int bit) {
+    return (bits[bit / (8 * sizeof(long))] >> (bit % (8 * sizeof(long)))) & 1;
+}
+
+// does this device have anything we map? (skips power buttons, lid switches, mice)
+static int device_usable(int fd) {
+    unsigned long keys[KEY_MAX / (8 * sizeof(long)) + 1];
+    unsigned long abs[ABS_MAX / (8 * sizeof(long)) + 1];
+    memset(keys, 0, sizeof(keys));
+    memset(abs, 0, sizeof(abs));
+
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) >= 0) {
+        const int wanted[] = { KEY_UP, KEY_W, KEY_KP8, BTN_DPAD_UP, BTN_SOUTH };
+        for (size_t i = 0; i < sizeof(wanted) / sizeof(wanted[0]); i++) {
+            if (test_bit(keys, wanted[i])) return 1;
+        }
+    }
+    if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs)), abs) >= 0) {
+        if (test_bit(abs, ABS_HAT0X) || test_bit(abs, ABS_X)) return 1;
+    }
+    return 0;
+}
+
+static int ensure_epoll(void) {
+    if (epoll_fd >= 0) return 0;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+    for (int i = 0; i < EVDEV_MAX_DEVICES; i++) {
+        devices[i].fd = -1;
+    }
+    return 0;
+}
+
+static int add_device(int fd, int number, const char *name) {
+    int slot = -1;
+    for (int i = 0; i < EVDEV_MAX_DEVICES; i++) {
+        if (devices[i].fd < 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0 || epoll_fd < 0) return -1;
+
+    Device *d = &devices[slot];
+    memset(d, 0, sizeof(*d));
+    d->fd = fd;
+    d->number = number;
+    snprintf(d->name, sizeof(d->name), "%s", name);
+
+    for (int a = 0; a < NUM_AXES; a++) {
+        struct input_absinfo info;
+        d->axis_min[a] = -1;
+        d->axis_max[a] = 1;
+        if (ioctl(fd, EVIOCGABS(axis_code[a]), &info) == 0 && info.maximum > info.minimum) {
+            d->axis_min[a] = info.minimum;
+            d->axis_max[a] = info.maximum;
+        }
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)slot;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl evdev");
+        d->fd = -1;
+        return -1;
+    }
+    return slot;
+}
+
+// open /dev/input/eventN if it is new and usable (udev may not have fixed its
+// permissions yet, in which case the IN_ATTRIB that follows retries it)
+static void open_event_device(int number) {
+    for (int i = 0; i < EVDEV_MAX_DEVICES; i++) {
+        if (devices[i].fd >= 0 && devices[i].number == number) return;
+    }
+
+    char path[192];
+    snprintf(path, sizeof(path), "%s/event%d", watch_dir, number);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return;
+
+    if (!device_usable(fd)) {
+        close(fd);
+        return;
+    }
+
+    // kernel timestamps on the same clock as gpio edges and input_now_ns
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+
+    // keep key presses from also reaching the console under the framebuffer
+    if (grab_devices) ioctl(fd, EVIOCGRAB, 1);
+
+    char name[64] = "unknown";
+    ioctl(fd, EVIOCGNAME(sizeof(name)), name);
+    if (add_device(fd, number, name) < 0) {
+        close(fd);
+        return;
+    }
+    printf("Input: %s (%s)\n", name, path);
+}
+
+// drop a device and release everything it held
+static void remove_device(int slot, InputEvent *out, int *count, int max) {
+    Device *d = &devices[slot];
+    if (d->fd < 0) return;
+
+    if (epoll_fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, d->fd, NULL);
+    close(d->fd);
+    d->fd = -1;
+    if (d->number >= 0) printf("Input: %s removed\n", d->name);
+
+    uint64_t now = input_now_ns();
+    for (int k = 0; k < INPUT_KINDS; k++) {
+        update_level(k, now, out, count, max);
+    }
+}
+
+static int event_number(const char *name) {
+    if (strncmp(name, "event", 5) != 0) return -1;
+    char *end;
+    long n = strtol(name + 5, &end, 10);
+    if (end == name + 5 || *end != '\0') return -1;
+    return (int)n;
+}
+
+int evdev_input_attach(int fd, const char *name) {
+    if (ensure_epoll() != 0) return -1;
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return add_device(fd, -1, name) < 0 ? -1 : 0;
+}
+
+int evdev_input_open(const char *dir, int grab) {
+    memset(kind_levels, 0, sizeof(kind_levels));
+    grab_devices = grab;
+    snprintf(watch_dir, sizeof(watch_dir), "%s", dir);
+
+    if (ensure_epoll() != 0) return -1;
+
+    // watch before scanning so a device appearing in between is not missed
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 || inotify_add_watch(inotify_fd, dir, IN_CREATE | IN_ATTRIB) < 0) {
+        perror("inotify /dev/input");
+        evdev_input_close();
+        return -1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = INOTIFY_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inotify_fd, &ev);
+
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            int n = event_number(entry->d_name);
+            if (n >= 0) open_event_device(n);
+        }
+        closedir(d);
+    }
+    return 0;
+}
+
+void evdev_input_close(void) {
+    for (int i = 0; i < EVDEV_MAX_DEVICES; i++) {
+        if (devices[i].fd >= 0) {
+            close(devices[i].fd);
+            devices[i].fd = -1;
+        }
+    }
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    memset(kind_levels, 0, sizeof(kind_levels));
+}
+
+/******** EVENTS ********/
+
+static void handle_hotplug(void) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        if (len <= 0) break;
+
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ie = (const struct inotify_event *)p;
+            if (ie->len > 0) {
+                int n = event_number(ie->name);
+                if (n >= 0) open_event_device(n);
+            }
+            p += sizeof(struct inotify_event) + ie->len;
+        }
+    }
+}
+
+static void handle_device(int slot, uint32_t ready, InputEvent *out, int *count, int max) {
+    Device *d = &devices[slot];
+    struct input_event evs[EVENT_BATCH];
+
+    for (;;) {
+        ssize_t got = read(d->fd, evs, sizeof(evs));
+        if (got < 0 && errno == EAGAIN) break;
+        if (got <= 0) {
+            // ENODEV after unplug (or the writer went away in a test)
+            remove_device(slot, out, count, max);
+            return;
+        }
+
+        int num = (int)(got / (ssize_t)sizeof(evs[0]));
+        for (int i = 0; i < num; i++) {
+            const struct input_event *e = &evs[i];
+            uint64_t t = (uint64_t)e->input_event_sec * 1000000000ULL +
+                         (uint64_t)e->input_event_usec * 1000ULL;
+
+            if (e->type == EV_KEY) {
+                int kind = key_kind(e->code);
+                if (kind < 0 || e->value == 2) continue; // unmapped, or autorepeat
+                if (e->value) d->keys_down[kind]++;
+                else if (d->keys_down[kind] > 0) d->keys_down[kind]--;
+                update_level(kind, t, out, count, max);
+            } else if (e->type == EV_ABS) {
+                int a = axis_index(e->code);
+                if (a < 0) continue;
+                d->axis_dir[a] = axis_direction(d, a, e->value);
+                update_level(axis_neg[a], t, out, count, max);
+                update_level(axis_pos[a], t, out, count, max);
+            } else if (e->type == EV_SYN && e->code == SYN_DROPPED) {
+                // the kernel buffer overflowed; forget this device's state rather than guess
+                memset(d->keys_down, 0, sizeof(d->keys_down));
+                memset(d->axis_dir, 0, sizeof(d->axis_dir));
+                for (int k = 0; k < INPUT_KINDS; k++) {
+                    update_level(k, t, out, count, max);
+                }
+            }
+        }
+        if (num < EVENT_BATCH) break;
+    }
+
+    if (ready & (EPOLLHUP | EPOLLERR)) remove_device(slot, out, count, max);
+}
+
+int evdev_input_read(InputEvent *events, int max, int timeout_ms) {
+    if (epoll_fd < 0) return -1;
+
+    struct epoll_event ready[EVDEV_MAX_DEVICES + 1];
+    int n = epoll_wait(epoll_fd, ready, EVDEV_MAX_DEVICES + 1, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        perror("epoll_wait evdev");
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t tag = ready[i].data.u32;
+        if (tag == INOTIFY_TAG) {
+            handle_hotplug();
+        } else if (tag < EVDEV_MAX_DEVICES && devices[tag].fd >= 0) {
+            handle_device((int)tag, ready[i].events, events, &count, max);
+        }
+    }
+    return count;
+}
+
+int evdev_input_level(int kind) {
+    if (kind < 0 || kind >= INPUT_KINDS) return 0;
+    return kind_levels[kind];
+}
+
+int evdev_input_devices(void) {
+    if (epoll_fd < 0) return 0;
+    int n = 0;
+    for (int i = 0; i < EVDEV_MAX_DEVICES; i++) {
+        if (devices[i].fd >= 0) n++;
+    }
+    return n;
+}
+
+int evdev_input_fd(void) {
+    return epoll_fd;
+}
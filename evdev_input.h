@@ -0,0 +1,37 @@
+// evdev_input.h -- keyboards and gamepads read straight from /dev/input/event*, with hotplug
+
+#include "declarations.h"
+#include "input.h"
+
+#ifndef EVDEV_INPUT_H
+#define EVDEV_INPUT_H
+
+#define EVDEV_INPUT_DIR "/dev/input"
+#define EVDEV_MAX_DEVICES 16
+
+// open every usable event device in dir and watch it for devices plugged in later.
+// grab = take devices exclusively (so keys do not also reach the console).
+// returns -1 if the directory cannot be watched
+int evdev_input_open(const char *dir, int grab);
+
+// use an already opened fd as a device (anything producing struct input_event
+// records, such as a pipe in a test). axes without range info are treated as hats
+int evdev_input_attach(int fd, const char *name);
+
+// wait up to timeout_ms (0 = just check) and handle pending device events and
+// hotplug. changes of the merged direction levels are stored in events[] (kind,
+// pressed, timestamp), returns how many or -1 on error
+int evdev_input_read(InputEvent *events, int max, int timeout_ms);
+
+// merged level over all devices of an InputKind (1 = held)
+int evdev_input_level(int kind);
+
+// number of devices currently open
+int evdev_input_devices(void);
+
+// epoll fd that becomes readable when a device or hotplug event is pending
+int evdev_input_fd(void);
+
+void evdev_input_close(void);
+
+#endif
@@ -0,0 +1,195 @@
+// evdevtest.c -- exercise the evdev keyboard/gamepad input without a keypad
+//
+//   make evdevtest
+//   ./evdevtest -m     (mock: feeds fake input events through pipes)
+//   ./evdevtest        (creates a virtual keypad with /dev/uinput, needs root or
+//                       the uinput group, and drives it through hotplug and unplug)
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+
+#include "evdev_input.h"
+
+static int failures = 0;
+
+static void emit(int fd, int type, int code, int value) {
+    struct input_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = (unsigned short)type;
+    ev.code = (unsigned short)code;
+    ev.value = value;
+    if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) perror("write input event");
+}
+
+static void emit_syn(int fd, int type, int code, int value) {
+    emit(fd, type, code, value);
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+}
+
+// read until `want` level changes arrive (or the timeout passes) and compare them
+static void expect(const char *what, int timeout_ms, int want, const int *kinds, const int *pressed) {
+    InputEvent got[32];
+    int n = 0;
+    for (int waited = 0; waited <= timeout_ms && n < 32; waited += 10) {
+        int r = evdev_input_read(got + n, 32 - n, 10);
+        if (r > 0) n += r;
+        if (n >= want && timeout_ms == 0) break;
+        if (n >= want && waited > 20) break; // short grace period for stray extras
+    }
+
+    int ok = (n == want);
+    for (int i = 0; ok && i < want; i++) {
+        ok = (got[i].kind == kinds[i] && got[i].pressed == pressed[i]);
+    }
+    printf("  %-40s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) {
+        failures++;
+        for (int i = 0; i < n; i++) printf("    got kind %d pressed %d\n", got[i].kind, got[i].pressed);
+    }
+}
+
+/******** MOCK ********/
+
+static int run_mock(void) {
+    int kbd[2], pad[2];
+    if (pipe(kbd) < 0 || pipe(pad) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    if (evdev_input_attach(kbd[0], "mock keyboard") != 0 ||
+        evdev_input_attach(pad[0], "mock gamepad") != 0) {
+        return 1;
+    }
+    printf("evdevtest mock:\n");
+
+    emit_syn(kbd[1], EV_KEY, KEY_UP, 1);
+    emit_syn(kbd[1], EV_KEY, KEY_UP, 2); // autorepeat
+    emit_syn(kbd[1], EV_KEY, KEY_UP, 0);
+    expect("key press and release", 0, 2, (int[]){ INPUT_UP, INPUT_UP }, (int[]){ 1, 0 });
+
+    emit_syn(kbd[1], EV_KEY, KEY_LEFT, 1);
+    expect("key held", 0, 1, (int[]){ INPUT_LEFT }, (int[]){ 1 });
+    emit_syn(pad[1], EV_ABS, ABS_HAT0X, -1);
+    expect("second device holding too adds nothing", 0, 0, NULL, NULL);
+    emit_syn(kbd[1], EV_KEY, KEY_LEFT, 0);
+    expect("still held by the second device", 0, 0, NULL, NULL);
+    emit_syn(pad[1], EV_ABS, ABS_HAT0X, 0);
+    expect("released when the last one lets go", 0, 1, (int[]){ INPUT_LEFT }, (int[]){ 0 });
+
+    emit_syn(pad[1], EV_ABS, ABS_HAT0Y, 1);
+    emit(pad[1], EV_SYN, SYN_DROPPED, 0);
+    expect("overflow drops held directions", 0, 2, (int[]){ INPUT_DOWN, INPUT_DOWN }, (int[]){ 1, 0 });
+
+    emit_syn(kbd[1], EV_KEY, KEY_ESC, 1);
+    emit_syn(kbd[1], EV_KEY, KEY_F1, 1); // unmapped
+    expect("escape quits, other keys ignored", 0, 1, (int[]){ INPUT_QUIT }, (int[]){ 1 });
+
+    emit_syn(pad[1], EV_ABS, ABS_HAT0X, 1);
+    close(pad[1]);
+    expect("unplug releases what it held", 0, 2, (int[]){ INPUT_RIGHT, INPUT_RIGHT }, (int[]){ 1, 0 });
+    if (evdev_input_devices() != 1) {
+        printf("  device count after unplug: FAILED\n");
+        failures++;
+    }
+
+    evdev_input_close();
+    close(kbd[1]);
+    printf("evdevtest mock: %s (%d failures)\n", failures ? "FAILED" : "ok", failures);
+    return failures ? 1 : 0;
+}
+
+/******** UINPUT ********/
+
+static int create_virtual_pad(void) {
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("/dev/uinput");
+        return -1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_KEYBIT, KEY_UP);
+    ioctl(fd, UI_SET_KEYBIT, KEY_DOWN);
+    ioctl(fd, UI_SET_KEYBIT, KEY_ESC);
+    ioctl(fd, UI_SET_KEYBIT, BTN_SOUTH);
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+    ioctl(fd, UI_SET_ABSBIT, ABS_X);
+
+    struct uinput_abs_setup abs;
+    memset(&abs, 0, sizeof(abs));
+    abs.code = ABS_X;
+    abs.absinfo.minimum = 0;
+    abs.absinfo.maximum = 255;
+    abs.absinfo.value = 128;
+    ioctl(fd, UI_ABS_SETUP, &abs);
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x1234;
+    setup.id.product = 0x5678;
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "crossy virtual keypad");
+
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        perror("uinput create");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int run_uinput(void) {
+    // watch first so the new device arrives through the hotplug path
+    if (evdev_input_open(EVDEV_INPUT_DIR, 0) != 0) return 1;
+    int before = evdev_input_devices();
+
+    int fd = create_virtual_pad();
+    if (fd < 0) return 1;
+    printf("evdevtest uinput:\n");
+
+    InputEvent scratch[32];
+    for (int waited = 0; waited < 2000 && evdev_input_devices() == before; waited += 10) {
+        evdev_input_read(scratch, 32, 10);
+    }
+    int plugged = (evdev_input_devices() == before + 1);
+    printf("  %-40s %s\n", "hotplug picks up the new device", plugged ? "ok" : "FAILED");
+    if (!plugged) {
+        failures++;
+    } else {
+        emit_syn(fd, EV_KEY, KEY_UP, 1);
+        emit_syn(fd, EV_KEY, KEY_UP, 0);
+        expect("key press and release", 500, 2, (int[]){ INPUT_UP, INPUT_UP }, (int[]){ 1, 0 });
+
+        emit_syn(fd, EV_ABS, ABS_X, 10);
+        emit_syn(fd, EV_ABS, ABS_X, 250);
+        emit_syn(fd, EV_ABS, ABS_X, 130);
+        expect("stick left, right, centre", 500, 4,
+               (int[]){ INPUT_LEFT, INPUT_LEFT, INPUT_RIGHT, INPUT_RIGHT }, (int[]){ 1, 0, 1, 0 });
+
+        emit_syn(fd, EV_KEY, KEY_DOWN, 1);
+        expect("key held", 500, 1, (int[]){ INPUT_DOWN }, (int[]){ 1 });
+    }
+
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+    if (plugged) {
+        expect("unplug releases what it held", 1000, 1, (int[]){ INPUT_DOWN }, (int[]){ 0 });
+    }
+
+    evdev_input_close();
+    printf("evdevtest uinput: %s (%d failures)\n", failures ? "FAILED" : "ok", failures);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "-m") == 0) return run_mock();
+    if (argc == 1) return run_uinput();
+
+    fprintf(stderr, "usage: %s [-m]\n", argv[0]);
+    return 1;
+}
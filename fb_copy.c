@@ -0,0 +1,44 @@
+#include <stdint.h>
+#include <string.h>
+#include "fb_copy.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// STREAMING COPY
+// on the am335x /dev/fb0 (and kms dumb buffers) are mapped write-combined: stores
+// collect in a buffer and go out as bursts, loads go all the way to dram. a copy into
+// it wants every burst complete and aligned, and nothing that reads the destination
+// (a byte loop, a partial-word merge, a preload of dst). the source is cached, so it
+// is prefetched well ahead of the loads.
+
+void fb_copy(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+
+#ifdef __ARM_NEON
+    // up to the first burst boundary; pixels are at least 2 byte aligned, so this is
+    // whole halfwords and words, never a byte merge
+    size_t head = (FB_COPY_BURST - ((uintptr_t)d & (FB_COPY_BURST - 1))) & (FB_COPY_BURST - 1);
+    if (head > n) head = n;
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= FB_COPY_BURST; n -= FB_COPY_BURST, d += FB_COPY_BURST, s += FB_COPY_BURST) {
+        __builtin_prefetch(s + 4 * FB_COPY_BURST);
+        uint8x16_t a = vld1q_u8(s);
+        uint8x16_t b = vld1q_u8(s + 16);
+        uint8x16_t c = vld1q_u8(s + 32);
+        uint8x16_t e = vld1q_u8(s + 48);
+        vst1q_u8(d, a);
+        vst1q_u8(d + 16, b);
+        vst1q_u8(d + 32, c);
+        vst1q_u8(d + 48, e);
+    }
+#endif
+    // elsewhere libc's copy already streams (and never reads dst either)
+    memcpy(d, s, n);
+}
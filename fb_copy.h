@@ -0,0 +1,15 @@
+// fb_copy.h -- copying into uncached / write-combined framebuffer memory
+
+#include <stddef.h>
+#include "declarations.h"
+
+#ifndef FB_COPY_H
+#define FB_COPY_H
+
+#define FB_COPY_BURST 64 // bytes per store burst, one cortex-a8 cache line
+
+// copy n bytes from ordinary memory src into framebuffer memory dst. dst is only ever
+// written, in whole aligned bursts where possible, never read
+void fb_copy(void *dst, const void *src, size_t n);
+
+#endif
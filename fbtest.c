@@ -0,0 +1,765 @@
+// fbtest.c -- exercise the /dev/fb0 output paths without a framebuffer
+//
+//   make fbtest
+//   ./fbtest -m     (mock: runs platform.c's fbdev backend against a fake /dev/fb0)
+//
+// the mock stands in for the driver by defining open, ioctl, mmap, munmap and close
+// itself (the program's own definitions win over the C library's): /dev/fb0 is a
+// block of memory with a virtual screen of a chosen height, and everything else
+// under /dev and /sys is missing, so no kms, gpio or keyboard is touched. it checks
+// whole frame copies, changed-row (delta) copies, the async present thread's slot
+// exchange, and panning over one and two copies of a level background. last, it plays
+// scripted traffic through raster_draw and present_frame in every way the game can
+// draw and present, and checks that the frames on screen hash the same in all of them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/fb.h>
+
+#include "declarations.h"
+#include "pixel_format.h"
+#include "atlas.h"
+#include "raster.h"
+#include "rewind.h"
+#include "pipeline.h"
+
+#define MOCK_FD 1000
+#define MOCK_WIDTH 480
+#define MOCK_HEIGHT 272
+#define PAN_ROWS ((MAX_TOTAL_LANES + 2) * LANE_HEIGHT) // what platform.c asks for per copy
+#define POISON 0xEE
+
+static int failures = 0;
+
+/******** MOCK DRIVER ********/
+
+static uint8_t *fb_mem = NULL; // the whole virtual screen
+static size_t fb_mem_size = 0;
+static size_t fb_line = 0;
+static int fb_max_rows = 0;    // tallest virtual screen the "driver" allows
+static const char *fb_id = "";
+static struct fb_var_screeninfo fb_var;
+static int fb_pans = 0, fb_vsyncs = 0;
+static int fb_bpp = 16;        // 16 (rgb565) or 32 (xrgb8888), for the next mock_reset
+static int fb_vsync_works = 1; // FBIO_WAITFORVSYNC succeeds
+
+// a fresh framebuffer whose virtual screen can grow to max_rows
+static void mock_reset(int max_rows, const char *id) {
+    free(fb_mem);
+    fb_max_rows = max_rows < MOCK_HEIGHT ? MOCK_HEIGHT : max_rows;
+    fb_line = (size_t)MOCK_WIDTH * fb_bpp / 8;
+    fb_mem_size = fb_line * fb_max_rows;
+    fb_mem = (uint8_t *)calloc(1, fb_mem_size);
+    fb_id = id;
+    memset(&fb_var, 0, sizeof(fb_var));
+    fb_var.xres = fb_var.xres_virtual = MOCK_WIDTH;
+    fb_var.yres = fb_var.yres_virtual = MOCK_HEIGHT;
+    fb_var.bits_per_pixel = (uint32_t)fb_bpp;
+    if (fb_bpp == 32) {
+        fb_var.red.offset = 16;
+        fb_var.green.offset = 8;
+        fb_var.red.length = fb_var.green.length = fb_var.blue.length = 8;
+    } else {
+        fb_var.red.offset = 11;
+        fb_var.red.length = 5;
+        fb_var.green.offset = 5;
+        fb_var.green.length = 6;
+        fb_var.blue.length = 5;
+    }
+    fb_pans = fb_vsyncs = 0;
+}
+
+int open(const char *path, int flags, ...) {
+    va_list args;
+    va_start(args, flags);
+    int mode = va_arg(args, int);
+    va_end(args);
+    if (strcmp(path, "/dev/fb0") == 0) return MOCK_FD;
+    if (strncmp(path, "/dev/", 5) == 0 || strncmp(path, "/sys/", 5) == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    return (int)syscall(SYS_openat, AT_FDCWD, path, flags, mode);
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+    va_list args;
+    va_start(args, request);
+    void *arg = va_arg(args, void *);
+    va_end(args);
+    if (fd != MOCK_FD) return (int)syscall(SYS_ioctl, fd, request, arg);
+
+    struct fb_var_screeninfo *v = (struct fb_var_screeninfo *)arg;
+    struct fb_fix_screeninfo *f = (struct fb_fix_screeninfo *)arg;
+    switch (request) {
+    case FBIOGET_VSCREENINFO:
+        *v = fb_var;
+        return 0;
+    case FBIOGET_FSCREENINFO:
+        memset(f, 0, sizeof(*f));
+        snprintf(f->id, sizeof(f->id), "%s", fb_id);
+        f->line_length = (uint32_t)fb_line;
+        f->smem_len = (uint32_t)fb_mem_size;
+        return 0;
+    case FBIOPUT_VSCREENINFO:
+        // like a driver with fixed video memory: as tall as fits, never shorter than the screen
+        fb_var.yres_virtual = v->yres_virtual > (uint32_t)fb_max_rows ? (uint32_t)fb_max_rows
+                              : v->yres_virtual < fb_var.yres ? fb_var.yres : v->yres_virtual;
+        fb_var.yoffset = 0;
+        return 0;
+    case FBIOPAN_DISPLAY:
+        if (v->yoffset + fb_var.yres > fb_var.yres_virtual) {
+            errno = EINVAL;
+            return -1;
+        }
+        fb_var.yoffset = v->yoffset;
+        fb_pans++;
+        return 0;
+    case FBIO_WAITFORVSYNC:
+        if (!fb_vsync_works) break;
+        fb_vsyncs++;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+// nothing but the fake framebuffer is mapped by the code under test
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    (void)addr; (void)prot; (void)flags;
+    if (fd != MOCK_FD || offset != 0 || length > fb_mem_size) {
+        errno = ENODEV;
+        return MAP_FAILED;
+    }
+    return fb_mem;
+}
+
+int munmap(void *addr, size_t length) {
+    (void)length;
+    return addr == fb_mem ? 0 : -1;
+}
+
+int close(int fd) {
+    if (fd == MOCK_FD) return 0;
+    return (int)syscall(SYS_close, fd);
+}
+
+/******** CHECKS ********/
+
+static void check(const char *what, int ok) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+}
+
+// row y of the picture on screen (the window at yoffset)
+static const uint16_t *shown_row(int y) {
+    return (const uint16_t *)(fb_mem + (size_t)(fb_var.yoffset + y) * fb_line);
+}
+
+static int in_mock_rows(const void *p, int first, int rows) {
+    const uint8_t *b = (const uint8_t *)p;
+    return b >= fb_mem + (size_t)first * fb_line && b < fb_mem + (size_t)(first + rows) * fb_line;
+}
+
+// a frame where every pixel says which frame and row it belongs to
+static uint16_t frame_pixel(int frame, int x, int y) {
+    return (uint16_t)(frame * 4099 + y * 31 + x);
+}
+
+static void draw_frame(int frame, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        uint16_t *row = (uint16_t *)framebuffer_row(y);
+        for (int x = 0; x < screen_width; x++) row[x] = frame_pixel(frame, x, y);
+    }
+}
+
+static int row_is_frame(const uint16_t *row, int frame, int y) {
+    for (int x = 0; x < screen_width; x++) {
+        if (row[x] != frame_pixel(frame, x, y)) return 0;
+    }
+    return 1;
+}
+
+static int screen_is_frame(int frame) {
+    for (int y = 0; y < screen_height; y++) {
+        if (!row_is_frame(shown_row(y), frame, y)) return 0;
+    }
+    return 1;
+}
+
+static int row_is_poison(const uint16_t *row) {
+    const uint8_t *b = (const uint8_t *)row;
+    for (size_t i = 0; i < (size_t)screen_width * 2; i++) {
+        if (b[i] != POISON) return 0;
+    }
+    return 1;
+}
+
+static int start(const char *name, int max_rows, const char *id) {
+    printf("%s:\n", name);
+    mock_reset(max_rows, id);
+    screen_width = MOCK_WIDTH;
+    screen_height = MOCK_HEIGHT;
+    if (platform_init() != 0) {
+        check("platform_init", 0);
+        return -1;
+    }
+    return 0;
+}
+
+/******** COPY AND DELTA ********/
+
+static void test_copy(void) {
+    if (start("whole frame copy", MOCK_HEIGHT, "mockfb") != 0) return;
+    check("draws into a frame of its own", !in_mock_rows(framebuffer_row(0), 0, fb_max_rows));
+    draw_frame(1, 0, screen_height);
+    present_frame();
+    check("present copies it to the screen", screen_is_frame(1));
+    memset(fb_mem, POISON, fb_mem_size);
+    present_frame();
+    check("every present copies every row", screen_is_frame(1));
+    platform_shutdown();
+}
+
+static void test_delta(void) {
+    // an fbtft id turns delta present on without FB_DELTA
+    if (start("delta present (fbtft)", MOCK_HEIGHT, "fb_ili9341") != 0) return;
+    draw_frame(1, 0, screen_height);
+    present_frame();
+    check("first present copies every row", screen_is_frame(1));
+
+    memset(fb_mem, POISON, fb_mem_size);
+    present_frame();
+    int untouched = 1;
+    for (int y = 0; y < screen_height; y++) untouched &= row_is_poison(shown_row(y));
+    check("an unchanged frame writes nothing", untouched);
+
+    // runs of changed rows at the top, in the middle and at the bottom
+    static const int runs[][2] = { { 0, 3 }, { 40, 50 }, { 100, 101 }, { MOCK_HEIGHT - 5, MOCK_HEIGHT } };
+    int nruns = (int)(sizeof(runs) / sizeof(runs[0]));
+    for (int r = 0; r < nruns; r++) draw_frame(2, runs[r][0], runs[r][1]);
+    present_frame();
+    int rows_ok = 1;
+    for (int y = 0; y < screen_height; y++) {
+        int changed = 0;
+        for (int r = 0; r < nruns; r++) changed |= y >= runs[r][0] && y < runs[r][1];
+        rows_ok &= changed ? row_is_frame(shown_row(y), 2, y) : row_is_poison(shown_row(y));
+    }
+    check("only the changed runs of rows are written", rows_ok);
+
+    // a background upload without panning must not leave the hashes stale
+    check("no panning on a screen-sized framebuffer", background_upload(fb_mem, MOCK_HEIGHT, fb_line) != 0);
+    platform_shutdown();
+}
+
+/******** ASYNC PRESENT ********/
+
+// the present thread copies behind our back: give it a second to show frame
+static int wait_for_frame(int frame) {
+    for (int i = 0; i < 1000; i++) {
+        if (screen_is_frame(frame)) return 1;
+        usleep(1000);
+    }
+    return 0;
+}
+
+static void test_async(void) {
+    setenv("FB_ASYNC_PRESENT", "1", 1);
+    int failed = start("async present", MOCK_HEIGHT, "mockfb");
+    unsetenv("FB_ASYNC_PRESENT");
+    if (failed) return;
+
+    void *drawn = framebuffer_row(0);
+    draw_frame(1, 0, screen_height);
+    present_frame();
+    check("present hands the frame over and draws in another", framebuffer_row(0) != drawn);
+    check("the present thread copies it out", wait_for_frame(1));
+
+    // frames presented faster than they are copied: the game only ever gets back a
+    // slot nobody is copying from, and the last one presented is what stays on screen
+    void *slots[8];
+    int nslots = 0, reused = 0, frame;
+    for (frame = 2; frame < 200; frame++) {
+        drawn = framebuffer_row(0);
+        int k = 0;
+        while (k < nslots && slots[k] != drawn) k++;
+        if (k == nslots && nslots < 8) slots[nslots++] = drawn;
+        draw_frame(frame, 0, screen_height);
+        present_frame();
+        reused |= framebuffer_row(0) == drawn;
+        if (frame % 20 == 0) usleep(2000); // let the thread take some of them
+    }
+    check("frames rotate through three slots", nslots == 3);
+    check("a presented slot is never handed straight back", !reused);
+    check("the last frame presented is the one shown", wait_for_frame(frame - 1));
+    usleep(20000);
+    check("and it stays shown", screen_is_frame(frame - 1));
+    platform_shutdown();
+}
+
+/******** PANNING ********/
+
+#define BG_ROWS 600 // a level background, taller than the screen
+
+typedef struct {
+    int x, y, w, h;
+} Box;
+
+static uint16_t bg[BG_ROWS * MOCK_WIDTH];
+#define SPRITE_COLOR 0xF800
+
+static uint16_t bg_pixel(int x, int y) {
+    return (uint16_t)(y * 577 + x * 3 + 1);
+}
+
+// a sprite drawn the way sprite.c does it: announce the rect, then write its rows
+// that are on screen
+static void draw_box(Box b) {
+    framebuffer_dirty(b.x, b.y, b.w, b.h);
+    for (int y = b.y; y < b.y + b.h; y++) {
+        uint16_t *row = (uint16_t *)framebuffer_row(y);
+        if (!row) continue;
+        for (int x = b.x; x < b.x + b.w && x < screen_width; x++) row[x] = SPRITE_COLOR;
+    }
+}
+
+// screen rows starting at background row bg_y, with sprites at boxes[0 .. n - 1]
+// and nothing left over from earlier frames
+static int rows_show(const uint16_t *(*row_at)(int), int bg_y, const Box *boxes, int n) {
+    for (int y = 0; y < screen_height; y++) {
+        const uint16_t *row = row_at(y);
+        for (int x = 0; x < screen_width; x++) {
+            uint16_t want = bg_pixel(x, bg_y + y);
+            for (int i = 0; i < n; i++) {
+                if (x >= boxes[i].x && x < boxes[i].x + boxes[i].w &&
+                    y >= boxes[i].y && y < boxes[i].y + boxes[i].h) {
+                    want = SPRITE_COLOR;
+                }
+            }
+            if (row[x] != want) return 0;
+        }
+    }
+    return 1;
+}
+
+static const uint16_t *drawn_row(int y) {
+    return (const uint16_t *)framebuffer_row(y);
+}
+
+static void test_panning(int copies) {
+    char name[64];
+    snprintf(name, sizeof(name), "panning, %d %s", copies, copies > 1 ? "copies" : "copy");
+    // with delta present on, whose row hashes go stale while panning
+    setenv("FB_DELTA", "1", 1);
+    int failed = start(name, PAN_ROWS * copies, "mockfb");
+    unsetenv("FB_DELTA");
+    if (failed) return;
+
+    draw_frame(1, 0, screen_height);
+    present_frame();
+    check("before a level is uploaded frames are copied", screen_is_frame(1));
+
+    for (int y = 0; y < BG_ROWS; y++) {
+        for (int x = 0; x < MOCK_WIDTH; x++) bg[y * MOCK_WIDTH + x] = bg_pixel(x, y);
+    }
+    check("background upload takes the level", background_upload(bg, BG_ROWS, MOCK_WIDTH * 2) == 0);
+    check("present waits for vsync", present_waits_for_vsync());
+
+    // frame 1 at row 100
+    int vsyncs = fb_vsyncs;
+    background_scroll(100);
+    if (copies == 1) check("a lone copy is erased after a vblank", fb_vsyncs > vsyncs);
+    int first_copy = in_mock_rows(framebuffer_row(0), PAN_ROWS, PAN_ROWS) ? 1 : 0;
+    if (copies > 1) check("the first frame goes to the copy not on screen", first_copy == 1);
+    Box one[] = { { 10, 20, 30, 40 }, { 400, 250, 120, 40 } }; // the second is clipped
+    draw_box(one[0]);
+    draw_box(one[1]);
+    present_frame();
+    check("present pans to the frame", (int)fb_var.yoffset == first_copy * PAN_ROWS + 100);
+    check("and shows background and sprites", rows_show(shown_row, 100, one, 2));
+
+    // frame 2 at row 60: last frame's sprites must not survive in the copy drawn
+    background_scroll(60);
+    Box two[] = { { 200, 5, 16, 16 } };
+    draw_box(two[0]);
+    if (copies > 1) {
+        check("the next frame draws into the other copy",
+              in_mock_rows(framebuffer_row(0), (1 - first_copy) * PAN_ROWS, PAN_ROWS));
+        check("while the shown copy stays untouched", rows_show(shown_row, 100, one, 2));
+    }
+    check("the copy drawn holds only this frame", rows_show(drawn_row, 60, two, 1));
+    present_frame();
+    int second_copy = copies > 1 ? 1 - first_copy : 0;
+    check("present pans to it", (int)fb_var.yoffset == second_copy * PAN_ROWS + 60);
+    check("and shows it", rows_show(shown_row, 60, two, 1));
+
+    // frame 3, same row, nothing drawn: back in the first copy, frame 1 is erased
+    background_scroll(60);
+    check("the frame before last is erased", rows_show(drawn_row, 60, NULL, 0));
+    int pans = fb_pans;
+    present_frame();
+    if (copies == 1) check("the same row is not panned to again", fb_pans == pans);
+    check("an empty frame shows just the background", rows_show(shown_row, 60, NULL, 0));
+
+    // scrolling past the end clamps to the last screenful
+    background_scroll(BG_ROWS);
+    present_frame();
+    check("scrolling clamps to the end of the level",
+          rows_show(shown_row, BG_ROWS - MOCK_HEIGHT, NULL, 0));
+
+    // a level too tall for the virtual screen goes back to copying frames
+    check("a level too tall is refused", background_upload(bg, PAN_ROWS + 1, MOCK_WIDTH * 2) != 0);
+    check("and frames are drawn off screen again", !in_mock_rows(framebuffer_row(0), 0, fb_max_rows));
+    draw_frame(1, 0, screen_height);
+    present_frame();
+    check("and copied whole to a screen no longer panned", screen_is_frame(1));
+    platform_shutdown();
+}
+
+/******** SCRIPTED FRAMES ********/
+// a few hundred ticks of traffic over a level background, scripted into the game's
+// own state and drawn the way main.c draws it: a GameFrame becomes a RasterFrame,
+// raster_draw puts it in the back buffer and present_frame shows it. each frame is
+// hashed as it appears on screen. bands, spans, the render thread and the way the
+// display presents must never change a pixel, so every way gives the same hash. the
+// async present thread copies behind our back, so with it each frame is given a
+// second to turn into the one the first way showed
+
+#define SCRIPT_TICKS 200
+#define LEVEL_ROWS PAN_ROWS // as tall as a level gets
+#define LEVEL_LANES (LEVEL_ROWS / LANE_HEIGHT)
+#define PLAYER_W 32
+#define PLAYER_H 32
+#define CAR_W 60
+#define CAR_H 26
+#define TRAIN_W 200
+#define TRAIN_H 30
+#define BUS_W 90
+#define BUS_H 30
+
+static uint8_t player_rgba[PLAYER_W * PLAYER_H * 4];
+static uint8_t car_rgba[NUM_CAR_SPRITES][CAR_W * CAR_H * 4];
+static uint8_t train_rgba[TRAIN_W * TRAIN_H * 4];
+static uint8_t bus_rgba[BUS_W * BUS_H * 4];
+
+static uint8_t *level_bg = NULL;
+static size_t level_stride = 0;
+static RasterFrame script_scene;
+static uint64_t first_way_frames[SCRIPT_TICKS]; // hash of each frame drawn the first way
+
+// a vehicle-like image: edges fading out over two pixels, a clipped corner, clear
+// windows and a light stripe, so blits skip, copy and blend runs of pixels
+static void make_image(uint8_t *rgba, int w, int h, uint32_t rgb) {
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int edge = x < y ? x : y;
+            if (w - 1 - x < edge) edge = w - 1 - x;
+            if (h - 1 - y < edge) edge = h - 1 - y;
+            int a = edge == 0 ? 70 : edge == 1 ? 170 : 255;
+            if (x + y < 4 || (edge > 3 && y < h / 3 && (x / 7) % 3 == 1)) a = 0;
+            uint32_t c = y == h / 2 ? 0xF0F0E0 : rgb;
+            uint8_t *p = rgba + ((size_t)y * w + x) * 4;
+            p[0] = (uint8_t)(c >> 16);
+            p[1] = (uint8_t)(c >> 8);
+            p[2] = (uint8_t)c;
+            p[3] = (uint8_t)a;
+        }
+    }
+}
+
+// the cars are recolourings of one shape, packed indexed like the game's
+static void register_images(void) {
+    static int registered = 0;
+    if (registered) return;
+    registered = 1;
+
+    make_image(player_rgba, PLAYER_W, PLAYER_H, 0x20C040);
+    atlas_add(SPRITE_PLAYER, player_rgba, PLAYER_W, PLAYER_H, 0, 0, (SpriteRect){ 0, 0, PLAYER_W, PLAYER_H });
+    for (int k = 0; k < NUM_CAR_SPRITES; k++) {
+        make_image(car_rgba[k], CAR_W, CAR_H, 0x3050A0 + (uint32_t)k * 0x1F0B05);
+        atlas_add(SPRITE_CAR0 + k, car_rgba[k], CAR_W, CAR_H, 0, 0, (SpriteRect){ 0, 0, CAR_W, CAR_H });
+    }
+    atlas_group(SPRITE_CAR0, NUM_CAR_SPRITES);
+    make_image(train_rgba, TRAIN_W, TRAIN_H, 0xA02020);
+    atlas_add(SPRITE_TRAIN, train_rgba, TRAIN_W, TRAIN_H, 0, 0, (SpriteRect){ 0, 0, TRAIN_W, TRAIN_H });
+    make_image(bus_rgba, BUS_W, BUS_H, 0xE0B000);
+    atlas_add(SPRITE_SPECIAL0 + BUS, bus_rgba, BUS_W, BUS_H, 0, 0, (SpriteRect){ 0, 0, BUS_W, BUS_H });
+}
+
+// x of a vehicle w wide driving across the screen (and fully off it for a while)
+static int drive_x(int t, int speed, int start, int w, int dir) {
+    int range = screen_width + w + 40;
+    int x = (start + t * speed) % range - w - 20;
+    return dir > 0 ? x : screen_width - w - x;
+}
+
+// put tick t into the game state (which is also what the pipeline snapshots)
+static void script_tick(int t) {
+    // the camera sweeps down the level and back, resting 3 ticks in every 16
+    int moved = t / 16 * 13 + (t % 16 < 13 ? t % 16 : 12);
+    int sweep = LEVEL_ROWS - screen_height;
+    int pos = moved * 6 % (2 * sweep);
+    camera_y = pos < sweep ? pos : 2 * sweep - pos;
+
+    memset(&world, 0, sizeof(world));
+    int cars = 0, specials = 0;
+    for (int lane = 1; lane < LEVEL_LANES - 1; lane++) {
+        int dir = (lane & 1) ? 1 : -1;
+        if (lane % 9 == 4) {
+            // rails: every other train is parked
+            Train *tr = &world.trains[lane];
+            tr->active = 1;
+            tr->lane_index = lane;
+            tr->moving = lane % 2;
+            tr->dir = dir;
+            tr->x = tr->moving ? drive_x(t, 7, lane * 37, TRAIN_W, dir) : 140;
+            tr->y = lane * LANE_HEIGHT + (LANE_HEIGHT - TRAIN_H) / 2;
+        } else if (lane % 3 == 0 && specials < MAX_SPECIAL_VEHICLES) {
+            SpecialVehicle *sv = &world.specials[specials++];
+            sv->active = 1;
+            sv->lane_index = lane;
+            sv->type = BUS;
+            sv->dir = dir;
+            sv->x = drive_x(t, 2, lane * 53, BUS_W, dir);
+            sv->y = lane * LANE_HEIGHT + (LANE_HEIGHT - BUS_H) / 2;
+        } else {
+            for (int k = 0; k < 2 && cars < MAX_CARS; k++) {
+                Car *c = &world.cars[cars++];
+                c->active = 1;
+                c->lane_index = lane;
+                c->sprite_index = (lane + k) % NUM_CAR_SPRITES;
+                c->dir = dir;
+                c->x = drive_x(t, 1 + lane % 4, lane * 29 + k * 260, CAR_W, dir);
+                c->y = lane * LANE_HEIGHT + (LANE_HEIGHT - CAR_H) / 2;
+            }
+        }
+    }
+
+    // the player wanders across the middle of the screen, over the traffic
+    int walk = t * 5 % 800;
+    image_x_pos = walk < 400 ? 40 + walk : 840 - walk;
+    image_y_pos = camera_y + screen_height / 2 - PLAYER_H / 2;
+    player_facing_left = walk >= 400;
+}
+
+// like main.c's add_sprite: nothing that misses the screen reaches the rasterizer
+static void add_script_sprite(SpriteId id, int x, int y, int flip) {
+    const Sprite *s = atlas_sprite(id);
+    if (script_scene.num_sprites >= RASTER_MAX_SPRITES) return;
+    if (x >= screen_width || x + s->width <= 0 || y >= screen_height || y + s->height <= 0) return;
+    RasterSprite *r = &script_scene.sprites[script_scene.num_sprites++];
+    r->id = id;
+    r->flip = (uint8_t)flip;
+    r->x = (int16_t)x;
+    r->y = (int16_t)y;
+}
+
+// draw one game state and present it (on the render thread when pipelined)
+static void render_script(const GameFrame *f) {
+    int cam = f->camera_y;
+    script_scene.bg = level_bg;
+    script_scene.bg_rows = LEVEL_ROWS;
+    script_scene.bg_stride = level_stride;
+    script_scene.bg_y = cam;
+    script_scene.copy_bg = background_scroll(cam) != 0;
+    script_scene.num_sprites = 0;
+
+    for (int i = 0; i < MAX_CARS; i++) {
+        const Car *c = &f->world.cars[i];
+        if (c->active) add_script_sprite(SPRITE_CAR0 + c->sprite_index, c->x, c->y - cam, c->dir < 0);
+    }
+    for (int i = 0; i < MAX_TOTAL_LANES; i++) {
+        const Train *tr = &f->world.trains[i];
+        if (tr->active) add_script_sprite(SPRITE_TRAIN, tr->x, tr->y - cam, tr->dir > 0);
+    }
+    for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
+        const SpecialVehicle *sv = &f->world.specials[i];
+        if (sv->active) add_script_sprite(SPRITE_SPECIAL0 + sv->type, sv->x, sv->y - cam, sv->dir > 0);
+    }
+    add_script_sprite(SPRITE_PLAYER, f->image_x_pos, f->image_y_pos - cam, f->player_facing_left);
+
+    raster_draw(&script_scene);
+    present_frame();
+}
+
+// fnv-1a over the words of the picture on screen
+static uint64_t screen_hash(uint64_t h) {
+    size_t words = (size_t)screen_width * fb_bpp / 64;
+    for (int y = 0; y < screen_height; y++) {
+        const uint8_t *row = fb_mem + (size_t)(fb_var.yoffset + y) * fb_line;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t w;
+            memcpy(&w, row + i * 8, 8);
+            h = (h ^ w) * 0x100000001B3ULL;
+        }
+    }
+    return h;
+}
+
+typedef struct {
+    int bands;
+    int spans;
+    int pipelined;
+} DrawWay;
+
+// the hash of the frame on screen once it is the expected one, or after a second
+static uint64_t settled_hash(uint64_t expected) {
+    uint64_t h = screen_hash(0xCBF29CE484222325ULL);
+    for (int i = 0; i < 1000 && h != expected; i++) {
+        usleep(1000);
+        h = screen_hash(0xCBF29CE484222325ULL);
+    }
+    return h;
+}
+
+// every frame of the script drawn one way, hashed together. 0 if it could not be
+// drawn that way. changed counts the frames that differ from the one before. the
+// first way played (first = 1) records its frames for later async presents
+static uint64_t play_script(DrawWay way, int first, int async, int *changed) {
+    char bands[8];
+    snprintf(bands, sizeof(bands), "%d", way.bands);
+    setenv(RASTER_THREADS_ENV, bands, 1);
+    int got = raster_start();
+    unsetenv(RASTER_THREADS_ENV);
+    raster_use_spans(way.spans);
+
+    int pipelined = 0;
+    if (way.pipelined) {
+        setenv(PIPELINE_ENV, "1", 1);
+        pipelined = pipeline_start(render_script) == 0;
+        unsetenv(PIPELINE_ENV);
+    }
+
+    // start over from a freshly uploaded level, as init_level does
+    background_upload(level_bg, LEVEL_ROWS, level_stride);
+    uint64_t h = 0xCBF29CE484222325ULL, last = 0;
+    *changed = 0;
+    for (int t = 0; t < SCRIPT_TICKS; t++) {
+        script_tick(t);
+        if (pipelined) {
+            pipeline_publish();
+            pipeline_flush();
+        } else {
+            static GameFrame f;
+            rewind_capture(&f);
+            render_script(&f);
+        }
+        uint64_t frame = async ? settled_hash(first_way_frames[t]) : screen_hash(0xCBF29CE484222325ULL);
+        if (first) first_way_frames[t] = frame;
+        *changed += frame != last;
+        last = frame;
+        h = (h ^ frame) * 0x100000001B3ULL;
+    }
+
+    if (pipelined) pipeline_stop();
+    raster_stop();
+    raster_use_spans(0);
+    return got == way.bands && pipelined == way.pipelined ? h : 0;
+}
+
+static const struct {
+    const char *name;
+    int max_rows;
+    int delta;
+    int async;
+    int vsync;
+} script_displays[] = {
+    { "copied", MOCK_HEIGHT, 0, 0, 1 },
+    { "changed rows copied", MOCK_HEIGHT, 1, 0, 1 },
+    { "copied on the present thread", MOCK_HEIGHT, 0, 1, 1 },
+    { "panned, 1 copy", PAN_ROWS, 0, 0, 1 },
+    { "panned, 1 copy, no vsync", PAN_ROWS, 0, 0, 0 },
+    { "panned, 2 copies", PAN_ROWS * 2, 0, 0, 1 },
+    { "panned, 2 copies, no vsync", PAN_ROWS * 2, 0, 0, 0 },
+};
+
+static const DrawWay script_ways[] = {
+    { 1, 0, 0 }, { 2, 1, 0 }, { 3, 0, 0 }, { 5, 1, 0 }, { 8, 0, 0 }, { 1, 1, 1 }, { 4, 0, 1 },
+};
+
+// every display and way of drawing against the first: one band, painted, copied
+static void test_script(int bpp) {
+    int ndisplays = (int)(sizeof(script_displays) / sizeof(script_displays[0]));
+    int nways = (int)(sizeof(script_ways) / sizeof(script_ways[0]));
+    uint64_t reference = 0;
+    register_images();
+
+    for (int d = 0; d < ndisplays; d++) {
+        char name[96];
+        snprintf(name, sizeof(name), "scripted frames, %d bpp, %s", bpp, script_displays[d].name);
+        fb_bpp = bpp;
+        fb_vsync_works = script_displays[d].vsync;
+        if (script_displays[d].delta) setenv("FB_DELTA", "1", 1);
+        if (script_displays[d].async) setenv("FB_ASYNC_PRESENT", "1", 1);
+        int failed = start(name, script_displays[d].max_rows, "mockfb");
+        unsetenv("FB_DELTA");
+        unsetenv("FB_ASYNC_PRESENT");
+        fb_bpp = 16;
+        fb_vsync_works = 1;
+        if (failed) return;
+
+        PixelFormat format = (PixelFormat)display_pixel_format();
+        level_stride = (size_t)screen_width * pixel_bytes(format);
+        level_bg = (uint8_t *)malloc(level_stride * LEVEL_ROWS);
+        if (!level_bg || atlas_pack(format) != 0) {
+            check("out of memory", 0);
+            free(level_bg);
+            level_bg = NULL;
+            platform_shutdown();
+            return;
+        }
+        for (size_t i = 0; i < level_stride * LEVEL_ROWS; i++) {
+            level_bg[i] = (uint8_t)((i / 3 * 2654435761u) >> 11);
+        }
+
+        for (int w = 0; w < nways; w++) {
+            int changed;
+            int first = d == 0 && w == 0;
+            uint64_t h = play_script(script_ways[w], first, script_displays[d].async, &changed);
+            if (first) {
+                reference = h;
+                check("the traffic moves in every frame", changed == SCRIPT_TICKS);
+            }
+            char what[64];
+            snprintf(what, sizeof(what), "%d %s, %s%s", script_ways[w].bands,
+                     script_ways[w].bands > 1 ? "bands" : "band",
+                     script_ways[w].spans ? "spans" : "painted",
+                     script_ways[w].pipelined ? ", render thread" : "");
+            check(what, h != 0 && h == reference);
+        }
+
+        platform_shutdown();
+        atlas_free();
+        free(level_bg);
+        level_bg = NULL;
+    }
+}
+
+/******** MAIN ********/
+
+static int run_mock(void) {
+    test_copy();
+    test_delta();
+    test_async();
+    test_panning(1);
+    test_panning(2);
+    test_script(16);
+    test_script(32);
+    printf("fbtest mock: %s (%d failures)\n", failures ? "FAILED" : "ok", failures);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "-m") == 0) return run_mock();
+    fprintf(stderr, "usage: %s -m\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/gpio.h>
+#include "gpio_input.h"
+
+// GPIO CHARACTER DEVICE INPUT
+// instead of opening and reading a sysfs value file per button per frame, the lines
+// are requested once with rising and falling edge detection. the kernel queues every
+// edge with a timestamp, so a press shorter than a frame is still seen, and an idle
+// frame costs a single epoll_wait.
+
+#define MAX_REQUESTS GPIO_INPUT_MAX_LINES
+#define EVENT_BATCH 16
+
+typedef struct {
+    int fd;
+    int n;
+    unsigned int offsets[GPIO_INPUT_MAX_LINES];
+    int lines[GPIO_INPUT_MAX_LINES];
+} LineRequest;
+
+static LineRequest requests[MAX_REQUESTS];
+static int num_requests = 0;
+static int epoll_fd = -1;
+static int line_levels[GPIO_INPUT_MAX_LINES];
+
+/******** SETUP ********/
+
+static int ensure_epoll(void) {
+    if (epoll_fd >= 0) return 0;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+    return 0;
+}
+
+int gpio_input_attach(int fd, const int *lines, const unsigned int *offsets, int n) {
+    if (n <= 0 || n > GPIO_INPUT_MAX_LINES || num_requests >= MAX_REQUESTS) return -1;
+    if (ensure_epoll() != 0) return -1;
+
+    // reads happen only after epoll says so, but never let one block the game
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    LineRequest *r = &requests[num_requests];
+    r->fd = fd;
+    r->n = n;
+    for (int i = 0; i < n; i++) {
+        r->offsets[i] = offsets[i];
+        r->lines[i] = lines[i];
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)num_requests;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl gpio line");
+        return -1;
+    }
+    num_requests++;
+    return 0;
+}
+
+// request every line of one chip in a single ioctl and read their starting levels
+static int request_chip(const char *chip, const int *lines, const unsigned int *offsets, int n) {
+    int chip_fd = open(chip, O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0) {
+        perror(chip);
+        return -1;
+    }
+
+    struct gpio_v2_line_request req;
+    memset(&req, 0, sizeof(req));
+    for (int i = 0; i < n; i++) {
+        req.offsets[i] = offsets[i];
+    }
+    req.num_lines = (uint32_t)n;
+    req.config.flags = GPIO_V2_LINE_FLAG_INPUT |
+                       GPIO_V2_LINE_FLAG_EDGE_RISING |
+                       GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    req.event_buffer_size = EVENT_BATCH * n;
+    snprintf(req.consumer, sizeof(req.consumer), "%s", GPIO_INPUT_CONSUMER);
+
+    int rc = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+    close(chip_fd); // the line fd stays valid on its own
+    if (rc < 0) {
+        perror("GPIO_V2_GET_LINE_IOCTL");
+        return -1;
+    }
+
+    struct gpio_v2_line_values values;
+    memset(&values, 0, sizeof(values));
+    values.mask = (n >= 64) ? ~0ULL : ((1ULL << n) - 1);
+    if (ioctl(req.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0) {
+        for (int i = 0; i < n; i++) {
+            line_levels[lines[i]] = (int)((values.bits >> i) & 1);
+        }
+    }
+
+    if (gpio_input_attach(req.fd, lines, offsets, n) != 0) {
+        close(req.fd);
+        return -1;
+    }
+    return 0;
+}
+
+int gpio_input_open(const char *const *chips, const unsigned int *offsets, int n) {
+    if (n <= 0 || n > GPIO_INPUT_MAX_LINES) return -1;
+    memset(line_levels, 0, sizeof(line_levels));
+
+    // group the lines by chip, one request each
+    int done[GPIO_INPUT_MAX_LINES] = {0};
+    for (int i = 0; i < n; i++) {
+        if (done[i]) continue;
+
+        int lines[GPIO_INPUT_MAX_LINES];
+        unsigned int offs[GPIO_INPUT_MAX_LINES];
+        int k = 0;
+        for (int j = i; j < n; j++) {
+            if (!done[j] && strcmp(chips[j], chips[i]) == 0) {
+                lines[k] = j;
+                offs[k] = offsets[j];
+                k++;
+                done[j] = 1;
+            }
+        }
+
+        if (request_chip(chips[i], lines, offs, k) != 0) {
+            gpio_input_close();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void gpio_input_close(void) {
+    for (int i = 0; i < num_requests; i++) {
+        close(requests[i].fd);
+    }
+    num_requests = 0;
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+/******** LOOKUP ********/
+// sysfs numbers gpios globally (gpiochipB covers B .. B + ngpio - 1), the character
+// devices number chips in probe order, which need not follow the banks. the two are
+// tied together by the chip label, which the chip info ioctl also reports
+
+#define MAX_CHIPS 16
+#define DEV_DIR "/dev"
+
+typedef struct {
+    int base;
+    int ngpio;
+    char label[32];
+} SysfsChip;
+
+// first line of a small sysfs file, without the newline
+static int read_attr(const char *dir, const char *name, char *buf, size_t size) {
+    char path[PATH_MAX + 16]; // dir, then a short attribute name
+    int len = snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (len < 0 || (size_t)len >= sizeof(path)) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t got = read(fd, buf, size - 1);
+    close(fd);
+    if (got <= 0) return -1;
+    buf[got] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+static int scan_sysfs_chips(SysfsChip *chips, int max) {
+    DIR *d = opendir(GPIO_PATH);
+    if (!d) return 0;
+
+    int n = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL && n < max) {
+        if (strncmp(entry->d_name, "gpiochip", 8) != 0) continue;
+
+        char dir[PATH_MAX], base[16], ngpio[16];
+        int len = snprintf(dir, sizeof(dir), GPIO_PATH "/%s", entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(dir)) continue;
+        if (read_attr(dir, "base", base, sizeof(base)) != 0 ||
+            read_attr(dir, "ngpio", ngpio, sizeof(ngpio)) != 0 ||
+            read_attr(dir, "label", chips[n].label, sizeof(chips[n].label)) != 0) {
+            continue;
+        }
+        chips[n].base = atoi(base);
+        chips[n].ngpio = atoi(ngpio);
+        n++;
+    }
+    closedir(d);
+    return n;
+}
+
+int gpio_input_find(int gpio, char *chip, size_t size, unsigned int *offset) {
+    SysfsChip sysfs[MAX_CHIPS];
+    int num_sysfs = scan_sysfs_chips(sysfs, MAX_CHIPS);
+
+    const SysfsChip *bank = NULL;
+    for (int i = 0; i < num_sysfs; i++) {
+        if (gpio >= sysfs[i].base && gpio < sysfs[i].base + sysfs[i].ngpio) bank = &sysfs[i];
+    }
+    if (!bank) return -1;
+
+    DIR *d = opendir(DEV_DIR);
+    if (!d) return -1;
+
+    int found = -1;
+    struct dirent *entry;
+    while (found < 0 && (entry = readdir(d)) != NULL) {
+        if (strncmp(entry->d_name, "gpiochip", 8) != 0) continue;
+
+        char path[PATH_MAX];
+        int len = snprintf(path, sizeof(path), DEV_DIR "/%s", entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(path)) continue;
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+
+        struct gpiochip_info info;
+        memset(&info, 0, sizeof(info));
+        if (ioctl(fd, GPIO_GET_CHIPINFO_IOCTL, &info) == 0 &&
+            strncmp(info.label, bank->label, sizeof(info.label)) == 0 &&
+            (int)info.lines == bank->ngpio) {
+            snprintf(chip, size, "%s", path);
+            *offset = (unsigned int)(gpio - bank->base);
+            found = 0;
+        }
+        close(fd);
+    }
+    closedir(d);
+    return found;
+}
+
+/******** EVENTS ********/
+
+static int line_for_offset(const LineRequest *r, unsigned int offset) {
+    for (int i = 0; i < r->n; i++) {
+        if (r->offsets[i] == offset) return r->lines[i];
+    }
+    return -1;
+}
+
+// move queued edges of one request into edges[], returns how many
+static int drain_request(LineRequest *r, GpioEdge *edges, int max) {
+    struct gpio_v2_line_event events[EVENT_BATCH];
+    int count = 0;
+
+    while (count < max) {
+        int want = max - count;
+        if (want > EVENT_BATCH) want = EVENT_BATCH;
+
+        ssize_t got = read(r->fd, events, (size_t)want * sizeof(events[0]));
+        if (got <= 0) break; // EAGAIN: nothing left
+
+        int num = (int)(got / (ssize_t)sizeof(events[0]));
+        for (int i = 0; i < num; i++) {
+            int line = line_for_offset(r, events[i].offset);
+            if (line < 0) continue;
+
+            int pressed = (events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+            line_levels[line] = pressed;
+            edges[count].line = line;
+            edges[count].pressed = pressed;
+            edges[count].timestamp_ns = events[i].timestamp_ns;
+            count++;
+        }
+        if (num < want) break;
+    }
+    return count;
+}
+
+int gpio_input_read(GpioEdge *edges, int max, int timeout_ms) {
+    if (epoll_fd < 0) return -1;
+
+    struct epoll_event ready[MAX_REQUESTS];
+    int n = epoll_wait(epoll_fd, ready, MAX_REQUESTS, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        perror("epoll_wait gpio");
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < n && count < max; i++) {
+        uint32_t idx = ready[i].data.u32;
+        if (idx < (uint32_t)num_requests) {
+            count += drain_request(&requests[idx], edges + count, max - count);
+        }
+    }
+
+    // lines on different chips arrive per request, put them back in time order
+    for (int i = 1; i < count; i++) {
+        GpioEdge e = edges[i];
+        int j = i - 1;
+        while (j >= 0 && edges[j].timestamp_ns > e.timestamp_ns) {
+            edges[j + 1] = edges[j];
+            j--;
+        }
+        edges[j + 1] = e;
+    }
+    return count;
+}
+
+int gpio_input_level(int line) {
+    if (line < 0 || line >= GPIO_INPUT_MAX_LINES) return 0;
+    return line_levels[line];
+}
+
+int gpio_input_fd(void) {
+    return epoll_fd;
+}
@@ -0,0 +1,43 @@
+// gpio_input.h -- button input from the GPIO character device (/dev/gpiochipN) with edge events
+
+#include <stdint.h>
+#include "declarations.h"
+
+#ifndef GPIO_INPUT_H
+#define GPIO_INPUT_H
+
+#define GPIO_INPUT_MAX_LINES 8
+#define GPIO_INPUT_CONSUMER "crossy"
+
+// one edge on a button line, timestamped by the kernel (CLOCK_MONOTONIC)
+typedef struct {
+    int line;               // index into the lines passed to gpio_input_open
+    int pressed;            // 1 = rising edge (button down), 0 = falling edge
+    uint64_t timestamp_ns;
+} GpioEdge;
+
+// request lines[i] = offsets[i] on chips[i] as inputs with edge events on both edges.
+// lines on the same chip share one request. returns -1 if the character device is unusable
+int gpio_input_open(const char *const *chips, const unsigned int *offsets, int n);
+
+// the character device (chip, up to size bytes) and line offset of sysfs gpio number
+// gpio, matched through the sysfs chip's base and label. -1 if no chip claims it
+int gpio_input_find(int gpio, char *chip, size_t size, unsigned int *offset);
+
+// watch an already requested line fd (or anything else that produces struct
+// gpio_v2_line_event records, such as a pipe in a test) for lines[i] at offsets[i]
+int gpio_input_attach(int fd, const int *lines, const unsigned int *offsets, int n);
+
+// wait up to timeout_ms (0 = just check, -1 = forever) and collect pending edges,
+// returns how many were stored or -1 on error
+int gpio_input_read(GpioEdge *edges, int max, int timeout_ms);
+
+// last known level of a line (1 = held down)
+int gpio_input_level(int line);
+
+// epoll fd that becomes readable when an edge is pending, -1 when closed
+int gpio_input_fd(void);
+
+void gpio_input_close(void);
+
+#endif
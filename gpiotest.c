@@ -0,0 +1,153 @@
+// gpiotest.c -- exercise the gpio character device input without the board
+//
+//   make gpiotest
+//   ./gpiotest -m                          (mock: feeds fake edge events through a pipe)
+//   ./gpiotest /dev/gpiochip0:26 ...       (print edges from real or simulated lines)
+//   ./gpiotest 26 46 47 27                 (same, by sysfs gpio number, as the game finds them)
+//
+// with the kernel's gpio-sim module a chip can be made and poked from a shell:
+//
+//   modprobe gpio-sim
+//   mkdir -p /sys/kernel/config/gpio-sim/crossy/bank0
+//   echo 4 > /sys/kernel/config/gpio-sim/crossy/bank0/num_lines
+//   echo 1 > /sys/kernel/config/gpio-sim/crossy/live
+//   ./gpiotest /dev/gpiochipN:0 /dev/gpiochipN:1 /dev/gpiochipN:2 /dev/gpiochipN:3
+//   echo pull-up > /sys/devices/platform/gpio-sim.0/gpiochipN/sim_gpio1/pull   (press)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <linux/gpio.h>
+
+#include "gpio_input.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int signo) {
+    (void)signo;
+    stop = 1;
+}
+
+static void fake_edge(int fd, unsigned int offset, int rising, uint64_t t_ns) {
+    struct gpio_v2_line_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.timestamp_ns = t_ns;
+    ev.id = rising ? GPIO_V2_LINE_EVENT_RISING_EDGE : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+    ev.offset = offset;
+    if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) perror("write fake edge");
+}
+
+// two "chips" behind two pipes, like the board's buttons split over two banks
+static int run_mock(void) {
+    int a[2], b[2];
+    if (pipe(a) < 0 || pipe(b) < 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    int lines_a[] = { 0, 3 };
+    unsigned int offs_a[] = { 26, 27 };
+    int lines_b[] = { 1, 2 };
+    unsigned int offs_b[] = { 14, 15 };
+    if (gpio_input_attach(a[0], lines_a, offs_a, 2) != 0 ||
+        gpio_input_attach(b[0], lines_b, offs_b, 2) != 0) {
+        return 1;
+    }
+
+    int failures = 0;
+    GpioEdge edges[16];
+
+    // nothing pending: must not block or report anything
+    if (gpio_input_read(edges, 16, 0) != 0) failures++;
+
+    // a tap shorter than a frame on line 0, and a held press on line 2 from the other chip
+    fake_edge(a[1], 26, 1, 1000);
+    fake_edge(b[1], 15, 1, 1500);
+    fake_edge(a[1], 26, 0, 2000);
+    int n = gpio_input_read(edges, 16, 0);
+    int want_line[] = { 0, 2, 0 };
+    int want_pressed[] = { 1, 1, 0 };
+    if (n != 3) failures++;
+    for (int i = 0; i < n && i < 3; i++) {
+        if (edges[i].line != want_line[i] || edges[i].pressed != want_pressed[i]) failures++;
+        if (i > 0 && edges[i].timestamp_ns < edges[i - 1].timestamp_ns) failures++;
+    }
+    if (gpio_input_level(0) != 0 || gpio_input_level(2) != 1) failures++;
+
+    // more edges than fit in one read are left for the next one
+    for (int i = 0; i < 20; i++) {
+        fake_edge(a[1], 27, (i & 1) == 0, 3000 + i);
+    }
+    int first = gpio_input_read(edges, 16, 0);
+    int second = gpio_input_read(edges, 16, 0);
+    if (first != 16 || second != 4) failures++;
+    if (gpio_input_level(3) != 0) failures++;
+
+    // unknown offsets are ignored
+    fake_edge(b[1], 9, 1, 4000);
+    if (gpio_input_read(edges, 16, 0) != 0) failures++;
+
+    gpio_input_close();
+    close(a[1]);
+    close(b[1]);
+
+    printf("gpiotest mock: %s (%d failures)\n", failures ? "FAILED" : "ok", failures);
+    return failures ? 1 : 0;
+}
+
+static int run_live(int argc, char *argv[]) {
+    const char *chips[GPIO_INPUT_MAX_LINES];
+    char found[GPIO_INPUT_MAX_LINES][64];
+    unsigned int offsets[GPIO_INPUT_MAX_LINES];
+    int n = 0;
+
+    for (int i = 1; i < argc && n < GPIO_INPUT_MAX_LINES; i++) {
+        char *colon = strrchr(argv[i], ':');
+        if (!colon) {
+            char *end;
+            int gpio = (int)strtol(argv[i], &end, 10);
+            if (*end || gpio_input_find(gpio, found[n], sizeof(found[n]), &offsets[n]) != 0) {
+                fprintf(stderr, "expected chip:offset or a gpio number some chip claims, got %s\n", argv[i]);
+                return 1;
+            }
+            printf("gpio %d is %s:%u\n", gpio, found[n], offsets[n]);
+            chips[n] = found[n];
+            n++;
+            continue;
+        }
+        *colon = '\0';
+        chips[n] = argv[i];
+        offsets[n] = (unsigned int)strtoul(colon + 1, NULL, 10);
+        n++;
+    }
+
+    if (gpio_input_open(chips, offsets, n) != 0) return 1;
+    signal(SIGINT, on_signal);
+
+    printf("watching %d lines, Ctrl-C to stop\n", n);
+    while (!stop) {
+        GpioEdge edges[16];
+        int got = gpio_input_read(edges, 16, 500);
+        if (got < 0) break;
+        for (int i = 0; i < got; i++) {
+            printf("%llu.%09llu line %d (%s:%u) %s\n",
+                   (unsigned long long)(edges[i].timestamp_ns / 1000000000ULL),
+                   (unsigned long long)(edges[i].timestamp_ns % 1000000000ULL),
+                   edges[i].line, chips[edges[i].line], offsets[edges[i].line],
+                   edges[i].pressed ? "pressed" : "released");
+        }
+    }
+
+    gpio_input_close();
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "-m") == 0) return run_mock();
+    if (argc >= 2) return run_live(argc, argv);
+
+    fprintf(stderr, "usage: %s -m | chip:offset|gpio [chip:offset|gpio ...]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,106 @@
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "input.h"
+
+// INPUT QUEUE
+// whatever captures input (a dedicated thread on the board, the SDL event pump on a
+// laptop) reports raw level changes here. each button gets a lockout debouncer: the
+// first change is taken immediately, further changes within INPUT_DEBOUNCE_NS are
+// contact bounce. accepted changes go into a single-producer/single-consumer ring
+// that the game loop drains.
+
+static InputEvent queue[INPUT_QUEUE_SIZE];
+static _Atomic uint32_t queue_head = 0; // next slot the consumer reads
+static _Atomic uint32_t queue_tail = 0; // next slot the producer writes
+
+// producer-only debounce state
+static int debounced[INPUT_KINDS];
+static uint64_t last_change_ns[INPUT_KINDS];
+
+// debounced levels, published for the consumer
+static _Atomic int held[INPUT_KINDS];
+
+_Static_assert((INPUT_QUEUE_SIZE & (INPUT_QUEUE_SIZE - 1)) == 0, "queue size must be a power of two");
+
+uint64_t input_now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+void input_reset(void) {
+    atomic_store(&queue_head, 0);
+    atomic_store(&queue_tail, 0);
+    memset(debounced, 0, sizeof(debounced));
+    memset(last_change_ns, 0, sizeof(last_change_ns));
+    for (int k = 0; k < INPUT_KINDS; k++) {
+        atomic_store(&held[k], 0);
+    }
+}
+
+/******** PRODUCER ********/
+
+static void push(const InputEvent *ev) {
+    uint32_t tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue_head, memory_order_acquire);
+    if (tail - head >= INPUT_QUEUE_SIZE) return; // full: the game is not draining, drop it
+
+    queue[tail & (INPUT_QUEUE_SIZE - 1)] = *ev;
+    atomic_store_explicit(&queue_tail, tail + 1, memory_order_release);
+}
+
+void input_report(int kind, int pressed, uint64_t timestamp_ns) {
+    if (kind < 0 || kind >= INPUT_KINDS) return;
+    pressed = pressed ? 1 : 0;
+
+    if (pressed == debounced[kind]) return;
+    if (last_change_ns[kind] && timestamp_ns - last_change_ns[kind] < INPUT_DEBOUNCE_NS) return;
+
+    debounced[kind] = pressed;
+    last_change_ns[kind] = timestamp_ns;
+    atomic_store_explicit(&held[kind], pressed, memory_order_relaxed);
+
+    InputEvent ev = { .timestamp_ns = timestamp_ns, .kind = (uint8_t)kind, .pressed = (uint8_t)pressed };
+    push(&ev);
+}
+
+/******** CONSUMER ********/
+
+int input_pop(InputEvent *ev) {
+    uint32_t head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+    if (head == tail) return 0;
+
+    *ev = queue[head & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+    return 1;
+}
+
+void input_take(int *up, int *down, int *left, int *right, int *quit) {
+    *up = *down = *left = *right = 0;
+
+    uint64_t now = input_now_ns();
+    InputEvent ev;
+    while (input_pop(&ev)) {
+        if (ev.kind == INPUT_QUIT && ev.pressed) {
+            *quit = 1;
+            return;
+        }
+        if (!ev.pressed) continue;
+        if (now > ev.timestamp_ns && now - ev.timestamp_ns > INPUT_STALE_NS) continue;
+
+        switch (ev.kind) {
+            case INPUT_UP:    *up    = 1; return;
+            case INPUT_DOWN:  *down  = 1; return;
+            case INPUT_LEFT:  *left  = 1; return;
+            case INPUT_RIGHT: *right = 1; return;
+            default: break; // rewind is read as a level
+        }
+    }
+}
+
+int input_held(int kind) {
+    if (kind < 0 || kind >= INPUT_KINDS) return 0;
+    return atomic_load_explicit(&held[kind], memory_order_relaxed);
+}
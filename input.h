@@ -0,0 +1,48 @@
+// input.h -- timestamped, debounced input events passed to the game through a lock-free queue
+
+#include <stdint.h>
+#include "declarations.h"
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#define INPUT_QUEUE_SIZE 64                      // power of two
+#define INPUT_DEBOUNCE_NS (20 * 1000000ULL)      // ignore changes this soon after the last one
+#define INPUT_STALE_NS (250 * 1000000ULL)        // presses older than this are dropped unplayed
+
+typedef enum {
+    INPUT_UP,
+    INPUT_DOWN,
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_REWIND,
+    INPUT_QUIT,
+    INPUT_KINDS
+} InputKind;
+
+typedef struct {
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC, same clock as gpio edge events
+    uint8_t kind;
+    uint8_t pressed;        // 1 = went down, 0 = came up
+} InputEvent;
+
+uint64_t input_now_ns(void);
+
+// producer side (exactly one thread): report a raw button level change. it is
+// debounced and, if it counts, queued for the game. safe to call with an unchanged level
+void input_report(int kind, int pressed, uint64_t timestamp_ns);
+
+// consumer side (the game loop)
+int input_pop(InputEvent *ev);
+
+// fill the poll_input flags from the queue: at most one move per call, so moves
+// queued within one frame are played on the following frames instead of merged
+void input_take(int *up, int *down, int *left, int *right, int *quit);
+
+// debounced level of a button, readable from any thread
+int input_held(int kind);
+
+// forget queued events and levels (platform init)
+void input_reset(void);
+
+#endif
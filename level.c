@@ -0,0 +1,208 @@
+#include <string.h>
+#include "level.h"
+#include "vehicle.h"
+
+// LEVEL GENERATION AND THE GAME'S RANDOM NUMBERS
+// kept apart from main.c so tools can build levels without a display
+
+/******** RANDOM ********/
+
+// seed the game PRNG (hash first so neighbouring seeds give unrelated levels)
+void game_srand(uint32_t seed) {
+    uint32_t s = seed;
+    s ^= s >> 16;
+    s *= 0x7feb352dU;
+    s ^= s >> 15;
+    s *= 0x846ca68bU;
+    s ^= s >> 16;
+    world.rng_state = s ? s : 1; // xorshift gets stuck on 0
+}
+
+// xorshift32, non-negative like rand()
+int game_rand(void) {
+    uint32_t x = world.rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    world.rng_state = x;
+    return (int)(x >> 1);
+}
+
+/******** GENERATION ********/
+
+// lay out lanes, trains, starting traffic, player and camera for a level from a seed
+void generate_level(int level_index, uint32_t seed) {
+    game_srand(seed);
+    world.frame_counter = 0;                // reset car spawn timing
+    world.special_frame_counter = 0;        // and special vehicle spawn timing
+    
+    current_level = level_index;
+    total_lanes_current = levels[level_index].total_lanes;
+    int num_mbta_pairs = levels[level_index].num_mbta_pairs;
+
+    // scale speed with level
+    car_speed = 3 + level_index;
+    special_speed[BUS] = car_speed - 1; // a little slower than cars
+
+    // assign random directions to each lane
+    for (int i = 0; i < total_lanes_current; i++) {
+        world.lane_direction[i] = (game_rand() & 1) ? 1 : -1;
+    }
+    
+    // Initialize MBTA lane distribution
+    for (int i = 0; i < total_lanes_current; i++) {
+        world.mbta_lane_indices[i] = 0;
+    }
+
+    // reset this level's cars
+    reset_cars();
+    // reset this level's trains
+    reset_trains();
+    // reset this level's special vehicles
+    reset_specials();
+    
+    // Randomly place MBTA lane pairs
+    if (num_lane_types >= 4 && num_mbta_pairs > 0 && total_lanes_current >= 8) {
+        int mbta_pairs_placed = 0;
+        int max_attempts = num_mbta_pairs * 10;
+        int attempts = 0;
+        
+        while (mbta_pairs_placed < num_mbta_pairs && attempts < max_attempts) {
+            if (total_lanes_current < 8) break;
+            
+            int start_idx = 2 + (game_rand() % (total_lanes_current - 7));
+            
+            int can_place = 1;
+            for (int j = start_idx; j <= start_idx + 3; j++) {
+                if (world.mbta_lane_indices[j] != 0) {
+                    can_place = 0;
+                    break;
+                }
+            }
+            
+            if (can_place) {
+                world.mbta_lane_indices[start_idx] = -1;
+                world.mbta_lane_indices[start_idx + 1] = 1; // top
+                world.mbta_lane_indices[start_idx + 2] = 1; // bottom
+                world.mbta_lane_indices[start_idx + 3] = -2;
+
+                // configure trains
+                // top
+                Train* train_top = &world.trains[start_idx + 1];
+                train_top->active = 1;
+                train_top->lane_index = start_idx + 1;
+                train_top->moving = game_rand() & 1; // random 0 for parked or 1 for moving
+                train_top->dir = -1;            // top train always faces left
+                train_top->y = (start_idx + 1) * LANE_HEIGHT + ((LANE_HEIGHT - train_height) / 2); // center vertically
+                // if moving, start off screen
+                if (train_top->moving) {
+                    // also give every moving train a random start delay distance
+                    int offset = game_rand() % screen_width;
+                    train_top->x = screen_width + offset; // offscreen right
+                } else {
+                    // if parked, start at a random x on screen
+                    train_top->x = game_rand() % (screen_width - train_width);
+                }
+
+                // bottom
+                Train* train_bottom = &world.trains[start_idx + 2];
+                train_bottom->active = 1;
+                train_bottom->lane_index = start_idx + 2;
+                train_bottom->moving = game_rand() & 1; // random 0 for parked or 1 for moving
+                train_bottom->dir = 1;            // bottom train always faces right
+                train_bottom->y = (start_idx + 2) * LANE_HEIGHT + ((LANE_HEIGHT - train_height) / 2); // center vertically
+                // if moving, start off screen
+                if (train_bottom->moving) {
+                    // also give every moving train a random start delay distance
+                    int offset = game_rand() % screen_width;
+                    train_bottom->x = -train_width - offset; // offscreen left
+                } else {
+                    // if parked, start at a random x on screen
+                    train_bottom->x = game_rand() % (screen_width - train_width);
+                }
+
+                mbta_pairs_placed++;
+            }
+            attempts++;
+        }
+    }
+
+    // ksenia-proof: start with some cars so that roads aren't empty
+    int initial_cars_max = current_level + 4;
+    int spawned = 0;
+
+    while (spawned < initial_cars_max) {
+        int lane = 2 + game_rand() % (total_lanes_current - 4);
+        // skip mbta
+        if (world.mbta_lane_indices[lane] == 1) continue;
+        int dir = world.lane_direction[lane];
+        // first spawn the car normally
+        spawn_car_in_lane(lane, dir);
+        // then move it to a random x
+        for (int i = 0; i < MAX_CARS; i++) {
+            if (world.cars[i].active && world.cars[i].lane_index == lane) {
+                world.cars[i].x = game_rand() % (screen_width - car_width);
+                world.cars[i].fx = world.cars[i].x << FIX_SHIFT;
+                break;
+            }
+        }
+        spawned++;
+    }
+    
+    // let traffic settle into its normal flow before anyone sees it
+    for (int f = 0; f < LEVEL_WARMUP_FRAMES; f++) {
+        update_cars();
+        update_trains();
+        update_specials();
+    }
+
+    build_static_obstacles();
+    reset_player_and_camera();
+}
+
+int player_lane_y(int lane) {
+    return lane * LANE_HEIGHT + (LANE_HEIGHT - img_height) / 2;
+}
+
+// put the player on the bottom start lane and the camera on the bottom building
+void reset_player_and_camera(void) {
+    // reset character position to bottom start lane
+    image_x_pos = (screen_width - img_width) / 2;
+    image_y_pos = player_lane_y(total_lanes_current - 1);
+    if (image_x_pos < 0) image_x_pos = 0;
+    
+    // reset camera to show building lane at bottom
+    camera_y = ((total_lanes_current + 1) * LANE_HEIGHT) - screen_height;
+    if (camera_y < -LANE_HEIGHT) camera_y = -LANE_HEIGHT;
+    
+    // update which lanes are visible
+    first_lane_index = camera_y / LANE_HEIGHT;
+}
+
+/******** HANDING OVER ********/
+
+void level_state_save(LevelState *s) {
+    memcpy(&s->world, &world, sizeof(World));
+    s->level_index = current_level;
+    s->total_lanes = total_lanes_current;
+    s->car_speed = car_speed;
+    memcpy(s->special_speed, special_speed, sizeof(s->special_speed));
+    memcpy(s->static_obstacles, static_obstacles, sizeof(s->static_obstacles));
+    s->image_x_pos = image_x_pos;
+    s->image_y_pos = image_y_pos;
+    s->camera_y = camera_y;
+    s->first_lane_index = first_lane_index;
+}
+
+void level_state_load(const LevelState *s) {
+    memcpy(&world, &s->world, sizeof(World));
+    current_level = s->level_index;
+    total_lanes_current = s->total_lanes;
+    car_speed = s->car_speed;
+    memcpy(special_speed, s->special_speed, sizeof(special_speed));
+    memcpy(static_obstacles, s->static_obstacles, sizeof(static_obstacles));
+    image_x_pos = s->image_x_pos;
+    image_y_pos = s->image_y_pos;
+    camera_y = s->camera_y;
+    first_lane_index = s->first_lane_index;
+}
@@ -0,0 +1,35 @@
+// level.h -- declarations for building a level's lanes, trains, and starting traffic
+
+#include "declarations.h"
+#include "vehicle.h"
+
+#ifndef LEVEL_H
+#define LEVEL_H
+
+// lay out lanes, trains, starting traffic, player and camera for a level.
+// the same seed always gives the same level (and the same traffic afterwards)
+void generate_level(int level_index, uint32_t seed);
+
+// put the player on the bottom start lane and the camera on the bottom building
+void reset_player_and_camera(void);
+
+// the player's y standing in a lane: centred in it, which every move keeps
+int player_lane_y(int lane);
+
+// everything generate_level sets up. the simulation state is per thread, so a level
+// generated on a worker thread is saved into one of these and loaded by the game thread
+typedef struct {
+    World world;
+    int level_index;
+    int total_lanes;
+    int car_speed;
+    int special_speed[TYPE_COUNT];
+    StaticObstacle static_obstacles[MAX_TOTAL_LANES];
+    int image_x_pos, image_y_pos;
+    int camera_y, first_lane_index;
+} LevelState;
+
+void level_state_save(LevelState *s);
+void level_state_load(const LevelState *s);
+
+#endif
@@ -3,9 +3,17 @@
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "declarations.h"
 #include "vehicle.h"
+#include "level.h"
+#include "solver.h"
+#include "catalog.h"
+#include "rewind.h"
+#include "atlas.h"
+#include "pipeline.h"
+#include "raster.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -17,11 +25,211 @@
 #endif
 
 //FORWARD DECLARATIONS
-static void show_popup_and_wait(unsigned char *popup_data, int popup_width, int popup_height);
+static void draw_popup(SpriteId popup);
+static void wait_for_up(void);
+static void show_popup_and_wait(SpriteId popup);
 
-//HELPER FUNCTIONS
-static uint16_t rgb_to_rgb565(unsigned char r, unsigned char g, unsigned char b) {
-    return (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+// which slice of the seed catalog to play (0 = easy, 1 = normal, 2 = hard)
+static int difficulty_bucket = 1;
+
+// SPRITES
+// every image packed into the atlas in the display's pixel format once platform_init
+// has picked it. cars keep their own sizes (the simulation collides with car 1's)
+static int car_sprite_w[NUM_CAR_SPRITES];
+static int car_sprite_h[NUM_CAR_SPRITES];
+
+static SpriteRect full_box(int w, int h) {
+    return (SpriteRect){ 0, 0, w, h };
+}
+
+static void convert_sprites(void) {
+    SpriteRect none = { 0, 0, 0, 0 };
+
+    atlas_add(SPRITE_PLAYER, image_data, img_width, img_height, 0, 0,
+              (SpriteRect){ PLAYER_HITBOX_MARGIN, 0, img_width - 2 * PLAYER_HITBOX_MARGIN, img_height });
+    for (int i = 0; i < NUM_CAR_SPRITES; i++) {
+        atlas_add(SPRITE_CAR0 + i, car_data[i], car_sprite_w[i], car_sprite_h[i], 0, 0,
+                  full_box(car_sprite_w[i], car_sprite_h[i]));
+    }
+    // the cars are one shape in ten colours
+    atlas_group(SPRITE_CAR0, NUM_CAR_SPRITES);
+    atlas_add(SPRITE_TRAIN, train_data, train_width, train_height, 0, 0,
+              (SpriteRect){ TRAIN_HITBOX_MARGIN, 0, train_width - 2 * TRAIN_HITBOX_MARGIN, train_height });
+    for (int i = 0; i < TYPE_COUNT; i++) {
+        atlas_add(SPRITE_SPECIAL0 + i, special_data[i], special_w[i], special_h[i], 0, 0,
+                  full_box(special_w[i], special_h[i]));
+    }
+    // popups are placed by their centre
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        atlas_add(SPRITE_INTRO0 + i, level_intro_data[i], level_intro_width[i], level_intro_height[i],
+                  level_intro_width[i] / 2, level_intro_height[i] / 2, none);
+        atlas_add(SPRITE_END0 + i, level_end_data[i], level_end_width[i], level_end_height[i],
+                  level_end_width[i] / 2, level_end_height[i] / 2, none);
+    }
+
+    if (atlas_pack((PixelFormat)display_pixel_format()) != 0) {
+        fprintf(stderr, "Warning: out of memory packing the sprite atlas\n");
+        return;
+    }
+    printf("Sprites: %d in a %zu byte atlas\n", SPRITE_COUNT, atlas_bytes());
+    int car_colors = atlas_group_colors(SPRITE_CAR0);
+    if (car_colors) {
+        printf("Sprites: %d car colours share one %dx%d map, %d colours each\n",
+               NUM_CAR_SPRITES, car_sprite_w[0], car_sprite_h[0], car_colors);
+    }
+
+    // collisions use one car size, a car drawn bigger or smaller would not match it
+    for (int i = 1; i < NUM_CAR_SPRITES; i++) {
+        SpriteRect box = atlas_entry(SPRITE_CAR0 + i)->hitbox;
+        if (car_data[i] && (box.w != car_width || box.h != car_height)) {
+            fprintf(stderr, "Warning: car sprite %d is %dx%d, collisions use %dx%d\n",
+                    i, box.w, box.h, car_width, car_height);
+        }
+    }
+
+    // only the atlas draws cars, their rgba copies can go
+    for (int i = 0; i < NUM_CAR_SPRITES; i++) {
+        if (car_data[i]) {
+            stbi_image_free(car_data[i]);
+            car_data[i] = NULL;
+        }
+    }
+}
+
+// BACKGROUND
+// the whole level's lanes prerendered in the display format, one screen-wide row per
+// world row. row 0 is the top of the building lane (world y = -LANE_HEIGHT)
+static uint8_t *level_bg = NULL;
+static int level_bg_rows = 0;
+static size_t level_bg_stride = 0; // bytes per row
+
+// pick the lane graphic for a lane index (-1 = top building, total_lanes_current = bottom building)
+static Lane *lane_for_index(int lane_index) {
+    if (lane_index == -1) {  //FIRST LANE
+        return &level_top_building[current_level];  // level-specific top building
+    } else if (lane_index == total_lanes_current) { //LAST LANE
+        return &level_bottom_building[current_level];  // level-specific bottom building
+    } else if (lane_index == 0) { //bottom sidewalk lane
+        return &lane_templates[4];
+    } else if (lane_index == total_lanes_current - 1) { //second to last lane (sidewalk)
+        return &lane_templates[5];
+    } else if (lane_index == 1) { //road start bottom (blank lower half)
+        return &lane_templates[2];
+    } else if (lane_index == total_lanes_current - 2) { //2 before last lane,  //road top (blank upper half)
+        return &lane_templates[0];
+    } else if (world.mbta_lane_indices[lane_index] == 1) {
+        return &lane_templates[3];
+    } else if (world.mbta_lane_indices[lane_index] == -1) {
+        return &lane_templates[0];
+    } else if (world.mbta_lane_indices[lane_index] == -2) {
+        return &lane_templates[2];
+    }
+    return &lane_templates[1];
+}
+
+// convert every lane of the current level once, so drawing lanes is a row copy.
+// returns the number of rows written to bg
+static int build_level_background(uint8_t *bg) {
+    PixelFormat format = (PixelFormat)display_pixel_format();
+    int rows = (total_lanes_current + 2) * LANE_HEIGHT;
+    memset(bg, 0, (size_t)rows * level_bg_stride);
+
+    for (int lane_index = -1; lane_index <= total_lanes_current; lane_index++) {
+        Lane *lane = lane_for_index(lane_index);
+        if (!lane->data) continue;
+
+        int w = lane->width < screen_width ? lane->width : screen_width;
+        for (int y = 0; y < lane->height && y < LANE_HEIGHT; y++) {
+            uint8_t *dst = bg + (size_t)((lane_index + 1) * LANE_HEIGHT + y) * level_bg_stride;
+            pixel_convert_row(format, lane->data + (size_t)y * lane->width * 3, 3, dst, w);
+        }
+    }
+
+    // parked trains never move, so they are part of the lanes too
+    const AtlasEntry *e = atlas_entry(SPRITE_TRAIN);
+    for (int i = 0; i < MAX_TOTAL_LANES; i++) {
+        const Train *t = &world.trains[i];
+        if (!t->active || t->moving) continue;
+        sprite_draw_to(&e->sprite, bg, level_bg_stride, rows,
+                       t->x - e->pivot_x, t->y + LANE_HEIGHT - e->pivot_y, t->dir > 0);
+    }
+    return rows;
+}
+
+// LEVEL PREPARATION
+// everything a level needs before its intro popup: layout, warmed-up traffic and the
+// prerendered background. the next level is prepared on a worker thread while the
+// end popup of the current one is up. the worker generates into its own copy of the
+// simulation state (SIM_STATE) and draws into the background buffer that is not on
+// display, and init_level swaps both in once the thread is joined
+static pthread_t prep_thread;
+static int prep_running = 0;
+static int prepared_level = -1; // level waiting in prepared/prepared_bg for its intro
+static LevelState prepared;
+static uint8_t *prepared_bg = NULL;
+static int prepared_bg_rows = 0;
+
+// the world exactly as the current level was handed to the player
+static World level_start;
+
+static void prepare_level(int level_index) {
+    uint32_t seed = time(NULL) + level_index;  // Different seed per level
+
+    if (catalog_pick(level_index, difficulty_bucket, seed, &seed)) {
+        // already generated, simulated and solved offline by seedminer
+        generate_level(level_index, seed);
+        printf("Level %d: catalog seed %u\n", level_index + 1, seed);
+    } else {
+        // parked trains and dense traffic can wall off a level, so regenerate until
+        // the solver finds a way across (or runs out of its time budget)
+        SolveResult result;
+        uint32_t tried = seed;
+        for (int attempt = 0; attempt < SOLVER_MAX_ATTEMPTS; attempt++) {
+            tried = seed + attempt * NUM_LEVELS;
+            generate_level(level_index, tried);
+            if (solve_level(&result, solver_budget_us(total_lanes_current)) != 0) break;
+            fprintf(stderr, "Warning: level %d seed %u has no safe route, regenerating\n",
+                    level_index + 1, tried);
+        }
+        if (result.solvable > 0) {
+            printf("Level %d: crossable in %d frames, tightest gap %d cells (%d states, %ld us)\n",
+                   level_index + 1, result.arrival_frame, result.min_free_cells,
+                   result.states, result.elapsed_us);
+        } else if (result.solvable < 0) {
+            fprintf(stderr, "Warning: level %d seed %u: solver gave up after %ld us, playing it "
+                    "unchecked\n", level_index + 1, tried, result.elapsed_us);
+        } else {
+            fprintf(stderr, "Warning: level %d: no safe route in %d seeds, playing seed %u "
+                    "anyway (a catalog from ./seedminer avoids this)\n",
+                    level_index + 1, SOLVER_MAX_ATTEMPTS, tried);
+        }
+    }
+
+    level_state_save(&prepared);
+    if (prepared_bg) {
+        prepared_bg_rows = build_level_background(prepared_bg);
+    }
+    prepared_level = level_index;
+}
+
+static void *prepare_level_thread(void *arg) {
+    prepare_level((int)(intptr_t)arg);
+    return NULL;
+}
+
+// start building a level in the background (falls back to building it later in init_level)
+static void start_level_prep(int level_index) {
+    if (prep_running || level_index >= NUM_LEVELS) return;
+    if (pthread_create(&prep_thread, NULL, prepare_level_thread, (void *)(intptr_t)level_index) == 0) {
+        prep_running = 1;
+    }
+}
+
+static void finish_level_prep(void) {
+    if (prep_running) {
+        pthread_join(prep_thread, NULL);
+        prep_running = 0;
+    }
 }
 
 // level initialization (called at the start of each of our 5 predefined levels)
@@ -31,396 +239,236 @@ static void init_level(int level_index) {
         running = 0;
         return;
     }
-    
-    srand(time(NULL) + level_index);  // Different seed per level
-    frame_counter = 0;                // reset car spawn timing
-    
-    current_level = level_index;
-    total_lanes_current = levels[level_index].total_lanes;
-    int num_mbta_pairs = levels[level_index].num_mbta_pairs;
 
-    // scale speed with level
-    car_speed = 3 + level_index;
-    special_speed[BUS] = car_speed - 1; // a little slower than cars
-
-    // assign random directions to each lane
-    for (int i = 0; i < total_lanes_current; i++) {
-        lane_direction[i] = (rand() & 1) ? 1 : -1;
+    // swap in the level prepared during the last popup, or build it now
+    finish_level_prep();
+    if (prepared_level != level_index) {
+        prepare_level(level_index);
     }
-    
-    // Initialize MBTA lane distribution
-    for (int i = 0; i < total_lanes_current; i++) {
-        mbta_lane_indices[i] = 0;
+    prepared_level = -1;
+    level_state_load(&prepared);
+
+    // nothing draws from the old background after this flush
+    pipeline_flush();
+    if (prepared_bg) {
+        uint8_t *shown = level_bg;
+        level_bg = prepared_bg;
+        level_bg_rows = prepared_bg_rows;
+        prepared_bg = shown;
     }
 
-    // reset this level's cars
-    reset_cars();
-    // reset this level's trains
-    reset_trains();
-    // reset this level's special vehicles
-    reset_specials();
-    
-    // Randomly place MBTA lane pairs
-    if (num_lane_types >= 4 && num_mbta_pairs > 0 && total_lanes_current >= 8) {
-        int mbta_pairs_placed = 0;
-        int max_attempts = num_mbta_pairs * 10;
-        int attempts = 0;
-        
-        while (mbta_pairs_placed < num_mbta_pairs && attempts < max_attempts) {
-            if (total_lanes_current < 8) break;
-            
-            int start_idx = 2 + (rand() % (total_lanes_current - 7));
-            
-            int can_place = 1;
-            for (int j = start_idx; j <= start_idx + 3; j++) {
-                if (mbta_lane_indices[j] != 0) {
-                    can_place = 0;
-                    break;
-                }
-            }
-            
-            if (can_place) {
-                mbta_lane_indices[start_idx] = -1;
-                mbta_lane_indices[start_idx + 1] = 1; // top
-                mbta_lane_indices[start_idx + 2] = 1; // bottom
-                mbta_lane_indices[start_idx + 3] = -2;
-
-                // configure trains
-                // top
-                Train* train_top = &trains[start_idx + 1];
-                train_top->active = 1;
-                train_top->lane_index = start_idx + 1;
-                train_top->moving = rand() & 1; // random 0 for parked or 1 for moving
-                train_top->dir = -1;            // top train always faces left
-                train_top->y = (start_idx + 1) * LANE_HEIGHT + ((LANE_HEIGHT - train_height) / 2); // center vertically
-                // if moving, start off screen
-                if (train_top->moving) {
-                    // also give every moving train a random start delay distance
-                    int offset = rand() % screen_width;
-                    train_top->x = screen_width + offset; // offscreen right
-                } else {
-                    // if parked, start at a random x on screen
-                    train_top->x = rand() % (screen_width - train_width);
-                }
-
-                // bottom
-                Train* train_bottom = &trains[start_idx + 2];
-                train_bottom->active = 1;
-                train_bottom->lane_index = start_idx + 2;
-                train_bottom->moving = rand() & 1; // random 0 for parked or 1 for moving
-                train_bottom->dir = 1;            // bottom train always faces right
-                train_bottom->y = (start_idx + 2) * LANE_HEIGHT + ((LANE_HEIGHT - train_height) / 2); // center vertically
-                // if moving, start off screen
-                if (train_bottom->moving) {
-                    // also give every moving train a random start delay distance
-                    int offset = rand() % screen_width;
-                    train_bottom->x = -train_width - offset; // offscreen left
-                } else {
-                    // if parked, start at a random x on screen
-                    train_bottom->x = rand() % (screen_width - train_width);
-                }
-
-                mbta_pairs_placed++;
-            }
-            attempts++;
-        }
+    // hand the background to the display if it can scroll it in hardware
+    if (level_bg) {
+        background_upload(level_bg, level_bg_rows, level_bg_stride);
     }
 
-    // ksenia-proof: start with some cars so that roads aren't empty
-    int initial_cars_max = current_level + 4;
-    int spawned = 0;
-
-    while (spawned < initial_cars_max) {
-        int lane = 2 + rand() % (total_lanes_current - 4);
-        // skip mbta
-        if (mbta_lane_indices[lane] == 1) continue;
-        int dir = lane_direction[lane];
-        // first spawn the car normally
-        spawn_car_in_lane(lane, dir);
-        // then move it to a random x
-        for (int i = 0; i < MAX_CARS; i++) {
-            if (cars[i].active && cars[i].lane_index == lane) {
-                cars[i].x = rand() % (screen_width - car_width);
-                break;
-            }
-        }
-        spawned++;
-    }
-    
-    // reset character position to bottom start lane
-    image_x_pos = (screen_width - img_width) / 2;
-    image_y_pos = (total_lanes_current - 1) * LANE_HEIGHT + (LANE_HEIGHT - img_height) / 2;
-    if (image_x_pos < 0) image_x_pos = 0;
-    
-    // reset camera to show building lane at bottom
-    camera_y = ((total_lanes_current + 1) * LANE_HEIGHT) - screen_height;
-    if (camera_y < -LANE_HEIGHT) camera_y = -LANE_HEIGHT;
-    
-    // update which lanes are visible
-    first_lane_index = camera_y / LANE_HEIGHT;
+    // remember the starting state so a death restarts without regenerating
+    memcpy(&level_start, &world, sizeof(World));
+    rewind_reset();
 
     //show level intro popup AFTER setting up the new level
-    if (level_intro_data[level_index]) {
-        show_popup_and_wait(level_intro_data[level_index], 
-                           level_intro_width[level_index], 
-                           level_intro_height[level_index]);
+    show_popup_and_wait(SPRITE_INTRO0 + level_index);
+}
+
+// restart the current level after a death: one memcpy back to the starting state
+static void restart_level(void) {
+    memcpy(&world, &level_start, sizeof(World));
+    reset_player_and_camera();
+    rewind_reset();
+}
+
+// DRAW LIST
+// each frame is described as background + sprites in draw order and handed to the
+// rasterizer, which may split it into bands across threads. only vehicles in lanes
+// that meet the camera window are listed, and only if some of their pixels land on
+// screen, so a long level costs no more to draw than a short one. the list is then
+// sorted by layer and, within a layer, by sprite, so the same pixels are read back
+// to back (vehicles of one layer never overlap, so that order is free)
+static RasterFrame scene;
+
+typedef enum {
+    LAYER_CARS,
+    LAYER_TRAINS,
+    LAYER_SPECIALS,
+    LAYER_PLAYER,
+    NUM_LAYERS
+} DrawLayer;
+
+static RasterSprite listed[RASTER_MAX_SPRITES];
+static uint8_t listed_layer[RASTER_MAX_SPRITES];
+static int num_listed = 0;
+
+// lanes meeting the camera window, widened by one so sprites that hang over their
+// lane still show
+static int visible_lane_lo, visible_lane_hi;
+
+static void set_visible_lanes(int cam_y) {
+    int top = cam_y < 0 ? (cam_y - LANE_HEIGHT + 1) / LANE_HEIGHT : cam_y / LANE_HEIGHT;
+    visible_lane_lo = top - 1;
+    visible_lane_hi = (cam_y + screen_height - 1) / LANE_HEIGHT + 1;
+}
+
+static int lane_visible(int lane_index) {
+    return lane_index >= visible_lane_lo && lane_index <= visible_lane_hi;
+}
+
+// a sprite with its pivot at screen (x, y), unless none of it is on screen
+static void add_sprite(DrawLayer layer, SpriteId id, int x, int y, int flip) {
+    if (num_listed >= RASTER_MAX_SPRITES) return;
+    const AtlasEntry *e = atlas_entry(id);
+    const SpriteRect *b = &e->sprite.bounds;
+    int left = x - e->pivot_x, top = y - e->pivot_y;
+    int lo = flip ? e->sprite.width - b->x - b->w : b->x;
+    if (b->w == 0 || left + lo >= screen_width || left + lo + b->w <= 0 ||
+        top + b->y >= screen_height || top + b->y + b->h <= 0) {
+        return;
     }
+
+    RasterSprite *s = &listed[num_listed];
+    listed_layer[num_listed++] = (uint8_t)layer;
+    s->id = id;
+    s->flip = (uint8_t)flip;
+    s->x = (int16_t)left;
+    s->y = (int16_t)top;
 }
 
-static void draw_cars(void) {
+// counting sort of the listed sprites into the scene by (layer, sprite), keeping the
+// listed order among equals
+static void sort_draw_list(void) {
+    static int start[NUM_LAYERS * SPRITE_COUNT + 1];
+    memset(start, 0, sizeof(start));
+    for (int i = 0; i < num_listed; i++) {
+        start[listed_layer[i] * SPRITE_COUNT + listed[i].id + 1]++;
+    }
+    for (int k = 0; k < NUM_LAYERS * SPRITE_COUNT; k++) start[k + 1] += start[k];
+    for (int i = 0; i < num_listed; i++) {
+        scene.sprites[start[listed_layer[i] * SPRITE_COUNT + listed[i].id]++] = listed[i];
+    }
+    scene.num_sprites = num_listed;
+}
+
+static void draw_cars(const World *w, int cam_y) {
     for (int i = 0; i < MAX_CARS; i++) {
-        // skip inactive cars
-        if (!cars[i].active) continue;
-
-        // get the specific color sprite
-        unsigned char* sprite = car_data[cars[i].sprite_index];
-       
-        // loop through every pixel
-        int sprite_screen_y = cars[i].y - camera_y;
-        for (int y = 0; y < car_height; y++) {
-            int screen_y = sprite_screen_y + y;
-            // skip out of frame
-            if (screen_y < 0 || screen_y >= screen_height) continue;
-
-            for (int x = 0; x < car_width; x++) {
-                int screen_x = cars[i].x + x;
-                // skip out of frame
-                if (screen_x < 0 || screen_x >= screen_width) continue;
-
-                // if car is going left, flip image
-                int src_x = x;
-                if (cars[i].dir < 0) {
-                    src_x = car_width - 1 - x;
-                }
-
-                int img_idx = (y * car_width + src_x) * 4;
-                unsigned char r = sprite[img_idx];
-                unsigned char g = sprite[img_idx + 1];
-                unsigned char b = sprite[img_idx + 2];
-                unsigned char a = sprite[img_idx + 3];
-                
-                if (a < 128) continue;
-                uint16_t color = rgb_to_rgb565(r, g, b);
-                put_pixel(screen_x, screen_y, color);
-            }
-        }
+        // skip inactive cars and cars in lanes off screen
+        if (!w->cars[i].active) continue;
+        if (!lane_visible(w->cars[i].lane_index)) continue;
+
+        // the specific color sprite, flipped when going left
+        add_sprite(LAYER_CARS, SPRITE_CAR0 + w->cars[i].sprite_index,
+                   w->cars[i].x, w->cars[i].y - cam_y, w->cars[i].dir < 0);
     }
 }
 
-static void draw_trains(void) {
+static void draw_trains(const World *w, int cam_y) {
     for (int i = 0; i < MAX_TOTAL_LANES; i++) {
-        Train* t = &trains[i];
-        // skip inactive ones
+        const Train* t = &w->trains[i];
+        // skip inactive ones, ones off screen, and parked ones already in the background
         if (!t->active) continue;
+        if (!lane_visible(t->lane_index)) continue;
+        if (!t->moving && level_bg) continue;
 
-		int sprite_screen_y = t->y - camera_y;
-        for (int y = 0; y < train_height; y++) {
-            int screen_y = sprite_screen_y + y;
-            if (screen_y < 0 || screen_y >= screen_height) continue;
-
-            for (int x = 0; x < train_width; x++) {
-                int screen_x = t->x + x;
-                if (screen_x < 0 || screen_x >= screen_width) continue;
-
-                // flip based on direction just like others
-                int src_x = x;
-                if (t->dir > 0) {
-                    src_x = train_width - 1 - x;
-                }
-
-                int img_idx = (y * train_width + src_x) * 4;
-                unsigned char r = train_data[img_idx];
-                unsigned char g = train_data[img_idx + 1];
-                unsigned char b = train_data[img_idx + 2];
-                unsigned char a = train_data[img_idx + 3];
-
-                if (a < 128) continue;
-                uint16_t color = rgb_to_rgb565(r, g, b);
-                put_pixel(screen_x, screen_y, color);
-            }
-        }
+        // flip based on direction just like others
+        add_sprite(LAYER_TRAINS, SPRITE_TRAIN, t->x, t->y - cam_y, t->dir > 0);
     }
 }
 
-static void draw_specials(void) {
+static void draw_specials(const World *w, int cam_y) {
     for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
-        // skip inactive
-        if (!specials[i].active) continue;
-
-        SpecialVehicle* sv = &specials[i];
-        unsigned char* tex = special_data[sv->type];
-        int w = special_w[sv->type];
-        int h = special_h[sv->type];
-        if (!tex) continue;
-
-        int sprite_screen_y = sv->y - camera_y;
-
-        for (int y = 0; y < h; y++) {
-            int screen_y = sprite_screen_y + y;
-            if (screen_y < 0 || screen_y >= screen_height) continue;
-
-            for (int x = 0; x < w; x++) {
-                int screen_x = sv->x + x;
-                if (screen_x < 0 || screen_x >= screen_width) continue;
-
-                int src_x = x;
-                if (sv->dir > 0) {
-                    src_x = w - 1 - x;
-                }
-
-                int img_idx = (y * w + src_x) * 4;
-                unsigned char r = tex[img_idx];
-                unsigned char g = tex[img_idx + 1];
-                unsigned char b = tex[img_idx + 2];
-                unsigned char a = tex[img_idx + 3];
-
-                if (a < 128) continue;
-                uint16_t color = rgb_to_rgb565(r, g, b);
-                put_pixel(screen_x, screen_y, color);
-            }
-        }
+        // skip inactive ones and ones off screen
+        if (!w->specials[i].active) continue;
+        if (!lane_visible(w->specials[i].lane_index)) continue;
+
+        const SpecialVehicle* sv = &w->specials[i];
+        add_sprite(LAYER_SPECIALS, SPRITE_SPECIAL0 + sv->type, sv->x, sv->y - cam_y, sv->dir > 0);
     }
 }
 
 
-static void draw_lanes_and_sprite(void) {
-    clear_screen();
-    
-    // draw lanes
-    for (int i = -1; i < MAX_VISIBLE_LANES; i++) {
-        int lane_index = first_lane_index + i;
-        
-        //stop drawing if past the building lane after the last level lane
-        if (lane_index > total_lanes_current) break;
-        
-        int lane_world_y = lane_index * LANE_HEIGHT;
-        int lane_screen_y = lane_world_y - camera_y;
-        
-        if (lane_screen_y > screen_height) break;
-        if (lane_screen_y + LANE_HEIGHT < 0) continue;
-        
-        //LANE ORDER AHH
-        Lane *lane;
-        if (lane_index < -1) continue;
-        
-        if (lane_index == -1) {  //FIRST LANE
-            lane = &level_top_building[current_level];  // level-specific top building
-        } else if (lane_index == total_lanes_current) { //LAST LANE
-            lane = &level_bottom_building[current_level];  // level-specific bottom building
-        } else if (lane_index == 0) { //bottom sidewalk lane
-            lane = &lane_templates[4];
-        } else if (lane_index == total_lanes_current - 1) { //second to last lane (sidewalk)
-            lane = &lane_templates[5];
-        } else if (lane_index == 1) { //road start bottom (blank lower half)
-            lane = &lane_templates[2];
-        } else if (lane_index == total_lanes_current - 2) { //2 before last lane,  //road top (blank upper half)
-            lane = &lane_templates[0];
-        } else if (mbta_lane_indices[lane_index] == 1) {  
-            lane = &lane_templates[3];
-        } else if (mbta_lane_indices[lane_index] == -1) {
-            lane = &lane_templates[0];
-        } else if (mbta_lane_indices[lane_index] == -2) {
-            lane = &lane_templates[2];
-        } else {
-            lane = &lane_templates[1];
-        }
-        
-        //DRAW THEM
-        for (int y = 0; y < lane->height && y < LANE_HEIGHT; y++) {
-            int screen_y = lane_screen_y + y;
-            if (screen_y < 0 || screen_y >= screen_height) continue;
-            
-            for (int x = 0; x < lane->width && x < screen_width; x++) {
-                int img_idx = (y * lane->width + x) * 3;
-                unsigned char r = lane->data[img_idx];
-                unsigned char g = lane->data[img_idx + 1];
-                unsigned char b = lane->data[img_idx + 2];
-                
-                uint16_t color = rgb_to_rgb565(r, g, b);
-                put_pixel(x, screen_y, color);
-            }
-        }
-    }
+// draw one game state: the live globals, or a snapshot on the render thread
+static void draw_lanes_and_sprite(const World *w, int cam_y, int player_x, int player_y, int facing_left) {
+    // the prerendered lanes cover every row, so the screen does not need clearing
+    // first, unless the display scrolls a copy it already holds
+    scene.bg = level_bg;
+    scene.bg_rows = level_bg_rows;
+    scene.bg_stride = level_bg_stride;
+    scene.bg_y = cam_y + LANE_HEIGHT;
+    scene.copy_bg = background_scroll(cam_y + LANE_HEIGHT) != 0;
+    num_listed = 0;
+    set_visible_lanes(cam_y);
 
     // draw cars
-    draw_cars();
+    draw_cars(w, cam_y);
 
     // draw trains
-    draw_trains();
+    draw_trains(w, cam_y);
     
     // draw special vehicles
-    draw_specials();
-    
-    // Draw player sprite at screen position
-    int sprite_screen_y = image_y_pos - camera_y;
+    draw_specials(w, cam_y);
     
-    for (int y = 0; y < img_height; y++) {
-        int screen_y = sprite_screen_y + y;
-        if (screen_y < 0 || screen_y >= screen_height) continue;
-        
-        for (int x = 0; x < img_width; x++) {
-            int screen_x = image_x_pos + x;
-            if (screen_x < 0 || screen_x >= screen_width) continue;
-            
-            // flip left or right
-            int src_x = x;
-            if (player_facing_left) {
-                src_x = img_width - 1 - x;
-            }
+    // Draw player sprite at screen position, flipped left or right
+    add_sprite(LAYER_PLAYER, SPRITE_PLAYER, player_x, player_y - cam_y, facing_left);
 
-            int img_idx = (y * img_width + src_x) * 4;  // 4 rgba channels
-            unsigned char r = image_data[img_idx];
-            unsigned char g = image_data[img_idx + 1];
-            unsigned char b = image_data[img_idx + 2];
-            unsigned char a = image_data[img_idx + 3];  // Alpha channel
-            
-            // Skip transparent pixels
-            if (a < 128) continue;  // If mostly transparent, don't draw
-            
-            uint16_t color = rgb_to_rgb565(r, g, b);
-            put_pixel(screen_x, screen_y, color);
-        }
+    sort_draw_list();
+    raster_draw(&scene);
+}
+
+static void draw_current_state(void) {
+    draw_lanes_and_sprite(&world, camera_y, image_x_pos, image_y_pos, player_facing_left);
+}
+
+// RENDERING
+// with a render thread running, each tick hands a snapshot over and moves on; anything
+// drawn on the main thread (popups, level changes) waits for that thread to go idle first
+static void render_snapshot(const GameFrame *f) {
+    draw_lanes_and_sprite(&f->world, f->camera_y, f->image_x_pos, f->image_y_pos, f->player_facing_left);
+    present_frame();
+}
+
+// put the state just simulated on screen
+static void show_current_state(void) {
+    if (pipeline_running()) {
+        pipeline_publish();
+        return;
     }
+    draw_current_state();
+    present_frame();
 }
 
 
-// LEVEL POPUP FUNCTION
-static void show_popup_and_wait(unsigned char *popup_data, int popup_width, int popup_height) {
-    if (!popup_data) return;
-    
-    int waiting = 1;
-    int up_press, down_press, left_press, right_press, quit_press;
-    
+// LEVEL POPUP FUNCTIONS
+// draw the game state with a popup on top and present it
+static void draw_popup(SpriteId popup) {
+    if (!atlas_sprite(popup)->pixels) return;
+
     //draw current game state
-    draw_lanes_and_sprite();
+    pipeline_flush();
+    draw_current_state();
     
     // draw popup over it
-    int popup_x = (screen_width - popup_width) / 2;
-    int popup_y = (screen_height - popup_height) / 2;
-    
-    for (int y = 0; y < popup_height; y++) {
-        int screen_y = popup_y + y;
-        if (screen_y < 0 || screen_y >= screen_height) continue;
-        
-        for (int x = 0; x < popup_width; x++) {
-            int screen_x = popup_x + x;
-            if (screen_x < 0 || screen_x >= screen_width) continue;
-            
-            int img_idx = (y * popup_width + x) * 4;  // RGBA
-            unsigned char r = popup_data[img_idx];
-            unsigned char g = popup_data[img_idx + 1];
-            unsigned char b = popup_data[img_idx + 2];
-            unsigned char a = popup_data[img_idx + 3];
-            
-            if (a < 128) continue;  // Skip transparent pixels
-            
-            uint16_t color = rgb_to_rgb565(r, g, b);
-            put_pixel(screen_x, screen_y, color);
-        }
-    }
+    atlas_draw(popup, screen_width / 2, screen_height / 2, 0);
     
     present_frame();
-    
+}
+
+// ~60 fps pacing, skipped after a present that already waited for vblank
+static void frame_delay(int presented) {
+    if (pipeline_running()) {
+        pipeline_tick_wait();
+        return;
+    }
+    if (presented && present_waits_for_vsync()) return;
+#ifdef USE_SDL
+    SDL_Delay(16);
+#else
+    usleep(16000);
+#endif
+}
+
+// block until the player presses up (or quits)
+static void wait_for_up(void) {
+    int waiting = 1;
+    int up_press, down_press, left_press, right_press, quit_press;
+
     // wait for "up" buttom press
     while (waiting && running) {
         up_press = 0, down_press = 0, left_press = 0, right_press = 0, quit_press = 0;
@@ -443,10 +491,19 @@ static void show_popup_and_wait(unsigned char *popup_data, int popup_width, int
     }
 }
 
+static void show_popup_and_wait(SpriteId popup) {
+    if (!atlas_sprite(popup)->pixels) return;
+    draw_popup(popup);
+    wait_for_up();
+}
+
 // MAIN ---------------------------------------------------
 int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+    // optional difficulty: ./sprite_test [easy|normal|hard]
+    if (argc > 1) {
+        if (strcmp(argv[1], "easy") == 0) difficulty_bucket = 0;
+        else if (strcmp(argv[1], "hard") == 0) difficulty_bucket = CATALOG_BUCKETS - 1;
+    }
 
     // load player sprite
     int img_channels;
@@ -479,6 +536,8 @@ int main(int argc, char *argv[]) {
             stbi_image_free(image_data);
             return 1;
         }
+        car_sprite_w[i] = w;
+        car_sprite_h[i] = h;
         if (i == 0) {
             car_width = w;
             car_height = h;
@@ -593,9 +652,34 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // the display's pixel format is known now
+    convert_sprites();
+
+    // room for the prerendered lanes of the tallest level, twice: the one on display
+    // and the one the next level is drawn into
+    level_bg_stride = (size_t)screen_width * pixel_bytes((PixelFormat)display_pixel_format());
+    size_t bg_size = (size_t)(MAX_TOTAL_LANES + 2) * LANE_HEIGHT * level_bg_stride;
+    level_bg = (uint8_t *)malloc(bg_size);
+    prepared_bg = (uint8_t *)malloc(bg_size);
+    if (!level_bg || !prepared_bg) {
+        fprintf(stderr, "Warning: could not allocate level background\n");
+        free(level_bg);
+        free(prepared_bg);
+        level_bg = prepared_bg = NULL;
+    }
+
+    // pre-validated level seeds (optional, built with "make seedminer")
+    if (catalog_open(CATALOG_PATH) != 0) {
+        printf("Levels: no catalog at %s, checking each level as it is generated\n", CATALOG_PATH);
+    }
+
     // initialize first level
     init_level(0);
 
+    // draw and present on another core if there is one, and split drawing over a few more
+    raster_start();
+    pipeline_start(render_snapshot);
+
     while (running) {
         
         //PREVENT CHAOS
@@ -607,6 +691,16 @@ int main(int argc, char *argv[]) {
             running = 0;
         }
 
+        // scrub back one recorded tick per frame while rewind is held
+        if (rewind_held()) {
+            int shown = rewind_step();
+            if (shown) {
+                show_current_state();
+            }
+            frame_delay(shown);
+            continue;
+        }
+
         //movement only in lane increments (MOVE_STEP = 34 pixels)
         if (up) {
             image_y_pos -= MOVE_STEP;
@@ -631,16 +725,19 @@ int main(int argc, char *argv[]) {
         // at top lane?
         int current_lane = image_y_pos / LANE_HEIGHT;
         if (current_lane == 0) {
+            int next_level = current_level + 1;
+
             // Level completed! -> show popup
-            if (level_end_data[current_level]) {
-                show_popup_and_wait(level_end_data[current_level], 
-                                   level_end_width[current_level], 
-                                   level_end_height[current_level]);
+            draw_popup(SPRITE_END0 + current_level);
+            // build the next level while the player reads the popup
+            start_level_prep(next_level);
+            if (atlas_sprite(SPRITE_END0 + current_level)->pixels) {
+                wait_for_up();
             }
-            
+
             // next level
             if (running) {
-                init_level(current_level + 1);
+                init_level(next_level);
             }
             continue;
         }
@@ -673,9 +770,9 @@ int main(int argc, char *argv[]) {
 
         // check for car collisions
         if (check_car_collisions()) {
-            // draw the collision frame
-            draw_lanes_and_sprite();
-            present_frame();
+            // draw the collision frame (and make sure it is up before pausing on it)
+            show_current_state();
+            pipeline_flush();
             // brief delay so user can perceive the collision
         #ifdef USE_SDL
             SDL_Delay(800);     // 400 ms
@@ -683,22 +780,28 @@ int main(int argc, char *argv[]) {
             usleep(400000);     // 400 ms
         #endif
 
-            // restart this level
-            init_level(current_level);
+            // restart this level from its starting snapshot
+            restart_level();
             continue; // don't draw
         }
-        
-        draw_lanes_and_sprite();
-        present_frame();
 
-#ifdef USE_SDL
-        SDL_Delay(16);      // ~60 FPS
-#else
-        usleep(16000);      // 60 fps
-#endif
+        // remember this tick for rewinding
+        rewind_record();
+        
+        show_current_state();
+        frame_delay(1);
     }
 
+    pipeline_stop();
+    raster_stop();
+    finish_level_prep();
     platform_shutdown();
+    catalog_close();
+
+    free(level_bg);
+    free(prepared_bg);
+    level_bg = prepared_bg = NULL;
+    atlas_free();
 
     // CLEANUP
 
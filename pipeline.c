@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include "pipeline.h"
+
+// RENDER PIPELINE
+// the main thread polls input and simulates; a render thread draws and presents. they
+// share a triple buffer of GameFrames: the simulation fills its back slot and swaps it
+// into the middle, the renderer swaps the middle out for its front slot when there is
+// something new. neither side ever waits for the other, so a present stuck on vblank
+// (or a slow SPI panel) costs frames on screen, not simulation ticks.
+
+#define SLOT_MASK 3
+#define SLOT_FRESH 4 // middle slot holds a snapshot the renderer has not taken yet
+
+static GameFrame slots[3];
+static uint32_t slot_seq[3];
+static _Atomic int middle = 1;
+static int back = 0;  // simulation side only
+static int front = 2; // render side only
+
+static _Atomic uint32_t published = 0; // seq of the newest snapshot handed over
+static _Atomic uint32_t rendered = 0;  // seq of the newest snapshot presented
+static _Atomic int stopping = 0;
+static sem_t wake;
+
+static pthread_t render_thread;
+static int running_pipeline = 0;
+static PipelineRenderFn render_fn = NULL;
+static uint64_t next_tick_ns = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static void *render_loop(void *arg) {
+    (void)arg;
+    for (;;) {
+        sem_wait(&wake);
+        if (atomic_load(&stopping)) break;
+        // several publishes may have woken us, the newest snapshot covers them all
+        while (sem_trywait(&wake) == 0) {}
+
+        if (!(atomic_load_explicit(&middle, memory_order_acquire) & SLOT_FRESH)) continue;
+        front = atomic_exchange_explicit(&middle, front, memory_order_acq_rel) & SLOT_MASK;
+
+        render_fn(&slots[front]);
+        atomic_store_explicit(&rendered, slot_seq[front], memory_order_release);
+    }
+    return NULL;
+}
+
+int pipeline_start(PipelineRenderFn render) {
+    if (running_pipeline) return 0;
+
+    const char *env = getenv(PIPELINE_ENV);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (env && strcmp(env, "0") == 0) return -1;
+    if (!(env && strcmp(env, "1") == 0) && cores < 2) return -1;
+    if (!present_from_any_thread()) return -1;
+
+    render_fn = render;
+    back = 0;
+    front = 2;
+    atomic_store(&middle, 1);
+    atomic_store(&published, 0);
+    atomic_store(&rendered, 0);
+    atomic_store(&stopping, 0);
+    if (sem_init(&wake, 0, 0) != 0) return -1;
+    if (pthread_create(&render_thread, NULL, render_loop, NULL) != 0) {
+        sem_destroy(&wake);
+        return -1;
+    }
+    running_pipeline = 1;
+    next_tick_ns = 0;
+    printf("Render pipeline: drawing on its own thread (%ld cores)\n", cores);
+    return 0;
+}
+
+void pipeline_stop(void) {
+    if (!running_pipeline) return;
+    atomic_store(&stopping, 1);
+    sem_post(&wake);
+    pthread_join(render_thread, NULL);
+    sem_destroy(&wake);
+    running_pipeline = 0;
+}
+
+int pipeline_running(void) {
+    return running_pipeline;
+}
+
+void pipeline_publish(void) {
+    uint32_t seq = atomic_load_explicit(&published, memory_order_relaxed) + 1;
+    rewind_capture(&slots[back]);
+    slot_seq[back] = seq;
+    back = atomic_exchange_explicit(&middle, back | SLOT_FRESH, memory_order_acq_rel) & SLOT_MASK;
+    atomic_store_explicit(&published, seq, memory_order_release);
+    sem_post(&wake);
+}
+
+void pipeline_flush(void) {
+    if (!running_pipeline) return;
+    uint32_t want = atomic_load_explicit(&published, memory_order_relaxed);
+    while (atomic_load_explicit(&rendered, memory_order_acquire) != want) {
+        usleep(1000);
+    }
+}
+
+void pipeline_tick_wait(void) {
+    // fixed-rate ticks on absolute deadlines, so simulation time does not add to the period
+    uint64_t now = now_ns();
+    if (next_tick_ns == 0 || now > next_tick_ns + PIPELINE_TICK_NS) {
+        next_tick_ns = now; // first tick or fell behind: start counting again from here
+    }
+    next_tick_ns += PIPELINE_TICK_NS;
+
+    struct timespec t;
+    t.tv_sec = (time_t)(next_tick_ns / 1000000000ULL);
+    t.tv_nsec = (long)(next_tick_ns % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {}
+}
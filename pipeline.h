@@ -0,0 +1,33 @@
+// pipeline.h -- drawing and presenting on a render thread, fed snapshots of the game state
+
+#include "declarations.h"
+#include "rewind.h"
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#define PIPELINE_ENV "PIPELINE"          // "0" = never, "1" = even on a single core
+#define PIPELINE_TICK_NS 16666667ULL     // simulation tick once the present no longer paces it
+
+// draw one snapshot and present it (called on the render thread)
+typedef void (*PipelineRenderFn)(const GameFrame *f);
+
+// start the render thread. returns -1 (nothing started, draw inline) on a single core,
+// when the display can only be presented from the main thread, or if disabled
+int pipeline_start(PipelineRenderFn render);
+void pipeline_stop(void);
+int pipeline_running(void);
+
+// snapshot the current state for the render thread. never blocks; a snapshot the
+// render thread has not picked up yet is replaced by the newer one
+void pipeline_publish(void);
+
+// block until the last published snapshot is on screen and the render thread is idle.
+// call before drawing on this thread or changing anything the renderer reads
+// (level background, sprites, the display's scroll state)
+void pipeline_flush(void);
+
+// sleep until the next simulation tick
+void pipeline_tick_wait(void);
+
+#endif
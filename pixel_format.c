@@ -0,0 +1,240 @@
+#include <string.h>
+#include "pixel_format.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// PIXEL FORMATS
+// everything is converted into the display's format once, when it is loaded or
+// prerendered, so drawing a frame only ever copies (or blends) native pixels. each format gets
+// its own convert loop and its pixel size its own blit loop; adding a panel format
+// adds kernels here, never a per-pixel branch in the renderer.
+
+typedef struct {
+    const char *name;
+    int bytes;
+    void (*convert)(const uint8_t *src, int channels, void *dst, int n);
+    PixelBlitFn blit;
+    PixelIndexedBlitFn blit_indexed;
+} FormatInfo;
+
+/******** CONVERT ********/
+
+static uint16_t to_565(const uint8_t *p) {
+    return (uint16_t)(((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3));
+}
+
+static void convert_rgb565(const uint8_t *src, int channels, void *dst, int n) {
+    uint16_t *d = (uint16_t *)dst;
+    for (int i = 0; i < n; i++, src += channels) {
+        d[i] = to_565(src);
+    }
+}
+
+static void convert_rgb565_swapped(const uint8_t *src, int channels, void *dst, int n) {
+    uint16_t *d = (uint16_t *)dst;
+    for (int i = 0; i < n; i++, src += channels) {
+        uint16_t c = to_565(src);
+        d[i] = (uint16_t)((c << 8) | (c >> 8));
+    }
+}
+
+static void convert_xrgb8888(const uint8_t *src, int channels, void *dst, int n) {
+    uint32_t *d = (uint32_t *)dst;
+    for (int i = 0; i < n; i++, src += channels) {
+        d[i] = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+    }
+}
+
+static void convert_argb8888(const uint8_t *src, int channels, void *dst, int n) {
+    uint32_t *d = (uint32_t *)dst;
+    for (int i = 0; i < n; i++, src += channels) {
+        d[i] = 0xFF000000u | ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+    }
+}
+
+/******** BLIT ********/
+
+// sprites are premultiplied, so a pixel of alpha a lands as src + dst * (1 - a). runs
+// of eight fully transparent pixels are skipped and runs of eight opaque ones copied
+// whole, testing their alpha bytes as one word; only the antialiased edge of a sprite
+// pays for the blend. rgb565 scales each channel by 255 - a and divides by 255
+// rounding down: within 1 of the exact blend, src + dst never carries out of its
+// field, and 0 and 255 still come out exact.
+
+// x / 255 rounded down, exact for x < 65535
+static inline unsigned div255(unsigned x) {
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+static inline uint16_t blend565(uint16_t d, uint16_t s, unsigned a) {
+    unsigned k = 255 - a;
+    unsigned r = div255((d >> 11) * k);
+    unsigned g = div255(((d >> 5) & 0x3F) * k);
+    unsigned b = div255((d & 0x1F) * k);
+    return (uint16_t)(s + ((r << 11) | (g << 5) | b));
+}
+
+static inline uint16_t swap16(uint16_t c) {
+    return (uint16_t)((c << 8) | (c >> 8));
+}
+
+static inline uint16_t blend565_swapped(uint16_t d, uint16_t s, unsigned a) {
+    return swap16(blend565(swap16(d), swap16(s), a));
+}
+
+// the top byte comes from src, which is opaque for argb
+static inline uint32_t blend8888(uint32_t d, uint32_t s, unsigned a) {
+    unsigned k = 256 - a;
+    uint32_t rb = (((d & 0xFF00FFu) * k) >> 8) & 0xFF00FFu;
+    uint32_t g = (((d & 0x00FF00u) * k) >> 8) & 0x00FF00u;
+    return s + (rb | g);
+}
+
+// eight mixed pixels in one go, 0 if the kernel has no vector path for them
+static inline int group_none(void *d, const void *s, const uint8_t *alpha) {
+    (void)d; (void)s; (void)alpha;
+    return 0;
+}
+
+#ifdef __ARM_NEON
+// div255 on eight lanes (a channel times 255 - a stays below 16 bits)
+static inline uint16x8_t div255_neon(uint16x8_t x) {
+    return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+}
+
+static inline int group_neon565(void *dst, const void *src, const uint8_t *alpha) {
+    uint16_t *d = (uint16_t *)dst;
+    uint16x8_t dv = vld1q_u16(d);
+    uint16x8_t k = vmovl_u8(vmvn_u8(vld1_u8(alpha))); // 255 - a
+    uint16x8_t r = div255_neon(vmulq_u16(vshrq_n_u16(dv, 11), k));
+    uint16x8_t g = div255_neon(vmulq_u16(vandq_u16(vshrq_n_u16(dv, 5), vdupq_n_u16(0x3F)), k));
+    uint16x8_t b = div255_neon(vmulq_u16(vandq_u16(dv, vdupq_n_u16(0x1F)), k));
+    uint16x8_t out = vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b);
+    vst1q_u16(d, vaddq_u16(vld1q_u16((const uint16_t *)src), out));
+    return 1;
+}
+#define GROUP565 group_neon565
+#else
+#define GROUP565 group_none
+#endif
+
+#define DEFINE_BLIT(name, T, blend, group)                                                \
+static void name(void *dst, const void *src, const uint8_t *alpha, int n, int src_step) { \
+    T *d = (T *)dst;                                                                      \
+    const T *s = (const T *)src;                                                          \
+    int i = 0;                                                                            \
+    for (; i + 8 <= n; i += 8, s += 8 * src_step, alpha += 8 * src_step) {                \
+        uint64_t run;                                                                     \
+        memcpy(&run, src_step > 0 ? alpha : alpha - 7, sizeof(run));                      \
+        if (run == 0) continue;                                                           \
+        if (run == UINT64_MAX) {                                                          \
+            if (src_step > 0) memcpy(d + i, s, 8 * sizeof(T));                            \
+            else for (int k = 0; k < 8; k++) d[i + k] = s[-k];                            \
+            continue;                                                                     \
+        }                                                                                 \
+        if (src_step > 0 && group(d + i, s, alpha)) continue;                             \
+        for (int k = 0; k < 8; k++) {                                                     \
+            unsigned a = alpha[k * src_step];                                             \
+            if (a == 255) d[i + k] = s[k * src_step];                                     \
+            else if (a) d[i + k] = blend(d[i + k], s[k * src_step], a);                   \
+        }                                                                                 \
+    }                                                                                     \
+    for (; i < n; i++, s += src_step, alpha += src_step) {                                \
+        unsigned a = *alpha;                                                              \
+        if (a == 255) d[i] = *s;                                                          \
+        else if (a) d[i] = blend(d[i], *s, a);                                            \
+    }                                                                                     \
+}
+
+DEFINE_BLIT(blit565, uint16_t, blend565, GROUP565)
+DEFINE_BLIT(blit565_swapped, uint16_t, blend565_swapped, group_none)
+DEFINE_BLIT(blit8888, uint32_t, blend8888, group_none)
+
+// palette entries are premultiplied too, with an alpha each. index 0 is transparent,
+// so eight zero indices are skipped as one word; a run whose entries are all opaque
+// is copied from the palette without blending
+#define DEFINE_BLIT_INDEXED(name, T, blend)                                               \
+static void name(void *dst, const uint8_t *indices, const void *palette,                  \
+                 const uint8_t *alpha, int n, int src_step) {                             \
+    T *d = (T *)dst;                                                                      \
+    const T *pal = (const T *)palette;                                                    \
+    int i = 0;                                                                            \
+    for (; i + 8 <= n; i += 8, indices += 8 * src_step) {                                 \
+        uint64_t run;                                                                     \
+        memcpy(&run, src_step > 0 ? indices : indices - 7, sizeof(run));                  \
+        if (run == 0) continue;                                                           \
+        unsigned opaque = 255;                                                            \
+        for (int k = 0; k < 8; k++) opaque &= alpha[indices[k * src_step]];               \
+        if (opaque == 255) {                                                              \
+            for (int k = 0; k < 8; k++) d[i + k] = pal[indices[k * src_step]];            \
+            continue;                                                                     \
+        }                                                                                 \
+        for (int k = 0; k < 8; k++) {                                                     \
+            uint8_t c = indices[k * src_step];                                            \
+            unsigned a = alpha[c];                                                        \
+            if (a == 255) d[i + k] = pal[c];                                              \
+            else if (a) d[i + k] = blend(d[i + k], pal[c], a);                            \
+        }                                                                                 \
+    }                                                                                     \
+    for (; i < n; i++, indices += src_step) {                                             \
+        uint8_t c = *indices;                                                             \
+        unsigned a = alpha[c];                                                            \
+        if (a == 255) d[i] = pal[c];                                                      \
+        else if (a) d[i] = blend(d[i], pal[c], a);                                        \
+    }                                                                                     \
+}
+
+DEFINE_BLIT_INDEXED(blit_indexed565, uint16_t, blend565)
+DEFINE_BLIT_INDEXED(blit_indexed565_swapped, uint16_t, blend565_swapped)
+DEFINE_BLIT_INDEXED(blit_indexed8888, uint32_t, blend8888)
+
+// argb pixels were made opaque when converted, so they blend like xrgb
+static const FormatInfo formats[PIXEL_FORMATS] = {
+    [PIXEL_RGB565]         = { "rgb565",         2, convert_rgb565,         blit565,         blit_indexed565 },
+    [PIXEL_RGB565_SWAPPED] = { "rgb565-swapped", 2, convert_rgb565_swapped, blit565_swapped, blit_indexed565_swapped },
+    [PIXEL_XRGB8888]       = { "xrgb8888",       4, convert_xrgb8888,       blit8888,        blit_indexed8888 },
+    [PIXEL_ARGB8888]       = { "argb8888",       4, convert_argb8888,       blit8888,        blit_indexed8888 },
+};
+
+/******** API ********/
+
+int pixel_bytes(PixelFormat format) {
+    return formats[format].bytes;
+}
+
+const char *pixel_format_name(PixelFormat format) {
+    return formats[format].name;
+}
+
+int pixel_format_parse(const char *name) {
+    for (int f = 0; f < PIXEL_FORMATS; f++) {
+        if (strcmp(name, formats[f].name) == 0) return f;
+    }
+    return -1;
+}
+
+uint32_t pixel_pack(PixelFormat format, uint8_t r, uint8_t g, uint8_t b) {
+    const uint8_t rgb[3] = { r, g, b };
+    if (formats[format].bytes == 2) {
+        uint16_t packed;
+        formats[format].convert(rgb, 3, &packed, 1);
+        return packed;
+    }
+    uint32_t packed;
+    formats[format].convert(rgb, 3, &packed, 1);
+    return packed;
+}
+
+void pixel_convert_row(PixelFormat format, const uint8_t *src, int channels, void *dst, int n) {
+    formats[format].convert(src, channels, dst, n);
+}
+
+PixelBlitFn pixel_blit_kernel(PixelFormat format) {
+    return formats[format].blit;
+}
+
+PixelIndexedBlitFn pixel_indexed_blit_kernel(PixelFormat format) {
+    return formats[format].blit_indexed;
+}
@@ -0,0 +1,44 @@
+// pixel_format.h -- display pixel formats and the per-format convert/blit kernels
+
+#include <stdint.h>
+#include "declarations.h"
+
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+typedef enum {
+    PIXEL_RGB565,         // 16 bit, native endian (most panels, SDL, DRM RGB565)
+    PIXEL_RGB565_SWAPPED, // 16 bit with the bytes swapped (SPI panels fed big endian)
+    PIXEL_XRGB8888,       // 32 bit, top byte ignored (HDMI framebuffers)
+    PIXEL_ARGB8888,       // 32 bit, top byte is alpha and must be opaque
+    PIXEL_FORMATS
+} PixelFormat;
+
+// bytes per pixel
+int pixel_bytes(PixelFormat format);
+
+const char *pixel_format_name(PixelFormat format);
+
+// format by name ("rgb565", "rgb565-swapped", "xrgb8888", "argb8888"), -1 if unknown
+int pixel_format_parse(const char *name);
+
+// one 8 bit rgb color packed in format (in the low bytes of the result)
+uint32_t pixel_pack(PixelFormat format, uint8_t r, uint8_t g, uint8_t b);
+
+// convert n pixels of 8 bit rgb (channels = 3) or rgba (channels = 4) into format.
+// alpha is not kept, it lives in a separate byte per pixel (see sprite.h)
+void pixel_convert_row(PixelFormat format, const uint8_t *src, int channels, void *dst, int n);
+
+// draw n premultiplied pixels of src over dst, each weighted by its alpha byte
+// (0 = skipped, 255 = copied), stepping src by src_step pixels (-1 draws it
+// mirrored). src and alpha point at the first pixel drawn
+typedef void (*PixelBlitFn)(void *dst, const void *src, const uint8_t *alpha, int n, int src_step);
+PixelBlitFn pixel_blit_kernel(PixelFormat format);
+
+// the same through a palette: each source byte indexes palette (premultiplied colours
+// in the format) and alpha (one byte per entry). entry 0 must be transparent
+typedef void (*PixelIndexedBlitFn)(void *dst, const uint8_t *indices, const void *palette,
+                                   const uint8_t *alpha, int n, int src_step);
+PixelIndexedBlitFn pixel_indexed_blit_kernel(PixelFormat format);
+
+#endif
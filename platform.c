@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <string.h>
 #include "declarations.h"
+#include "input.h"
+#include "pixel_format.h"
 
 // SDL backend (laptop / macOS)
 
@@ -13,7 +15,12 @@
 static SDL_Window   *window   = NULL;
 static SDL_Renderer *renderer = NULL;
 static SDL_Texture  *texture  = NULL;
-static uint16_t     *framebuffer = NULL;
+
+// the game draws straight into the streaming texture: it is locked on the first
+// row handed out in a frame and unlocked (uploaded) by present_frame
+static uint8_t      *framebuffer = NULL; // locked texture pixels, NULL when unlocked
+static int           framebuffer_pitch = 0; // in bytes
+static PixelFormat   pixel_format = PIXEL_RGB565;
 
 int platform_init(void) {
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
@@ -24,8 +31,8 @@ int platform_init(void) {
     window = SDL_CreateWindow(
         "Sprite Test",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        screen_width, screen_height,
-        SDL_WINDOW_SHOWN
+        screen_width * 2, screen_height * 2,
+        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
     );
     if (!window) {
         fprintf(stderr, "SDL_CreateWindow failed: %s\n", SDL_GetError());
@@ -38,9 +45,23 @@ int platform_init(void) {
         return -1;
     }
 
+    // the game keeps drawing screen_width x screen_height, the renderer scales it up
+    // by whole factors (letterboxed) to whatever size the window is
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+    SDL_RenderSetLogicalSize(renderer, screen_width, screen_height);
+    SDL_RenderSetIntegerScale(renderer, SDL_TRUE);
+
+    // match a 32 bit desktop so the texture upload needs no conversion
+    uint32_t texture_format = SDL_PIXELFORMAT_RGB565;
+    pixel_format = PIXEL_RGB565;
+    if (SDL_BYTESPERPIXEL(SDL_GetWindowPixelFormat(window)) == 4) {
+        texture_format = SDL_PIXELFORMAT_RGB888; // xrgb8888
+        pixel_format = PIXEL_XRGB8888;
+    }
+
     texture = SDL_CreateTexture(
         renderer,
-        SDL_PIXELFORMAT_RGB565,
+        texture_format,
         SDL_TEXTUREACCESS_STREAMING,
         screen_width,
         screen_height
@@ -50,18 +71,13 @@ int platform_init(void) {
         return -1;
     }
 
-    framebuffer = (uint16_t *)malloc(screen_width * screen_height * sizeof(uint16_t));
-    if (!framebuffer) {
-        fprintf(stderr, "Failed to allocate framebuffer\n");
-        return -1;
-    }
-
+    input_reset();
     return 0;
 }
 
 void platform_shutdown(void) {
     if (framebuffer) {
-        free(framebuffer);
+        SDL_UnlockTexture(texture);
         framebuffer = NULL;
     }
     if (texture) {
@@ -79,40 +95,94 @@ void platform_shutdown(void) {
     SDL_Quit();
 }
 
-void clear_screen(void) {
-    memset(framebuffer, 0, screen_width * screen_height * sizeof(uint16_t));
+void *framebuffer_row(int y) {
+    if (y < 0 || y >= screen_height) return NULL;
+    if (!framebuffer) {
+        void *pixels;
+        if (SDL_LockTexture(texture, NULL, &pixels, &framebuffer_pitch) != 0) return NULL;
+        framebuffer = (uint8_t *)pixels;
+    }
+    return framebuffer + (size_t)y * framebuffer_pitch;
 }
 
-void put_pixel(int x, int y, uint16_t color) {
-    if (x < 0 || x >= screen_width || y < 0 || y >= screen_height) return;
-    framebuffer[y * screen_width + x] = color;
+int display_pixel_format(void) {
+    return pixel_format;
 }
 
 void present_frame(void) {
-    SDL_UpdateTexture(texture, NULL, framebuffer, screen_width * sizeof(uint16_t));
+    // nothing drawn since the last present: the texture still holds that frame
+    if (framebuffer) {
+        SDL_UnlockTexture(texture);
+        framebuffer = NULL;
+    }
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, NULL, NULL);
     SDL_RenderPresent(renderer);
 }
 
+// the renderer is created without vsync, the game loop sleeps instead
+int present_waits_for_vsync(void) {
+    return 0;
+}
+
+// SDL renderers belong to the thread that made them (the main thread, on macOS)
+int present_from_any_thread(void) {
+    return 0;
+}
+
+// no hardware scrolling, the game copies the background every frame
+int background_upload(const void *bg, int rows, size_t stride) {
+    (void)bg; (void)rows; (void)stride;
+    return -1;
+}
+
+int background_scroll(int bg_y) {
+    (void)bg_y;
+    return -1;
+}
+
+void framebuffer_dirty(int x, int y, int w, int h) {
+    (void)x; (void)y; (void)w; (void)h;
+}
+
+// keys are reported as level changes, so two taps in one frame stay two moves
+static int key_kind(SDL_Keycode sym) {
+    switch (sym) {
+        case SDLK_ESCAPE:    return INPUT_QUIT;
+        case SDLK_UP:        return INPUT_UP;
+        case SDLK_DOWN:      return INPUT_DOWN;
+        case SDLK_LEFT:      return INPUT_LEFT;
+        case SDLK_RIGHT:     return INPUT_RIGHT;
+        case SDLK_BACKSPACE: return INPUT_REWIND;
+        default:             return -1;
+    }
+}
+
 void poll_input(int *up, int *down, int *left, int *right, int *quit) {
-    *up = *down = *left = *right = 0;
+    // SDL wants its events pumped on the window's thread, so this is the producer
     SDL_Event e;
-
     while (SDL_PollEvent(&e)) {
         if (e.type == SDL_QUIT) {
-            *quit = 1;
-        } else if (e.type == SDL_KEYDOWN) {
-            switch (e.key.keysym.sym) {
-                case SDLK_ESCAPE: *quit = 1; break;
-                case SDLK_UP:     *up    = 1; break;
-                case SDLK_DOWN:   *down  = 1; break;
-                case SDLK_LEFT:   *left  = 1; break;
-                case SDLK_RIGHT:  *right = 1; break;
-                default: break;
-            }
+            input_report(INPUT_QUIT, 1, input_now_ns());
+        } else if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && !e.key.repeat) {
+            input_report(key_kind(e.key.keysym.sym), e.type == SDL_KEYDOWN, input_now_ns());
         }
     }
+
+    // catch up on releases the debouncer skipped
+    const uint8_t *keys = SDL_GetKeyboardState(NULL);
+    uint64_t now = input_now_ns();
+    input_report(INPUT_UP, keys[SDL_SCANCODE_UP], now);
+    input_report(INPUT_DOWN, keys[SDL_SCANCODE_DOWN], now);
+    input_report(INPUT_LEFT, keys[SDL_SCANCODE_LEFT], now);
+    input_report(INPUT_RIGHT, keys[SDL_SCANCODE_RIGHT], now);
+    input_report(INPUT_REWIND, keys[SDL_SCANCODE_BACKSPACE], now);
+
+    input_take(up, down, left, right, quit);
+}
+
+int rewind_held(void) {
+    return input_held(INPUT_REWIND);
 }
 
 #endif  // USE_SDL
@@ -128,15 +198,125 @@ void poll_input(int *up, int *down, int *left, int *right, int *quit) {
 #include <sys/mman.h>
 #include <signal.h>
 #include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include "gpio_input.h"
+#include "evdev_input.h"
+#include "drm_display.h"
+#include "upscale.h"
+#include "fb_copy.h"
 
 static int fb_fd = -1;
 static unsigned short *fbp = NULL;
 static struct fb_var_screeninfo vinfo;
 static struct fb_fix_screeninfo finfo;
 static unsigned long screensize = 0;
-static int up_curr = 0, down_curr = 0, left_curr = 0, right_curr = 0;
-static int up_prev = 0, down_prev = 0, left_prev = 0, right_prev = 0;
-static unsigned short *backbuffer = NULL;
+static int use_drm = 0; // 1 = kms buffers, 0 = /dev/fb0
+static PixelFormat pixel_format = PIXEL_RGB565;
+
+// the game draws at its logical size (screen_width x screen_height, the 480x272 cape
+// lcd) whatever the display is. a bigger display gets the frame scaled up by a whole
+// factor and centred, so a 1080p hdmi monitor costs the same to draw as the lcd
+static uint8_t *frame = NULL; // logical frame, NULL = drawing straight into kms buffers
+static size_t frame_stride = 0;
+static int upscale = 1;
+static int offset_x = 0, offset_y = 0; // of the picture on the display
+static UpscaleFilter upscale_filter = UPSCALE_NEAREST;
+
+// UPSCALE=scale2x smooths 2x scaling along edges instead of doubling pixels
+#define UPSCALE_ENV "UPSCALE"
+
+// HARDWARE SCROLLING
+// where the fbdev driver gives us a virtual screen as tall as the tallest level, the
+// level background is put in it once and scrolling is a pan (yoffset). a frame then
+// only puts back the background under last frame's sprites (save-under rects, copied
+// from the background in ram so the framebuffer is never read) and draws the new ones.
+// with room for two copies of the background, a frame is drawn into the copy that is
+// not on screen and the pan flips to it, so sprites are never erased or half drawn
+// while they scan out. with one copy the erasing waits for vblank instead
+#define MAX_DIRTY_RECTS 256
+#define PAN_COPIES 2
+typedef struct {
+    int x, y, w, h; // y in background rows
+} DirtyRect;
+
+// sprites drawn into one copy, to be erased before it is drawn again
+typedef struct {
+    DirtyRect rects[MAX_DIRTY_RECTS];
+    int num;
+    int overflow; // too many rects: restore every row that was visible instead
+    int y;        // pan_y the copy was drawn at
+} DirtyList;
+
+static struct fb_var_screeninfo vinfo_console; // put back on exit
+static int pan_capable = 0; // virtual screen tall enough for any level
+static int pan_vsync = 0;   // FBIO_WAITFORVSYNC works, so presents are vblank paced
+static int pan_copies = 0;  // level backgrounds the virtual screen holds
+static int pan_rows = 0;    // virtual screen rows per copy
+static int panning = 0;     // the current level's background is in the framebuffer
+static const uint8_t *pan_bg = NULL;
+static size_t pan_bg_stride = 0;
+static int pan_bg_rows = 0;
+static int pan_y = 0;     // background row at the top of the screen
+static int pan_copy = 0;  // copy being drawn
+static int shown_y = -1;  // yoffset last handed to the driver
+static DirtyList dirty[PAN_COPIES];
+
+// ASYNC PRESENT
+// without panning or kms flips, presenting is a copy of the whole frame into /dev/fb0.
+// FB_ASYNC_PRESENT=1 moves that copy to a thread: the game draws the next frame while
+// the last one is copied out. frames change hands through three slots (being drawn,
+// newest finished, being copied) so present_frame never waits for the copy, and a
+// frame presented right before a pause (a popup) is still the one that ends up shown
+#define ASYNC_PRESENT_ENV "FB_ASYNC_PRESENT"
+#define SLOT_FRESH 4 // the middle slot holds a frame the copy thread has not taken
+static int async_present = 0;
+static uint8_t *async_frames[3];
+static int async_back = 0;  // game side
+static int async_front = 2; // copy thread side
+static _Atomic int async_middle = 1;
+static _Atomic int async_stop = 0;
+static sem_t async_wake;
+static pthread_t async_thread;
+
+// DELTA PRESENT
+// fbtft (small spi panels) pushes every page of /dev/fb0 that was written over the bus,
+// so an unchanged row still costs its bytes. a hash per row of the last frame copied
+// out lets present skip the rows that did not change and copy the rest in runs. on by
+// default for fbtft drivers (their id starts "fb_"), FB_DELTA=1/0 forces it either way.
+// needs the frame unscaled, one logical row per display row
+#define DELTA_ENV "FB_DELTA"
+static int delta_present = 0;
+static uint32_t *row_hash = NULL;
+static int row_hash_valid = 0;     // 0 = copy every row next time
+static uint64_t delta_frames = 0;
+static uint64_t delta_written = 0; // bytes actually written to /dev/fb0
+
+// FB_PIXEL_FORMAT=rgb565-swapped (or any pixel_format_parse name) overrides the
+// guess, which is needed for panels wanting big endian 565 over spi
+#define PIXEL_FORMAT_ENV "FB_PIXEL_FORMAT"
+
+// buttons, indexed by InputKind (which is also their GpioEdge line)
+#define NUM_BUTTONS 4
+static const int button_gpio[NUM_BUTTONS] = {
+    [INPUT_UP] = GPIO_BTN0, [INPUT_DOWN] = GPIO_BTN1, [INPUT_LEFT] = GPIO_BTN2, [INPUT_RIGHT] = GPIO_BTN3
+};
+static int use_gpio_cdev = 0; // 1 = character device edge events, 0 = sysfs polling
+
+#define INPUT_WAKE_MS 10        // edge wait timeout, bounds how late a skipped release is noticed
+#define SYSFS_SAMPLE_MS 4       // sysfs fallback sampling period, when the pins cannot signal edges
+
+static pthread_t input_thread;
+static volatile int input_running = 0;
+static int input_epoll = -1;    // waits on both the gpio and the evdev sources
+static int sysfs_level[NUM_BUTTONS];
+static int sysfs_fd[NUM_BUTTONS] = { -1, -1, -1, -1 }; // value files, open for the whole game
+static int sysfs_edges = 0; // every value file signals edges (EPOLLPRI), so no sampling timer
+static int use_evdev = 0;
+
+enum { SOURCE_GPIO, SOURCE_EVDEV, SOURCE_SYSFS };
 
 //assign pin:
 int gpio_export(int gpio) {
@@ -180,15 +360,174 @@ int gpio_set_direction(int gpio, const char *direction) {
     return 0;
 }
 
-int gpio_get_value(int gpio) {
+int gpio_set_edge(int gpio, const char *edge) {
     char path[64];
-    char value;
-    snprintf(path, sizeof(path), GPIO_PATH "/gpio%d/value", gpio);
-    int fd = open(path, O_RDONLY);
+    snprintf(path, sizeof(path), GPIO_PATH "/gpio%d/edge", gpio);
+    int fd = open(path, O_WRONLY);
     if (fd < 0) return -1;
-    read(fd, &value, 1);
+    int ok = write(fd, edge, strlen(edge)) == (ssize_t)strlen(edge);
     close(fd);
-    return (value == '1') ? 1 : 0;
+    return ok ? 0 : -1;
+}
+
+// the chip and line behind each sysfs gpio number. without the sysfs chip entries,
+// guess the AM335x layout: gpio N is line N % 32 of bank N / 32, probed in bank order
+static int open_gpio_cdev(void) {
+    char paths[NUM_BUTTONS][64];
+    const char *chips[NUM_BUTTONS];
+    unsigned int offsets[NUM_BUTTONS];
+
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        if (gpio_input_find(button_gpio[i], paths[i], sizeof(paths[i]), &offsets[i]) != 0) {
+            fprintf(stderr, "Warning: no gpiochip claims gpio %d, guessing gpiochip%d\n",
+                    button_gpio[i], button_gpio[i] / 32);
+            snprintf(paths[i], sizeof(paths[i]), "/dev/gpiochip%d", button_gpio[i] / 32);
+            offsets[i] = (unsigned int)(button_gpio[i] % 32);
+        }
+        chips[i] = paths[i];
+    }
+    return gpio_input_open(chips, offsets, NUM_BUTTONS);
+}
+
+static void open_gpio_sysfs(void) {
+    if (gpio_export(GPIO_BTN0) < 0) {
+        fprintf(stderr, "Warning: Could not export UP\n");
+    }
+    if (gpio_export(GPIO_BTN1) < 0) {
+        fprintf(stderr, "Warning: Could not export DOWN\n");
+    }
+    if (gpio_export(GPIO_BTN2) < 0) {
+        fprintf(stderr, "Warning: Could not export LEFT\n");
+    }
+    if (gpio_export(GPIO_BTN3) < 0) {
+        fprintf(stderr, "Warning: Could not export RIGHT\n");
+    }
+
+    //outputs
+    gpio_set_direction(GPIO_BTN0, "in");
+    gpio_set_direction(GPIO_BTN1, "in");
+    gpio_set_direction(GPIO_BTN2, "in");
+    gpio_set_direction(GPIO_BTN3, "in");
+
+    // keep the value files open and pread them, rather than open/read/close each
+    // sample. with edge interrupts the input thread only wakes when one changes
+    sysfs_edges = 1;
+    for (int b = 0; b < NUM_BUTTONS; b++) {
+        char path[64];
+        snprintf(path, sizeof(path), GPIO_PATH "/gpio%d/value", button_gpio[b]);
+        sysfs_fd[b] = open(path, O_RDONLY | O_CLOEXEC);
+        if (sysfs_fd[b] < 0 || gpio_set_edge(button_gpio[b], "both") != 0) sysfs_edges = 0;
+    }
+}
+
+// current level of button b from its open value file, -1 if unreadable
+static int sysfs_value(int b) {
+    char value;
+    if (sysfs_fd[b] < 0 || pread(sysfs_fd[b], &value, 1, 0) != 1) return -1;
+    return value == '1';
+}
+
+static void close_gpio_sysfs(void) {
+    for (int b = 0; b < NUM_BUTTONS; b++) {
+        if (sysfs_fd[b] >= 0) close(sysfs_fd[b]);
+        sysfs_fd[b] = -1;
+    }
+    sysfs_edges = 0;
+    gpio_unexport(GPIO_BTN0);
+    gpio_unexport(GPIO_BTN1);
+    gpio_unexport(GPIO_BTN2);
+    gpio_unexport(GPIO_BTN3);
+}
+
+// INPUT THREAD
+// buttons, keyboards and gamepads are captured here, not in the game loop, and
+// handed over through input.c. a direction counts as held while any source holds it
+static int button_level(int kind) {
+    if (kind < 0 || kind >= NUM_BUTTONS) return 0;
+    return use_gpio_cdev ? gpio_input_level(kind) : sysfs_level[kind];
+}
+
+static int merged_level(int kind) {
+    return button_level(kind) || (use_evdev && evdev_input_level(kind));
+}
+
+static void *input_thread_main(void *arg) {
+    (void)arg;
+    while (input_running) {
+        struct epoll_event ready[2 + NUM_BUTTONS];
+        int wake_ms = (use_gpio_cdev || sysfs_edges) ? INPUT_WAKE_MS : SYSFS_SAMPLE_MS;
+        int n = epoll_wait(input_epoll, ready, 2 + NUM_BUTTONS, wake_ms);
+
+        for (int i = 0; i < n; i++) {
+            if (ready[i].data.u32 == SOURCE_GPIO) {
+                GpioEdge edges[32];
+                int got = gpio_input_read(edges, 32, 0);
+                for (int e = 0; e < got; e++) {
+                    int kind = edges[e].line;
+                    input_report(kind, edges[e].pressed || (use_evdev && evdev_input_level(kind)),
+                                 edges[e].timestamp_ns);
+                }
+            } else if (ready[i].data.u32 == SOURCE_EVDEV) {
+                InputEvent events[32];
+                int got = evdev_input_read(events, 32, 0);
+                for (int e = 0; e < got; e++) {
+                    int kind = events[e].kind;
+                    input_report(kind, events[e].pressed || button_level(kind), events[e].timestamp_ns);
+                }
+            }
+        }
+
+        uint64_t now = input_now_ns();
+        if (!use_gpio_cdev) {
+            // also rearms the edge wakeup of the files that signalled
+            for (int b = 0; b < NUM_BUTTONS; b++) {
+                int v = sysfs_value(b);
+                if (v >= 0) sysfs_level[b] = v;
+            }
+        }
+
+        // a release that came during the bounce lockout is picked up once it ends
+        for (int k = 0; k < INPUT_QUIT; k++) {
+            input_report(k, merged_level(k), now);
+        }
+    }
+    return NULL;
+}
+
+// put the available input sources in one epoll set and start the thread
+static void start_input_thread(void) {
+    input_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (input_epoll < 0) {
+        perror("epoll_create1 input");
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (use_gpio_cdev) {
+        ev.data.u32 = SOURCE_GPIO;
+        epoll_ctl(input_epoll, EPOLL_CTL_ADD, gpio_input_fd(), &ev);
+    }
+    if (use_evdev) {
+        ev.data.u32 = SOURCE_EVDEV;
+        epoll_ctl(input_epoll, EPOLL_CTL_ADD, evdev_input_fd(), &ev);
+    }
+    if (sysfs_edges) {
+        // sysfs reports a changed value as an exceptional condition
+        ev.events = EPOLLPRI;
+        ev.data.u32 = SOURCE_SYSFS;
+        for (int b = 0; b < NUM_BUTTONS; b++) {
+            if (epoll_ctl(input_epoll, EPOLL_CTL_ADD, sysfs_fd[b], &ev) < 0) sysfs_edges = 0;
+        }
+    }
+
+    input_reset();
+    input_running = 1;
+    if (pthread_create(&input_thread, NULL, input_thread_main, NULL) != 0) {
+        perror("pthread_create input");
+        input_running = 0;
+    }
 }
 
 // for CTRL+C 
@@ -198,7 +537,27 @@ static void signal_handler(int signo) {
     }
 }
 
-int platform_init(void) {
+// what vinfo says the framebuffer is made of, -1 if we cannot draw it
+static int fbdev_pixel_format(void) {
+    const char *forced = getenv(PIXEL_FORMAT_ENV);
+    if (forced) {
+        int format = pixel_format_parse(forced);
+        if (format < 0) fprintf(stderr, "Warning: unknown %s=%s\n", PIXEL_FORMAT_ENV, forced);
+        return format;
+    }
+
+    if (vinfo.bits_per_pixel == 16 && vinfo.red.offset == 11 && vinfo.blue.offset == 0) {
+        return PIXEL_RGB565;
+    }
+    if (vinfo.bits_per_pixel == 32 && vinfo.red.offset == 16 && vinfo.blue.offset == 0) {
+        return vinfo.transp.length ? PIXEL_ARGB8888 : PIXEL_XRGB8888;
+    }
+    fprintf(stderr, "Error: unsupported framebuffer layout (%u bpp, red at bit %u)\n",
+            vinfo.bits_per_pixel, vinfo.red.offset);
+    return -1;
+}
+
+static int open_fbdev(void) {
     // load framebuffer
     fb_fd = open("/dev/fb0", O_RDWR);
     if (fb_fd < 0) {
@@ -217,7 +576,15 @@ int platform_init(void) {
         close(fb_fd);
         return -1;
     }
-    
+
+    int format = fbdev_pixel_format();
+    if (format < 0 || (int)finfo.line_length < (int)vinfo.xres * pixel_bytes(format)) {
+        close(fb_fd);
+        return -1;
+    }
+    pixel_format = (PixelFormat)format;
+    printf("Framebuffer: %ux%u %s\n", vinfo.xres, vinfo.yres, pixel_format_name(pixel_format));
+
     screensize = finfo.line_length * vinfo.yres;
 
     fbp = (unsigned short *)mmap(0, screensize, PROT_READ | PROT_WRITE,
@@ -229,38 +596,300 @@ int platform_init(void) {
         return -1;
     }
 
-    //double buffer :(
-    backbuffer = (unsigned short *)malloc(screensize);
-    if (!backbuffer) {
-        perror("malloc backbuffer failed");
+    // black borders around a scaled picture
+    memset(fbp, 0, screensize);
+    return 0;
+}
+
+// display row y of the picture (offset to its left edge), NULL if off the display
+static void *display_row(int y) {
+    y += offset_y;
+    uint8_t *row;
+    if (use_drm) {
+        row = (uint8_t *)drm_display_row(y);
+    } else {
+        row = (y >= 0 && y < (int)vinfo.yres) ? (uint8_t *)fbp + (size_t)y * finfo.line_length : NULL;
+    }
+    return row ? row + (size_t)offset_x * pixel_bytes(pixel_format) : NULL;
+}
+
+static uint32_t hash_row(const uint8_t *p, size_t n) {
+    uint32_t h = 2166136261u;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t w;
+        memcpy(&w, p + i, 4);
+        h = (h ^ w) * 16777619u;
+    }
+    for (; i < n; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+// rows [y0, y1) of src, one fb_copy if they are contiguous in the framebuffer too
+static void copy_rows_out(const uint8_t *src, int y0, int y1) {
+    size_t row_bytes = (size_t)screen_width * pixel_bytes(pixel_format);
+    if (row_bytes == finfo.line_length && frame_stride == row_bytes) {
+        fb_copy(display_row(y0), src + (size_t)y0 * frame_stride, (size_t)(y1 - y0) * row_bytes);
+    } else {
+        for (int y = y0; y < y1; y++) fb_copy(display_row(y), src + (size_t)y * frame_stride, row_bytes);
+    }
+    delta_written += (uint64_t)(y1 - y0) * row_bytes;
+}
+
+// put a finished logical frame on the display
+static void copy_frame_out(const uint8_t *src) {
+    if (!delta_present) {
+        upscale_frame(src, frame_stride, screen_width, screen_height, pixel_bytes(pixel_format),
+                      upscale, upscale_filter, display_row);
+        return;
+    }
+
+    size_t row_bytes = (size_t)screen_width * pixel_bytes(pixel_format);
+    int run = -1; // first row of the current run of changed rows
+    for (int y = 0; y < screen_height; y++) {
+        uint32_t h = hash_row(src + (size_t)y * frame_stride, row_bytes);
+        int changed = !row_hash_valid || h != row_hash[y];
+        row_hash[y] = h;
+
+        if (changed && run < 0) run = y;
+        if (!changed && run >= 0) {
+            copy_rows_out(src, run, y);
+            run = -1;
+        }
+    }
+    if (run >= 0) copy_rows_out(src, run, screen_height);
+    row_hash_valid = 1;
+    delta_frames++;
+}
+
+static void start_delta_present(void) {
+    const char *env = getenv(DELTA_ENV);
+    int wanted = env ? strcmp(env, "1") == 0 : strncmp(finfo.id, "fb_", 3) == 0;
+    if (!wanted || use_drm || upscale != 1) return;
+
+    row_hash = (uint32_t *)malloc(sizeof(uint32_t) * screen_height);
+    if (!row_hash) return;
+    row_hash_valid = 0;
+    delta_frames = delta_written = 0;
+    delta_present = 1;
+    printf("Framebuffer: writing only changed rows (%.16s)\n", finfo.id);
+}
+
+static void stop_delta_present(void) {
+    if (!delta_present) return;
+    if (delta_frames) {
+        double full = (double)screen_width * pixel_bytes(pixel_format) * screen_height;
+        double avg = (double)delta_written / delta_frames;
+        printf("Framebuffer: %llu frames, wrote %.0f of %.0f bytes per frame (%.0f%% saved)\n",
+               (unsigned long long)delta_frames, avg, full, 100.0 * (1.0 - avg / full));
+    }
+    free(row_hash);
+    row_hash = NULL;
+    delta_present = 0;
+}
+
+static void *async_present_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        sem_wait(&async_wake);
+        if (atomic_load(&async_stop)) break;
+        while (sem_trywait(&async_wake) == 0) {}
+
+        if (!(atomic_load(&async_middle) & SLOT_FRESH)) continue;
+        async_front = atomic_exchange(&async_middle, async_front) & 3;
+        copy_frame_out(async_frames[async_front]);
+    }
+    return NULL;
+}
+
+// the logical frame becomes one of three, the other two are allocated here
+static void start_async_present(void) {
+    async_frames[0] = frame;
+    async_frames[1] = (uint8_t *)calloc(screen_height, frame_stride);
+    async_frames[2] = (uint8_t *)calloc(screen_height, frame_stride);
+    if (!async_frames[1] || !async_frames[2] || sem_init(&async_wake, 0, 0) != 0) {
+        fprintf(stderr, "Warning: no memory for async present, copying on the game thread\n");
+        free(async_frames[1]);
+        free(async_frames[2]);
+        return;
+    }
+
+    async_back = 0;
+    async_front = 2;
+    atomic_store(&async_middle, 1);
+    atomic_store(&async_stop, 0);
+    if (pthread_create(&async_thread, NULL, async_present_main, NULL) != 0) {
+        perror("pthread_create present");
+        sem_destroy(&async_wake);
+        free(async_frames[1]);
+        free(async_frames[2]);
+        return;
+    }
+    async_present = 1;
+    printf("Framebuffer: copying frames out on a present thread\n");
+}
+
+static void stop_async_present(void) {
+    if (!async_present) return;
+    atomic_store(&async_stop, 1);
+    sem_post(&async_wake);
+    pthread_join(async_thread, NULL);
+    sem_destroy(&async_wake);
+
+    // frame is one of the three, close_display frees that one
+    for (int i = 0; i < 3; i++) {
+        if (async_frames[i] != frame) free(async_frames[i]);
+        async_frames[i] = NULL;
+    }
+    async_present = 0;
+}
+
+static void close_display(void) {
+    stop_async_present();
+    stop_delta_present();
+    if (pan_capable) {
+        ioctl(fb_fd, FBIOPUT_VSCREENINFO, &vinfo_console);
+        pan_capable = panning = pan_copies = 0;
+    }
+    if (use_drm) {
+        drm_display_close();
+        use_drm = 0;
+    }
+    if (frame) {
+        free(frame);
+        frame = NULL;
+    }
+    if (fbp && fbp != MAP_FAILED) {
         munmap(fbp, screensize);
         fbp = NULL;
+    }
+    if (fb_fd >= 0) {
         close(fb_fd);
+        fb_fd = -1;
+    }
+}
+
+// grow the virtual screen to rows and map all of it. leaves the framebuffer as it
+// was and returns -1 if the driver will not do it
+static int map_virtual_screen(int rows) {
+    struct fb_var_screeninfo v = vinfo;
+    v.yres_virtual = (uint32_t)rows;
+    v.yoffset = 0;
+    if (ioctl(fb_fd, FBIOPUT_VSCREENINFO, &v) < 0 || ioctl(fb_fd, FBIOGET_VSCREENINFO, &v) < 0 ||
+        v.yres_virtual < (uint32_t)rows || v.xres != vinfo.xres || v.bits_per_pixel != vinfo.bits_per_pixel ||
+        ioctl(fb_fd, FBIOGET_FSCREENINFO, &finfo) < 0 ||
+        finfo.smem_len < finfo.line_length * (uint32_t)rows) {
+        ioctl(fb_fd, FBIOPUT_VSCREENINFO, &vinfo_console);
+        ioctl(fb_fd, FBIOGET_FSCREENINFO, &finfo);
         return -1;
     }
 
-    screen_width  = vinfo.xres;
-    screen_height = vinfo.yres;
+    unsigned long size = finfo.line_length * (unsigned long)rows;
+    unsigned short *map = (unsigned short *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fb_fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap virtual framebuffer");
+        ioctl(fb_fd, FBIOPUT_VSCREENINFO, &vinfo_console);
+        ioctl(fb_fd, FBIOGET_FSCREENINFO, &finfo);
+        return -1;
+    }
+    munmap(fbp, screensize);
+    fbp = map;
+    screensize = size;
+    vinfo = v;
+    return 0;
+}
 
-    //now setup gpios
-    if (gpio_export(GPIO_BTN0) < 0) {
-        fprintf(stderr, "Warning: Could not export UP\n");
+// room for two copies of the tallest level if the driver has it, else for one
+static void setup_panning(void) {
+    int rows = (MAX_TOTAL_LANES + 2) * LANE_HEIGHT;
+    vinfo_console = vinfo;
+    for (int copies = PAN_COPIES; copies >= 1 && !pan_capable; copies--) {
+        if (map_virtual_screen(rows * copies) == 0) {
+            pan_copies = copies;
+            pan_rows = rows;
+            pan_capable = 1;
+        }
     }
-    if (gpio_export(GPIO_BTN1) < 0) {
-        fprintf(stderr, "Warning: Could not export DOWN\n");
+    if (!pan_capable) {
+        fprintf(stderr, "Warning: no %d row virtual framebuffer, scrolling by copying\n", rows);
+        return;
     }
-    if (gpio_export(GPIO_BTN2) < 0) {
-        fprintf(stderr, "Warning: Could not export LEFT\n");
+
+    int crtc = 0;
+    pan_vsync = ioctl(fb_fd, FBIO_WAITFORVSYNC, &crtc) == 0;
+    printf("Framebuffer: panning over %d rows%s%s\n", rows, pan_copies > 1 ? ", double buffered" : "",
+           pan_vsync ? ", vsync" : "");
+}
+
+// fit the logical frame on a display_w x display_h display. fbdev always draws into
+// a frame of its own (its mapping is shown while we draw); kms only needs one to scale
+static int setup_logical_frame(int display_w, int display_h, int need_frame) {
+    if (screen_width > display_w) screen_width = display_w;
+    if (screen_height > display_h) screen_height = display_h;
+
+    upscale = upscale_factor(screen_width, screen_height, display_w, display_h);
+    offset_x = (display_w - screen_width * upscale) / 2;
+    offset_y = (display_h - screen_height * upscale) / 2;
+
+    const char *filter = getenv(UPSCALE_ENV);
+    if (filter && strcmp(filter, "scale2x") == 0) upscale_filter = UPSCALE_SCALE2X;
+
+    if (need_frame || upscale > 1) {
+        frame_stride = (size_t)screen_width * pixel_bytes(pixel_format);
+        frame = (uint8_t *)calloc(screen_height, frame_stride);
+        if (!frame) {
+            perror("malloc frame");
+            return -1;
+        }
     }
-    if (gpio_export(GPIO_BTN3) < 0) {
-        fprintf(stderr, "Warning: Could not export RIGHT\n");
+    printf("Display %dx%d: drawing %dx%d, scaled x%d%s\n", display_w, display_h, screen_width,
+           screen_height, upscale, (upscale == 2 && upscale_filter == UPSCALE_SCALE2X) ? " (scale2x)" : "");
+    return 0;
+}
+
+int platform_init(void) {
+    // display: kms page flips if there is a drm device we can drive, else /dev/fb0
+    int display_w, display_h;
+    if (drm_display_open(&display_w, &display_h, &pixel_format) == 0) {
+        use_drm = 1;
+    } else if (open_fbdev() == 0) {
+        display_w = (int)vinfo.xres;
+        display_h = (int)vinfo.yres;
+    } else {
+        return -1;
+    }
+    if (setup_logical_frame(display_w, display_h, !use_drm) != 0) {
+        close_display();
+        return -1;
+    }
+    if (!use_drm && upscale == 1 && offset_y == 0) {
+        setup_panning();
+    }
+    if (!use_drm) {
+        start_delta_present();
+    }
+    const char *async = getenv(ASYNC_PRESENT_ENV);
+    if (!use_drm && !pan_capable && async && strcmp(async, "1") == 0) {
+        start_async_present();
     }
 
-    //outputs
-    gpio_set_direction(GPIO_BTN0, "in");
-    gpio_set_direction(GPIO_BTN1, "in");
-    gpio_set_direction(GPIO_BTN2, "in");
-    gpio_set_direction(GPIO_BTN3, "in");
+    // buttons: edge events from the gpio character device if the kernel has it,
+    // otherwise fall back to polling sysfs
+    if (open_gpio_cdev() == 0) {
+        use_gpio_cdev = 1;
+    } else {
+        fprintf(stderr, "Warning: GPIO character device unavailable, using sysfs\n");
+        open_gpio_sysfs();
+    }
+
+    // usb keyboards and gamepads, including ones plugged in later
+    if (evdev_input_open(EVDEV_INPUT_DIR, 1) == 0) {
+        use_evdev = 1;
+    } else {
+        fprintf(stderr, "Warning: no keyboard/gamepad input (%s not readable)\n", EVDEV_INPUT_DIR);
+    }
+
+    start_input_thread();
 
     // signals
     signal(SIGINT,  signal_handler);
@@ -272,82 +901,199 @@ int platform_init(void) {
 void platform_shutdown(void) {
 
     //bye bye buffer
-    if (backbuffer) {
-        free(backbuffer);
-        backbuffer = NULL;
+    close_display();
+
+    //bye bye gpios
+    if (input_running) {
+        input_running = 0;
+        pthread_join(input_thread, NULL);
     }
-    if (fbp && fbp != MAP_FAILED) {
-        munmap(fbp, screensize);
-        fbp = NULL;
+    if (input_epoll >= 0) {
+        close(input_epoll);
+        input_epoll = -1;
     }
-    if (fb_fd >= 0) {
-        close(fb_fd);
-        fb_fd = -1;
+    if (use_evdev) {
+        evdev_input_close();
+        use_evdev = 0;
+    }
+    if (use_gpio_cdev) {
+        gpio_input_close();
+        use_gpio_cdev = 0;
+        return;
     }
+    close_gpio_sysfs();
+}
 
-    //bye bye gpios
-    gpio_unexport(GPIO_BTN0);
-    gpio_unexport(GPIO_BTN1);
-    gpio_unexport(GPIO_BTN2);
-    gpio_unexport(GPIO_BTN3);
+void *framebuffer_row(int y) {
+    if (y < 0 || y >= screen_height) return NULL;
+    if (panning) return (uint8_t *)fbp + (size_t)(pan_copy * pan_rows + pan_y + y) * finfo.line_length + (size_t)offset_x * pixel_bytes(pixel_format);
+    if (frame) return frame + (size_t)y * frame_stride;
+    return display_row(y);
 }
 
-void clear_screen(void) {
-    if (backbuffer && screensize > 0) {
-        memset(backbuffer, 0, screensize); 
+// copy background rows [y, y + h), columns [x, x + w) into one copy in the framebuffer
+static void restore_background(int copy, int x, int y, int w, int h) {
+    int bytes = pixel_bytes(pixel_format);
+    for (int row = y; row < y + h; row++) {
+        uint8_t *dst = (uint8_t *)fbp + (size_t)(copy * pan_rows + row) * finfo.line_length + (size_t)(offset_x + x) * bytes;
+        fb_copy(dst, pan_bg + (size_t)row * pan_bg_stride + (size_t)x * bytes, (size_t)w * bytes);
     }
 }
 
-void put_pixel(int x, int y, uint16_t color) {
-    if (!backbuffer) return;
-    if (x < 0 || x >= vinfo.xres || y < 0 || y>= vinfo.yres) return;
+int background_upload(const void *bg, int rows, size_t stride) {
+    if (panning) {
+        // frames go through copy_frame_out again, over rows the hashes do not
+        // describe. no async present thread runs alongside panning, so this is safe.
+        // they land at the top of the virtual screen, so show that
+        panning = 0;
+        row_hash_valid = 0;
+        if (shown_y != 0) {
+            struct fb_var_screeninfo v = vinfo;
+            v.xoffset = 0;
+            v.yoffset = 0;
+            if (ioctl(fb_fd, FBIOPAN_DISPLAY, &v) == 0) shown_y = 0;
+        }
+    }
+    if (!pan_capable || rows < screen_height || rows > pan_rows) return -1;
 
-    unsigned long fb_offset = y * finfo.line_length + x * 2;
-    unsigned short *pixel = (unsigned short *)((char *)backbuffer + fb_offset);
-    *pixel = color;
+    pan_bg = (const uint8_t *)bg;
+    pan_bg_stride = stride;
+    pan_bg_rows = rows;
+    for (int c = 0; c < pan_copies; c++) {
+        restore_background(c, 0, 0, screen_width, rows);
+        dirty[c].num = dirty[c].overflow = 0;
+    }
+    pan_y = 0;
+    pan_copy = pan_copies - 1; // the first frame goes to the copy not on screen
+    shown_y = -1;
+    panning = 1;
+    return 0;
 }
 
-void present_frame(void) {
-    if (fbp && backbuffer && screensize > 0) {
-        memcpy(fbp, backbuffer, screensize);
+int background_scroll(int bg_y) {
+    if (!panning) return -1;
+
+    // a lone copy is on screen while we draw: start right after a vblank so the
+    // erase and redraw are done before the beam gets to them
+    if (pan_copies == 1 && pan_vsync) {
+        int crtc = 0;
+        ioctl(fb_fd, FBIO_WAITFORVSYNC, &crtc);
     }
-}
 
-void poll_input(int *up, int *down, int *left, int *right, int *quit) {
+    // erase the sprites last drawn into this copy
+    DirtyList *d = &dirty[pan_copy];
+    if (d->overflow) {
+        restore_background(pan_copy, 0, d->y, screen_width, screen_height);
+    } else {
+        for (int i = d->num - 1; i >= 0; i--) {
+            const DirtyRect *r = &d->rects[i];
+            restore_background(pan_copy, r->x, r->y, r->w, r->h);
+        }
+    }
+    d->num = 0;
+    d->overflow = 0;
 
-    *up = *down = *left = *right = *quit = 0;
-    
-    //current values
-    up_curr = gpio_get_value(GPIO_BTN0);
-    down_curr = gpio_get_value(GPIO_BTN1);
-    left_curr = gpio_get_value(GPIO_BTN2);
-    right_curr = gpio_get_value(GPIO_BTN3);
+    if (bg_y < 0) bg_y = 0;
+    if (bg_y > pan_bg_rows - screen_height) bg_y = pan_bg_rows - screen_height;
+    pan_y = bg_y;
+    d->y = pan_y;
+    return 0;
+}
 
-    // if a value less than 0, error occured, return
-    if (up_curr < 0 || down_curr < 0 || left_curr < 0 || right_curr < 0) {
+void framebuffer_dirty(int x, int y, int w, int h) {
+    if (!panning) return;
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > screen_width) w = screen_width - x;
+    if (y + h > screen_height) h = screen_height - y;
+    if (w <= 0 || h <= 0) return;
+
+    DirtyList *d = &dirty[pan_copy];
+    if (d->num == MAX_DIRTY_RECTS) {
+        d->overflow = 1;
         return;
     }
-    
-    //LATCHING: if previous state not 1, but current state 1, button pressed
-    if (up_curr && !up_prev) {
-        *up = 1;
+    d->rects[d->num++] = (DirtyRect){ x, pan_y + y, w, h };
+}
+
+int display_pixel_format(void) {
+    return pixel_format;
+}
+
+void present_frame(void) {
+    if (panning) {
+        // sprites are already in place, just move the window to them
+        int y = pan_copy * pan_rows + pan_y;
+        if (y != shown_y) {
+            struct fb_var_screeninfo v = vinfo;
+            v.xoffset = 0;
+            v.yoffset = (uint32_t)y;
+            if (ioctl(fb_fd, FBIOPAN_DISPLAY, &v) == 0) shown_y = y;
         }
-    if (down_curr && !down_prev) {
-        *down = 1;
+        if (pan_copies > 1) {
+            // the pan lands at vblank, after which the other copy is free to draw
+            if (pan_vsync) {
+                int crtc = 0;
+                ioctl(fb_fd, FBIO_WAITFORVSYNC, &crtc);
+            }
+            pan_copy ^= 1;
+        }
+        return;
     }
-    if (left_curr && !left_prev) {
-        *left = 1;
+    if (async_present) {
+        // hand the finished frame over and carry on in whichever slot comes back
+        async_back = atomic_exchange(&async_middle, async_back | SLOT_FRESH) & 3;
+        frame = async_frames[async_back];
+        sem_post(&async_wake);
+        return;
     }
-    if (right_curr && !right_prev) {
-        *right = 1;
+    if (frame) {
+        copy_frame_out(frame);
     }
+    if (use_drm) {
+        drm_display_flip();
+    }
+}
+
+// a kms flip blocks until the previous one reached the screen
+int present_waits_for_vsync(void) {
+    return use_drm || (panning && pan_vsync);
+}
 
-    //update states
-    up_prev = up_curr;
-    down_prev = down_curr;
-    left_prev = left_curr;
-    right_prev = right_curr;
+// plain memory and ioctls, any one thread at a time may draw and present
+int present_from_any_thread(void) {
+    return 1;
+}
+
+void poll_input(int *up, int *down, int *left, int *right, int *quit) {
+    *quit = 0;
+    input_take(up, down, left, right, quit);
+}
 
+// backspace on a keyboard, or on the bare board (no spare button) left and right together
+int rewind_held(void) {
+    return input_held(INPUT_REWIND) || (input_held(INPUT_LEFT) && input_held(INPUT_RIGHT));
 }
 
 #endif
+
+// Both backends-----------------------------------------------------------------
+
+void clear_screen(void) {
+    size_t row_bytes = (size_t)screen_width * pixel_bytes(display_pixel_format());
+    for (int y = 0; y < screen_height; y++) {
+        void *row = framebuffer_row(y);
+        if (row) memset(row, 0, row_bytes);
+    }
+}
+
+void put_pixel(int x, int y, uint32_t color) {
+    if (x < 0 || x >= screen_width) return;
+    void *row = framebuffer_row(y);
+    if (!row) return;
+    if (pixel_bytes(display_pixel_format()) == 2) {
+        ((uint16_t *)row)[x] = (uint16_t)color;
+    } else {
+        ((uint32_t *)row)[x] = color;
+    }
+}
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "raster.h"
+#include "fb_copy.h"
+
+// BANDS
+// the screen is cut into horizontal bands, one per thread. a binning pass on the
+// calling thread lists, per band, the sprites that reach into it (keeping their
+// order); then every thread copies its band's background rows and draws its sprites
+// clipped to the band. bands share no pixels and each pixel sees the same writes in
+// the same order as on one thread, so the picture is identical.
+
+static int num_bands = 1;
+static int band_top[RASTER_MAX_BANDS + 1];
+static uint8_t bin[RASTER_MAX_BANDS][RASTER_MAX_SPRITES];
+static int bin_count[RASTER_MAX_BANDS];
+
+static pthread_t workers[RASTER_MAX_BANDS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t go = PTHREAD_COND_INITIALIZER;   // a new frame (or stop) for the workers
+static pthread_cond_t done = PTHREAD_COND_INITIALIZER; // the last worker finished its band
+static unsigned generation = 0;
+static int pending = 0;
+static int stopping = 0;
+static const RasterFrame *current = NULL;
+
+_Static_assert(RASTER_MAX_SPRITES <= 256, "bins hold sprite indices in a byte");
+
+// SPANS
+// painting (draw_band) writes every pixel under a sprite twice or more: once with
+// the background, once per sprite. with spans on, each screen row is composed instead:
+// the row's sprites are clipped to spans of columns, overlapping spans merge, and the
+// columns no span covers get the background straight from the level. only the merged
+// spans are painted, in a cached line of their own, and copied out once, so every
+// back buffer pixel is written exactly once. that is what counts when the back
+// buffer is uncached display memory, such as a kms dumb buffer.
+// when the display scrolls a copy of the background itself (copy_bg = 0), the rows
+// between spans are already right and only the spans are written. that is always
+// done, spans on or not: painting would blend the sprites' soft edges over pixels
+// read back from the framebuffer, which is uncached.
+
+static int use_spans = 0;
+
+typedef struct {
+    int x0, x1;
+} Span;
+
+static uint8_t *line[RASTER_MAX_BANDS];
+static size_t line_size[RASTER_MAX_BANDS];
+
+// background for screen row y, NULL where the level has none (drawn black)
+static const uint8_t *bg_row(const RasterFrame *f, int y) {
+    int bg_y = f->bg_y + y;
+    if (f->bg && bg_y >= 0 && bg_y < f->bg_rows) return f->bg + (size_t)bg_y * f->bg_stride;
+    return NULL;
+}
+
+// screen columns [*x0, *x1) sprite s covers on screen row y, 0 if none
+static int sprite_span(const RasterSprite *s, int y, int *x0, int *x1) {
+    const Sprite *sprite = atlas_sprite(s->id);
+    const SpriteRect *b = &sprite->bounds;
+    if (y < s->y + b->y || y >= s->y + b->y + b->h) return 0;
+    int lo = s->x + (s->flip ? sprite->width - b->x - b->w : b->x);
+    *x0 = lo < 0 ? 0 : lo;
+    *x1 = lo + b->w > screen_width ? screen_width : lo + b->w;
+    return *x0 < *x1;
+}
+
+// columns [x0, x1) of a row from src (background or the composed line)
+static void put_columns(uint8_t *row, const uint8_t *src, int x0, int x1, int bytes) {
+    if (x0 >= x1) return;
+    size_t offset = (size_t)x0 * bytes, n = (size_t)(x1 - x0) * bytes;
+    if (src) fb_copy(row + offset, src + offset, n);
+    else memset(row + offset, 0, n);
+}
+
+// -1 if there is no memory for the line (the band is then painted instead)
+static int compose_band(const RasterFrame *f, int band) {
+    int top = band_top[band], bottom = band_top[band + 1];
+    int bytes = pixel_bytes((PixelFormat)display_pixel_format());
+    size_t row_bytes = (size_t)screen_width * bytes;
+    if (line_size[band] < row_bytes) {
+        uint8_t *p = (uint8_t *)realloc(line[band], row_bytes);
+        if (!p) return -1;
+        line[band] = p;
+        line_size[band] = row_bytes;
+    }
+    uint8_t *composed = line[band];
+
+    for (int y = top; y < bottom; y++) {
+        uint8_t *row = (uint8_t *)framebuffer_row(y);
+        if (!row) continue;
+        const uint8_t *bg = bg_row(f, y);
+
+        // spans of this row's sprites, merged where they touch, left to right
+        Span spans[RASTER_MAX_SPRITES];
+        uint8_t on_row[RASTER_MAX_SPRITES];
+        int num_spans = 0;
+        for (int i = 0; i < bin_count[band]; i++) {
+            Span s;
+            if (!sprite_span(&f->sprites[bin[band][i]], y, &s.x0, &s.x1)) continue;
+            on_row[num_spans] = bin[band][i];
+            int k = num_spans++;
+            while (k > 0 && spans[k - 1].x0 > s.x0) {
+                spans[k] = spans[k - 1];
+                k--;
+            }
+            spans[k] = s;
+        }
+        int merged = 0;
+        for (int k = 0; k < num_spans; k++) {
+            if (merged > 0 && spans[k].x0 <= spans[merged - 1].x1) {
+                if (spans[k].x1 > spans[merged - 1].x1) spans[merged - 1].x1 = spans[k].x1;
+            } else {
+                spans[merged++] = spans[k];
+            }
+        }
+
+        // paint the spans in the line: background, then the sprites in draw order
+        for (int k = 0; k < merged; k++) {
+            put_columns(composed, bg, spans[k].x0, spans[k].x1, bytes);
+        }
+        for (int i = 0; i < num_spans; i++) {
+            const RasterSprite *s = &f->sprites[on_row[i]];
+            sprite_draw_to(atlas_sprite(s->id), composed, row_bytes, 1, s->x, s->y - y, s->flip);
+        }
+
+        // and write the row once: background between spans, the line over them
+        int x = 0;
+        for (int k = 0; k < merged; k++) {
+            if (f->copy_bg) put_columns(row, bg, x, spans[k].x0, bytes);
+            put_columns(row, composed, spans[k].x0, spans[k].x1, bytes);
+            x = spans[k].x1;
+        }
+        if (f->copy_bg) put_columns(row, bg, x, screen_width, bytes);
+    }
+    return 0;
+}
+
+static void draw_band(const RasterFrame *f, int band) {
+    int top = band_top[band], bottom = band_top[band + 1];
+
+    int compose = f->copy_bg ? use_spans : f->bg != NULL;
+    if (compose && compose_band(f, band) == 0) return;
+
+    if (f->copy_bg) {
+        for (int y = top; y < bottom; y++) {
+            void *row = framebuffer_row(y);
+            if (!row) continue;
+
+            const uint8_t *bg = bg_row(f, y);
+            if (bg) {
+                fb_copy(row, bg, f->bg_stride); // may be a kms buffer
+            } else {
+                memset(row, 0, f->bg_stride);
+            }
+        }
+    }
+
+    for (int i = 0; i < bin_count[band]; i++) {
+        const RasterSprite *s = &f->sprites[bin[band][i]];
+        sprite_draw_rows(atlas_sprite(s->id), s->x, s->y, s->flip, top, bottom);
+    }
+}
+
+static void *band_worker(void *arg) {
+    int band = (int)(intptr_t)arg;
+    unsigned seen = 0;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (generation == seen && !stopping) pthread_cond_wait(&go, &lock);
+        if (stopping) break;
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        draw_band(current, band);
+
+        pthread_mutex_lock(&lock);
+        if (--pending == 0) pthread_cond_signal(&done);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void set_bands(int n) {
+    num_bands = n;
+    for (int b = 0; b <= n; b++) {
+        band_top[b] = screen_height * b / n;
+    }
+}
+
+void raster_use_spans(int on) {
+    use_spans = on;
+}
+
+int raster_start(void) {
+    const char *spans = getenv(RASTER_SPANS_ENV);
+    if (spans) raster_use_spans(atoi(spans) != 0);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv(RASTER_THREADS_ENV);
+    int n = env ? atoi(env) : (cores >= 4 ? 4 : 1);
+    if (n < 1) n = 1;
+    if (n > RASTER_MAX_BANDS) n = RASTER_MAX_BANDS;
+    if (n > screen_height) n = screen_height;
+
+    // the calling thread draws band 0, the workers the rest
+    stopping = 0;
+    generation = 0;
+    for (int b = 1; b < n; b++) {
+        if (pthread_create(&workers[b], NULL, band_worker, (void *)(intptr_t)b) != 0) {
+            fprintf(stderr, "Warning: could not start raster thread %d\n", b);
+            n = b;
+            break;
+        }
+    }
+    set_bands(n);
+    if (n > 1) printf("Raster: %d bands on %ld cores\n", n, cores);
+    return n;
+}
+
+void raster_stop(void) {
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&go);
+    pthread_mutex_unlock(&lock);
+    for (int b = 1; b < num_bands; b++) {
+        pthread_join(workers[b], NULL);
+    }
+    set_bands(1);
+    for (int b = 0; b < RASTER_MAX_BANDS; b++) {
+        free(line[b]);
+        line[b] = NULL;
+        line_size[b] = 0;
+    }
+}
+
+void raster_draw(const RasterFrame *f) {
+    if (band_top[num_bands] != screen_height) set_bands(num_bands);
+
+    // bin in draw order; marking dirty rects stays on this thread
+    memset(bin_count, 0, sizeof(bin_count));
+    for (int i = 0; i < f->num_sprites; i++) {
+        const RasterSprite *s = &f->sprites[i];
+        const Sprite *sprite = atlas_sprite(s->id);
+        if (!sprite_dirty(sprite, s->x, s->y, s->flip)) continue;
+
+        int top = s->y + sprite->bounds.y, bottom = top + sprite->bounds.h;
+        for (int b = 0; b < num_bands; b++) {
+            if (bottom > band_top[b] && top < band_top[b + 1]) {
+                bin[b][bin_count[b]++] = (uint8_t)i;
+            }
+        }
+    }
+
+    if (num_bands == 1) {
+        draw_band(f, 0);
+        return;
+    }
+
+    // the first row request may map the back buffer (SDL locks its texture), do it here
+    framebuffer_row(0);
+
+    pthread_mutex_lock(&lock);
+    current = f;
+    pending = num_bands - 1;
+    generation++;
+    pthread_cond_broadcast(&go);
+    pthread_mutex_unlock(&lock);
+
+    draw_band(f, 0);
+
+    pthread_mutex_lock(&lock);
+    while (pending > 0) pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,48 @@
+// raster.h -- drawing a frame (background rows + sprites) split into horizontal bands across threads
+
+#include <stddef.h>
+#include <stdint.h>
+#include "declarations.h"
+#include "atlas.h"
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#define RASTER_THREADS_ENV "RASTER_THREADS" // bands drawn in parallel, 1 = draw on the calling thread
+#define RASTER_SPANS_ENV "RASTER_SPANS"     // 1 = compose each row from spans, writing every pixel once
+#define RASTER_MAX_BANDS 8
+#define RASTER_MAX_SPRITES (MAX_CARS + MAX_TOTAL_LANES + MAX_SPECIAL_VEHICLES + 2)
+
+// one sprite to draw, in order (later ones on top)
+typedef struct {
+    SpriteId id;
+    uint8_t flip;
+    int16_t x, y; // screen position of the top left corner
+} RasterSprite;
+
+// everything one frame draws
+typedef struct {
+    const uint8_t *bg;  // prerendered background, one screen-wide row per bg row
+    int bg_rows;
+    size_t bg_stride;
+    int bg_y;           // bg row shown at screen row 0
+    int copy_bg;        // 0 when the display already shows the background
+    RasterSprite sprites[RASTER_MAX_SPRITES];
+    int num_sprites;
+} RasterFrame;
+
+// start the band workers (threads from RASTER_THREADS, by default 4 on 4+ cores and
+// none otherwise). returns the number of bands frames will be split into
+int raster_start(void);
+void raster_stop(void);
+
+// compose rows from sprite spans (each back buffer pixel written once) instead of
+// painting the background and then every sprite over it. raster_start takes it from
+// RASTER_SPANS when set. either way the picture is the same
+void raster_use_spans(int on);
+
+// draw the frame into the back buffer. the result is the same, bit for bit, whether
+// it is split into bands or not. must be called from one thread at a time
+void raster_draw(const RasterFrame *f);
+
+#endif
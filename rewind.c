@@ -0,0 +1,174 @@
+#include <string.h>
+#include "rewind.h"
+
+// REWIND HISTORY
+// the live game state is the newest frame. every tick we store the XOR of the new
+// frame with the one before it, which is mostly zero words, as runs of changed
+// words. XOR works both ways, so applying the newest delta to the live state gives
+// the previous tick back. deltas go into a fixed ring of words; when it fills up
+// (or holds REWIND_MAX_FRAMES ticks) the oldest deltas are dropped.
+
+#define FRAME_WORDS (sizeof(GameFrame) / sizeof(uint32_t))
+#define RING_WORDS (REWIND_BUFFER_BYTES / sizeof(uint32_t))
+#define MAX_DELTA_WORDS (FRAME_WORDS * 2 + 1) // worst case: every other word changed
+
+_Static_assert(sizeof(GameFrame) % sizeof(uint32_t) == 0, "GameFrame must be whole words");
+
+static uint32_t ring[RING_WORDS];
+static uint32_t scratch[MAX_DELTA_WORDS];
+
+// record index (oldest..newest), a circular list of where each delta lives in the ring
+static uint32_t rec_start[REWIND_MAX_FRAMES];
+static uint32_t rec_len[REWIND_MAX_FRAMES];
+static int rec_first = 0; // oldest
+static int rec_count = 0;
+static size_t words_used = 0;
+
+// the last recorded frame (equal to the live state right after rewind_record)
+static GameFrame last;
+
+/******** FRAMES ********/
+
+void rewind_capture(GameFrame *f) {
+    memcpy(&f->world, &world, sizeof(World));
+    f->camera_y = camera_y;
+    f->image_x_pos = image_x_pos;
+    f->image_y_pos = image_y_pos;
+    f->player_facing_left = player_facing_left;
+}
+
+static void restore(const GameFrame *f) {
+    memcpy(&world, &f->world, sizeof(World));
+    camera_y = f->camera_y;
+    image_x_pos = f->image_x_pos;
+    image_y_pos = f->image_y_pos;
+    player_facing_left = f->player_facing_left;
+    first_lane_index = camera_y / LANE_HEIGHT;
+}
+
+/******** DELTAS ********/
+
+// XOR cur against prev into runs of (unchanged words << 16 | changed words) + the changes
+static size_t encode_delta(const uint32_t *cur, const uint32_t *prev, uint32_t *out) {
+    size_t n = 0;
+    size_t i = 0;
+    while (i < FRAME_WORDS) {
+        uint32_t skip = 0;
+        while (i < FRAME_WORDS && cur[i] == prev[i] && skip < 0xFFFF) {
+            i++;
+            skip++;
+        }
+        if (i == FRAME_WORDS) break;
+
+        size_t header = n++;
+        uint32_t count = 0;
+        while (i < FRAME_WORDS && cur[i] != prev[i] && count < 0xFFFF) {
+            out[n++] = cur[i] ^ prev[i];
+            i++;
+            count++;
+        }
+        out[header] = (skip << 16) | count;
+    }
+    return n;
+}
+
+static void apply_delta(uint32_t *frame, const uint32_t *delta, size_t len) {
+    size_t i = 0;
+    size_t k = 0;
+    while (k < len) {
+        uint32_t header = delta[k++];
+        i += header >> 16;
+        uint32_t count = header & 0xFFFF;
+        for (uint32_t c = 0; c < count; c++) {
+            frame[i++] ^= delta[k++];
+        }
+    }
+}
+
+/******** RING ********/
+
+static int rec_slot(int nth) {
+    return (rec_first + nth) % REWIND_MAX_FRAMES;
+}
+
+static void drop_oldest(void) {
+    words_used -= rec_len[rec_first];
+    rec_first = rec_slot(1);
+    rec_count--;
+}
+
+static int overlaps(uint32_t a, uint32_t a_len, uint32_t b, uint32_t b_len) {
+    return a < b + b_len && b < a + a_len;
+}
+
+// copy a delta into the ring after the newest one, evicting the oldest as needed
+static void push_delta(const uint32_t *delta, uint32_t len) {
+    if (len > RING_WORDS) {
+        // cannot happen with sane budgets; history just restarts
+        rec_count = 0;
+        words_used = 0;
+        return;
+    }
+
+    uint32_t pos = 0;
+    if (rec_count > 0) {
+        int newest = rec_slot(rec_count - 1);
+        pos = rec_start[newest] + rec_len[newest];
+    }
+    if (pos + len > RING_WORDS) {
+        // records never straddle the end. the ones still past pos are what is left
+        // of the lap before, older than everything at the start of the ring, so
+        // they go first and the oldest is then the one the new delta runs into
+        while (rec_count > 0 && rec_start[rec_first] >= pos) drop_oldest();
+        pos = 0;
+    }
+
+    if (rec_count == REWIND_MAX_FRAMES) drop_oldest();
+    while (rec_count > 0 && overlaps(rec_start[rec_first], rec_len[rec_first], pos, len)) {
+        drop_oldest();
+    }
+
+    int slot = rec_slot(rec_count);
+    rec_start[slot] = pos;
+    rec_len[slot] = len;
+    rec_count++;
+    words_used += len;
+    memcpy(&ring[pos], delta, len * sizeof(uint32_t));
+}
+
+/******** API ********/
+
+void rewind_reset(void) {
+    rec_first = 0;
+    rec_count = 0;
+    words_used = 0;
+    rewind_capture(&last);
+}
+
+void rewind_record(void) {
+    GameFrame cur;
+    rewind_capture(&cur);
+    uint32_t len = (uint32_t)encode_delta((const uint32_t *)&cur, (const uint32_t *)&last, scratch);
+    push_delta(scratch, len);
+    last = cur;
+}
+
+int rewind_step(void) {
+    if (rec_count == 0) return 0;
+
+    int newest = rec_slot(rec_count - 1);
+    apply_delta((uint32_t *)&last, &ring[rec_start[newest]], rec_len[newest]);
+    words_used -= rec_len[newest];
+    rec_count--;
+
+    restore(&last);
+    return 1;
+}
+
+int rewind_frames(void) {
+    return rec_count;
+}
+
+size_t rewind_bytes_used(void) {
+    return words_used * sizeof(uint32_t);
+}
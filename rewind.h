@@ -0,0 +1,38 @@
+// rewind.h -- declarations for recording and scrubbing back through recent game state
+
+#include <stddef.h>
+#include "declarations.h"
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#define REWIND_SECONDS 10
+#define REWIND_MAX_FRAMES (REWIND_SECONDS * 60)  // ticks of history kept at most
+#define REWIND_BUFFER_BYTES (512 * 1024)         // memory budget for the deltas
+
+// everything needed to put the game back exactly as it was on a tick
+typedef struct {
+    World world;
+    int camera_y;
+    int image_x_pos;
+    int image_y_pos;
+    int player_facing_left;
+} GameFrame;
+
+// forget all history and start recording from the current state (new level, restart)
+void rewind_reset(void);
+
+// copy the current state into f
+void rewind_capture(GameFrame *f);
+
+// record the current state (call once per simulation tick)
+void rewind_record(void);
+
+// put the game back one recorded tick, returns 0 when there is no more history
+int rewind_step(void);
+
+// ticks of history currently available and bytes they occupy
+int rewind_frames(void);
+size_t rewind_bytes_used(void);
+
+#endif
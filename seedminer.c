@@ -0,0 +1,376 @@
+// seedminer.c -- offline tool that generates and simulates level seeds on every core,
+// keeps the ones the solver can cross, scores them, and writes the catalog the game maps
+//
+//   make seedminer
+//   ./seedminer -n 200000          (200k seeds per level, 1M total)
+//
+// the game keeps its whole simulation in globals, so workers are forked processes
+// (each with its own copy of the globals) that share a work-stealing queue and a
+// results table through an anonymous shared mapping.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "declarations.h"
+#include "vehicle.h"
+#include "level.h"
+#include "solver.h"
+#include "catalog.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define CHUNK_SEEDS 64   // seeds per unit of work
+#define MAX_WORKERS 256
+
+// each worker owns a range of chunks packed as (begin << 32 | end). the owner pops
+// from the front, thieves split off the back half, both with a single CAS
+typedef struct {
+    _Atomic uint64_t range;
+    char pad[56]; // one cache line per worker
+} WorkQueue;
+
+typedef struct {
+    WorkQueue queues[MAX_WORKERS];
+    _Atomic uint64_t seeds_done;
+    _Atomic uint64_t seeds_kept;
+    _Atomic uint64_t seeds_undecided; // the solver gave up on them (never without a budget)
+} Shared;
+
+static Shared *shared = NULL;
+static CatalogEntry *results = NULL; // one slot per (level, seed), written by whoever ran it
+static uint8_t *kept = NULL;
+
+static int num_workers = 1;
+static uint32_t seeds_per_level = 20000;
+static uint32_t base_seed = 1;
+static int sim_frames = 600;
+
+/******** WORK STEALING ********/
+
+static uint64_t pack(uint32_t begin, uint32_t end) {
+    return ((uint64_t)begin << 32) | end;
+}
+
+// take the next chunk from our own queue, -1 if empty
+static int64_t pop_own(WorkQueue *q) {
+    uint64_t r = atomic_load(&q->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)(r >> 32), end = (uint32_t)r;
+        if (begin >= end) return -1;
+        if (atomic_compare_exchange_weak(&q->range, &r, pack(begin + 1, end))) return begin;
+    }
+}
+
+// move the back half of some other worker's range into ours, 0 if everyone is dry
+static int steal(int self) {
+    for (int k = 1; k < num_workers; k++) {
+        WorkQueue *victim = &shared->queues[(self + k) % num_workers];
+        uint64_t r = atomic_load(&victim->range);
+        for (;;) {
+            uint32_t begin = (uint32_t)(r >> 32), end = (uint32_t)r;
+            if (begin >= end) break;
+            uint32_t mid = begin + (end - begin) / 2;
+            if (atomic_compare_exchange_weak(&victim->range, &r, pack(begin, mid))) {
+                atomic_store(&shared->queues[self].range, pack(mid, end));
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/******** SCORING ********/
+
+// average share of road (non-sidewalk) pixels covered by vehicles this frame
+static float road_coverage(void) {
+    int road_lanes = total_lanes_current - 4;
+    if (road_lanes <= 0) return 0.0f;
+
+    long covered = 0;
+    for (int i = 0; i < MAX_CARS; i++) {
+        if (world.cars[i].active) covered += car_width;
+    }
+    for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
+        if (world.specials[i].active) covered += special_w[world.specials[i].type];
+    }
+    for (int i = 0; i < MAX_TOTAL_LANES; i++) {
+        if (world.trains[i].active) covered += train_width;
+    }
+    return (float)covered / (float)(road_lanes * screen_width);
+}
+
+// the solver without the game's time budget, so whether a seed is kept does not depend
+// on how fast or busy this machine is
+static int solve(SolveResult *r) {
+    return solve_level(r, SOLVER_NO_BUDGET);
+}
+
+// build, verify, and simulate one seed; returns 1 and fills e if it is worth keeping,
+// 0 if it is not crossable, -1 if the solver could not tell
+static int mine_seed(int level_index, uint32_t seed, CatalogEntry *e) {
+    generate_level(level_index, seed);
+
+    SolveResult r;
+    int solvable = solve(&r);
+    if (solvable != 1) return solvable;
+    int worst_arrival = r.arrival_frame;
+    int tightest = r.min_free_cells;
+
+    // let traffic evolve and make sure the level stays crossable for a player who waits
+    float coverage = 0.0f;
+    for (int f = 1; f <= sim_frames; f++) {
+        update_cars();
+        update_trains();
+        update_specials();
+        coverage += road_coverage();
+
+        if (f == sim_frames / 2 || f == sim_frames) {
+            solvable = solve(&r);
+            if (solvable != 1) return solvable;
+            if (r.arrival_frame > worst_arrival) worst_arrival = r.arrival_frame;
+            if (r.min_free_cells < tightest) tightest = r.min_free_cells;
+        }
+    }
+    coverage /= (float)sim_frames;
+    if (coverage > 1.0f) coverage = 1.0f;
+
+    // difficulty: traffic density, how narrow the route gets, and how long you have to wait
+    int fastest = (total_lanes_current - 1) * SOLVER_STEP_FRAMES;
+    float wait = (float)(worst_arrival - fastest) / (float)fastest;
+    if (wait > 1.0f) wait = 1.0f;
+    float tight = 1.0f - (float)tightest / (float)r.num_cells;
+    float score = 0.5f * coverage + 0.3f * tight + 0.2f * wait;
+    if (score > 1.0f) score = 1.0f;
+
+    e->seed = seed;
+    e->level = (uint16_t)level_index;
+    e->difficulty = (uint16_t)(score * 65535.0f);
+    e->arrival_frame = (uint16_t)worst_arrival;
+    e->min_free_cells = (uint16_t)tightest;
+    e->density = (uint16_t)(coverage * 65535.0f);
+    e->reserved = 0;
+    return 1;
+}
+
+static void run_worker(int self) {
+    uint32_t progress_step = (NUM_LEVELS * seeds_per_level) / 20 + 1;
+
+    for (;;) {
+        int64_t chunk = pop_own(&shared->queues[self]);
+        if (chunk < 0) {
+            if (!steal(self)) return;
+            continue;
+        }
+
+        uint32_t first = (uint32_t)chunk * CHUNK_SEEDS;
+        uint32_t last = first + CHUNK_SEEDS;
+        if (last > NUM_LEVELS * seeds_per_level) last = NUM_LEVELS * seeds_per_level;
+
+        for (uint32_t item = first; item < last; item++) {
+            int level_index = item / seeds_per_level;
+            uint32_t seed = base_seed + item % seeds_per_level;
+            int mined = mine_seed(level_index, seed, &results[item]);
+            if (mined > 0) {
+                kept[item] = 1;
+                atomic_fetch_add(&shared->seeds_kept, 1);
+            } else if (mined < 0) {
+                atomic_fetch_add(&shared->seeds_undecided, 1);
+            }
+        }
+
+        uint64_t before = atomic_fetch_add(&shared->seeds_done, last - first);
+        if (self == 0 && (before / progress_step) != ((before + last - first) / progress_step)) {
+            fprintf(stderr, "  %llu / %u seeds\n", (unsigned long long)(before + last - first),
+                    NUM_LEVELS * seeds_per_level);
+        }
+    }
+}
+
+/******** OUTPUT ********/
+
+static int compare_entries(const void *a, const void *b) {
+    const CatalogEntry *x = a, *y = b;
+    if (x->level != y->level) return (int)x->level - (int)y->level;
+    if (x->difficulty != y->difficulty) return (int)x->difficulty - (int)y->difficulty;
+    return (x->seed > y->seed) - (x->seed < y->seed);
+}
+
+static int write_catalog(const char *path) {
+    uint32_t total = NUM_LEVELS * seeds_per_level;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < total; i++) {
+        if (kept[i]) results[count++] = results[i]; // compact in place
+    }
+    qsort(results, count, sizeof(CatalogEntry), compare_entries);
+
+    CatalogHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = CATALOG_MAGIC;
+    h.version = CATALOG_VERSION;
+    h.entry_count = count;
+    catalog_describe(&h);
+
+    // split each level's sorted run into equal difficulty buckets
+    uint32_t start = 0;
+    for (int level = 0; level < NUM_LEVELS; level++) {
+        uint32_t end = start;
+        while (end < count && results[end].level == level) end++;
+        uint32_t n = end - start;
+        for (int b = 0; b < CATALOG_BUCKETS; b++) {
+            uint32_t lo = start + (uint32_t)((uint64_t)n * b / CATALOG_BUCKETS);
+            uint32_t hi = start + (uint32_t)((uint64_t)n * (b + 1) / CATALOG_BUCKETS);
+            h.buckets[level][b].first = lo;
+            h.buckets[level][b].count = hi - lo;
+        }
+        printf("level %d: %u seeds kept\n", level + 1, n);
+        start = end;
+    }
+
+    // write next to the target and rename so the game never maps half a file
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+    if (fwrite(&h, sizeof(h), 1, f) != 1 ||
+        fwrite(results, sizeof(CatalogEntry), count, f) != count) {
+        perror("write catalog");
+        fclose(f);
+        return -1;
+    }
+    if (fclose(f) != 0 || rename(tmp, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+/******** SETUP ********/
+
+// generation only needs sprite sizes, not pixels (keep paths in sync with main.c)
+static int load_sizes(void) {
+    int n;
+    if (!stbi_info("assets/guy1.png", &img_width, &img_height, &n) ||
+        !stbi_info("assets/car1.png", &car_width, &car_height, &n) ||
+        !stbi_info("assets/T2.png", &train_width, &train_height, &n) ||
+        !stbi_info("assets/bus2.png", &special_w[BUS], &special_h[BUS], &n)) {
+        fprintf(stderr, "Error: could not read sprite sizes from assets/\n");
+        return -1;
+    }
+
+    // spawn_special_in_lane only checks that the bus sprite exists
+    static unsigned char present;
+    special_data[BUS] = &present;
+
+    const char *lane_files[] = {
+        "assets/bottom_lane.png",
+        "assets/middle_lane.png",
+        "assets/top_lane.png",
+        "assets/MBTA_lane.png",
+        "assets/street_top.png",
+        "assets/street_bottom.png"
+    };
+    for (int i = 0; i < 6; i++) {
+        int w, h;
+        if (stbi_info(lane_files[i], &w, &h, &n)) num_lane_types++;
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n seeds_per_level] [-j workers] [-s base_seed] [-f sim_frames]\n"
+            "          [-W screen_width] [-H screen_height] [-o output]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = CATALOG_PATH;
+    num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:j:s:f:W:H:o:h")) != -1) {
+        switch (opt) {
+            case 'n': seeds_per_level = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'j': num_workers = atoi(optarg); break;
+            case 's': base_seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'f': sim_frames = atoi(optarg); break;
+            case 'W': screen_width = atoi(optarg); break;
+            case 'H': screen_height = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > MAX_WORKERS) num_workers = MAX_WORKERS;
+    if (sim_frames < 2) sim_frames = 2;
+    if (seeds_per_level == 0 || (uint64_t)seeds_per_level * NUM_LEVELS > 0xFFFFFFFFULL / 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (load_sizes() != 0) return 1;
+
+    uint32_t total = NUM_LEVELS * seeds_per_level;
+    uint32_t chunks = (total + CHUNK_SEEDS - 1) / CHUNK_SEEDS;
+
+    shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    results = mmap(NULL, (size_t)total * sizeof(CatalogEntry), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    kept = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED || results == MAP_FAILED || kept == MAP_FAILED) {
+        perror("mmap shared tables");
+        return 1;
+    }
+
+    // deal the chunks out evenly, stealing evens out the slow ones
+    for (int w = 0; w < num_workers; w++) {
+        uint32_t begin = (uint32_t)((uint64_t)chunks * w / num_workers);
+        uint32_t end = (uint32_t)((uint64_t)chunks * (w + 1) / num_workers);
+        atomic_store(&shared->queues[w].range, pack(begin, end));
+    }
+
+    printf("mining %u seeds (%u per level) on %d workers, %d frames each\n",
+           total, seeds_per_level, num_workers, sim_frames);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (int w = 1; w < num_workers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            run_worker(w);
+            _exit(0);
+        }
+    }
+    run_worker(0);
+    while (wait(NULL) > 0) {}
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%llu of %u seeds kept in %.1f s (%.0f seeds/s)\n",
+           (unsigned long long)atomic_load(&shared->seeds_kept), total, secs, total / secs);
+    uint64_t undecided = atomic_load(&shared->seeds_undecided);
+    if (undecided) {
+        // not uncrossable, just not known to be crossable: left out, but not silently
+        fprintf(stderr, "Warning: the solver gave up on %llu seeds, they are not in the catalog\n",
+                (unsigned long long)undecided);
+    }
+
+    if (write_catalog(out_path) != 0) return 1;
+    printf("wrote %s\n", out_path);
+    return 0;
+}
@@ -0,0 +1,294 @@
+#include <string.h>
+#include <time.h>
+#include "solver.h"
+#include "vehicle.h"
+#include "level.h"
+
+// LEVEL SOLVABILITY CHECK
+// the player is modelled as making at most one move every SOLVER_STEP_FRAMES frames.
+// the level's traffic is simulated forward one step ahead of the search (including the
+// vehicles it will spawn; parked trains stay put forever) and rasterized into a
+// per-(step, lane) bitmask of blocked player x positions. a breadth-first search over
+// those bitmasks finds the earliest step the top sidewalk is reached.
+
+/******** STATE ********/
+// shared by all threads: only one level is solved at a time (init_level joins the
+// level prep thread before it solves anything itself)
+
+// every x the player can stand on (MOVE_STEP hops from the start, clamped to the screen)
+static int cell_x[SOLVER_MAX_CELLS];
+static int cell_left[SOLVER_MAX_CELLS];
+static int cell_right[SOLVER_MAX_CELLS];
+static int num_cells = 0;
+
+// blocked[t][lane] bit c = standing on cell c in this lane during step t is a collision
+static uint64_t blocked[SOLVER_MAX_STEPS][MAX_TOTAL_LANES];
+static uint64_t parked[MAX_TOTAL_LANES]; // parked trains block the same cells every step
+static uint64_t reach[SOLVER_MAX_STEPS][MAX_TOTAL_LANES];
+
+/******** HELPERS ********/
+
+static long elapsed_us_since(const struct timespec *t0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - t0->tv_sec) * 1000000L + (now.tv_nsec - t0->tv_nsec) / 1000;
+}
+
+static uint64_t bits_below(int n) {
+    return n >= 64 ? ~0ULL : ((1ULL << n) - 1);
+}
+
+static int find_cell(int x) {
+    for (int c = 0; c < num_cells; c++) {
+        if (cell_x[c] == x) return c;
+    }
+    return -1;
+}
+
+static int clamp_player_x(int x) {
+    int max_x = screen_width - img_width;
+    if (x > max_x) x = max_x;
+    if (x < 0) x = 0;
+    return x;
+}
+
+// collect the reachable x positions (sorted) and their left/right neighbours
+static void build_cells(int start_x) {
+    num_cells = 0;
+    cell_x[num_cells++] = clamp_player_x(start_x);
+
+    for (int head = 0; head < num_cells; head++) {
+        int hops[2] = { cell_x[head] - MOVE_STEP, cell_x[head] + MOVE_STEP };
+        for (int k = 0; k < 2; k++) {
+            int nx = clamp_player_x(hops[k]);
+            if (find_cell(nx) < 0 && num_cells < SOLVER_MAX_CELLS) {
+                cell_x[num_cells++] = nx;
+            }
+        }
+    }
+
+    // insertion sort so a vehicle span maps to a contiguous run of bits
+    for (int i = 1; i < num_cells; i++) {
+        int v = cell_x[i];
+        int j = i - 1;
+        while (j >= 0 && cell_x[j] > v) {
+            cell_x[j + 1] = cell_x[j];
+            j--;
+        }
+        cell_x[j + 1] = v;
+    }
+
+    for (int c = 0; c < num_cells; c++) {
+        int l = find_cell(clamp_player_x(cell_x[c] - MOVE_STEP));
+        int r = find_cell(clamp_player_x(cell_x[c] + MOVE_STEP));
+        // a hop that fell off the table (too many cells) just means "stay"
+        cell_left[c]  = (l < 0) ? c : l;
+        cell_right[c] = (r < 0) ? c : r;
+    }
+}
+
+// number of cells whose hitbox starts left of limit
+static int cells_below(int limit) {
+    int lo = 0, hi = num_cells;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cell_x[mid] + PLAYER_HITBOX_MARGIN < limit) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// cells whose player hitbox overlaps the horizontal span [vx, vx + vw)
+static uint64_t span_mask(int vx, int vw) {
+    int pw = img_width - 2 * PLAYER_HITBOX_MARGIN;
+    int lo = cells_below(vx - pw + 1); // hitbox ends at or before vx
+    int hi = cells_below(vx + vw);     // hitbox starts before the span ends
+    if (hi <= lo) return 0;
+    return bits_below(hi) & ~bits_below(lo);
+}
+
+// OR a blocked span into every lane whose player row overlaps [vy, vy + vh)
+static void mark(uint64_t *lanes, int lane_index, int vy, int vh, uint64_t mask) {
+    if (!mask) return;
+    for (int lane = lane_index - 1; lane <= lane_index + 1; lane++) {
+        if (lane < 0 || lane >= total_lanes_current) continue;
+        int py = player_lane_y(lane);
+        if (py < vy + vh && py + img_height > vy) {
+            lanes[lane] |= mask;
+        }
+    }
+}
+
+/******** PREDICTION ********/
+// the traffic is replayed with the game's own update functions (car following, spawns
+// from the game PRNG, train wrap-around) on the live world, which is one memcpy-able
+// block and is put back afterwards. so the prediction is exactly what the game will do
+// while the player crosses. every frame's hitboxes are OR-ed into the step it falls
+// in, and steps are only simulated as the search reaches them
+
+static World saved; // the world as it was before the replay
+
+// every moving vehicle's hitbox this frame
+static void mark_vehicles(uint64_t *lanes) {
+    for (int i = 0; i < MAX_CARS; i++) {
+        const Car *c = &world.cars[i];
+        if (!c->active) continue;
+        mark(lanes, c->lane_index, c->y, car_height, span_mask(c->x, car_width));
+    }
+
+    for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
+        const SpecialVehicle *sv = &world.specials[i];
+        if (!sv->active) continue;
+        mark(lanes, sv->lane_index, sv->y, special_h[sv->type],
+             span_mask(sv->x, special_w[sv->type]));
+    }
+
+    for (int i = 0; i < MAX_TOTAL_LANES; i++) {
+        const Train *t = &world.trains[i];
+        if (!t->active || !t->moving) continue;
+        mark(lanes, t->lane_index, t->y, train_height,
+             span_mask(t->x + TRAIN_HITBOX_MARGIN, train_width - 2 * TRAIN_HITBOX_MARGIN));
+    }
+}
+
+// simulate the frames of step t (t*K+1 .. (t+1)*K) in the game loop's update order
+static void predict_step(int t) {
+    memset(blocked[t], 0, sizeof(blocked[t]));
+    for (int f = 0; f < SOLVER_STEP_FRAMES; f++) {
+        update_cars();
+        update_trains();
+        update_specials();
+        mark_vehicles(blocked[t]);
+    }
+}
+
+static void predict_begin(void) {
+    memset(parked, 0, sizeof(parked));
+
+    // parked trains block the same cells at every step
+    for (int i = 0; i < MAX_TOTAL_LANES; i++) {
+        const Train *t = &world.trains[i];
+        if (!t->active || t->moving) continue;
+        mark(parked, t->lane_index, t->y, train_height,
+             span_mask(t->x + TRAIN_HITBOX_MARGIN, train_width - 2 * TRAIN_HITBOX_MARGIN));
+    }
+    memcpy(&saved, &world, sizeof(World));
+    predict_step(0);
+}
+
+static void predict_end(void) {
+    memcpy(&world, &saved, sizeof(World));
+}
+
+/******** SEARCH ********/
+
+static uint64_t spread(uint64_t m) {
+    uint64_t out = m;
+    while (m) {
+        int c = __builtin_ctzll(m);
+        m &= m - 1;
+        out |= (1ULL << cell_left[c]) | (1ULL << cell_right[c]);
+    }
+    return out;
+}
+
+static int free_cells(int t, int lane) {
+    uint64_t open = ~(blocked[t][lane] | parked[lane]) & bits_below(num_cells);
+    return __builtin_popcountll(open);
+}
+
+// walk back from the goal to find the fastest route's narrowest gap
+static int route_min_free_cells(int goal_step) {
+    int lane = 0;
+    int c = __builtin_ctzll(reach[goal_step][0]);
+    int narrowest = free_cells(goal_step, lane);
+
+    for (int t = goal_step; t > 0; t--) {
+        const uint64_t *prev = reach[t - 1];
+        uint64_t here = 1ULL << c;
+
+        if (prev[lane] & here) {
+            // stood still
+        } else if (lane + 1 < total_lanes_current && (prev[lane + 1] & here)) {
+            lane = lane + 1; // came up from below
+        } else if (lane > 0 && (prev[lane - 1] & here)) {
+            lane = lane - 1; // came down from above
+        } else {
+            // sidestepped within the lane
+            uint64_t m = prev[lane];
+            while (m) {
+                int from = __builtin_ctzll(m);
+                m &= m - 1;
+                if (cell_left[from] == c || cell_right[from] == c) {
+                    c = from;
+                    break;
+                }
+            }
+        }
+
+        int open = free_cells(t - 1, lane);
+        if (open < narrowest) narrowest = open;
+    }
+    return narrowest;
+}
+
+long solver_budget_us(int lanes) {
+    return (long)lanes * SOLVER_BUDGET_US_PER_LANE;
+}
+
+int solve_level(SolveResult *out, long budget_us) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    memset(out, 0, sizeof(*out));
+    out->arrival_frame = -1;
+
+    build_cells(image_x_pos);
+    predict_begin();
+    out->num_cells = num_cells;
+
+    int start_lane = image_y_pos / LANE_HEIGHT;
+    if (start_lane >= total_lanes_current) start_lane = total_lanes_current - 1;
+    int start_cell = find_cell(clamp_player_x(image_x_pos));
+
+    memset(reach[0], 0, sizeof(reach[0]));
+    reach[0][start_lane] = 1ULL << start_cell;
+    out->states = 1;
+
+    for (int t = 1; t < SOLVER_MAX_STEPS; t++) {
+        // stay well inside the frame budget of init_level (each step replays a few
+        // frames of traffic, so check every step)
+        if (budget_us > 0 && elapsed_us_since(&t0) > budget_us) {
+            out->solvable = -1;
+            break;
+        }
+
+        predict_step(t);
+        uint64_t any = 0;
+        for (int lane = 0; lane < total_lanes_current; lane++) {
+            // stand still, sidestep, step up from the lane below, or back down from above
+            uint64_t m = spread(reach[t - 1][lane]);
+            if (lane + 1 < total_lanes_current) m |= reach[t - 1][lane + 1];
+            if (lane > 0) m |= reach[t - 1][lane - 1];
+            m &= ~(blocked[t][lane] | parked[lane]);
+
+            reach[t][lane] = m;
+            out->states += __builtin_popcountll(m);
+            any |= m;
+        }
+
+        // everyone got run over
+        if (!any) break;
+
+        if (reach[t][0]) {
+            out->solvable = 1;
+            out->arrival_frame = t * SOLVER_STEP_FRAMES;
+            out->min_free_cells = route_min_free_cells(t);
+            break;
+        }
+    }
+
+    predict_end();
+    out->elapsed_us = elapsed_us_since(&t0);
+    return out->solvable;
+}
@@ -0,0 +1,35 @@
+// solver.h -- checks that a freshly generated level can actually be crossed
+
+#include "declarations.h"
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+// search settings
+#define SOLVER_STEP_FRAMES VERTICAL_MOVE_DELAY // frames per search step (one player move per step)
+#define SOLVER_MAX_STEPS 256    // search horizon in steps (~25 s at 60 fps)
+#define SOLVER_MAX_CELLS 64     // reachable player x positions, one bit each
+#define SOLVER_BUDGET_US_PER_LANE 1000 // in game: give up after this long per lane and trust the level
+#define SOLVER_NO_BUDGET 0      // offline: search the whole horizon however long it takes
+#define SOLVER_MAX_ATTEMPTS 8   // how many times init_level may regenerate a level
+
+typedef struct {
+    int solvable;       // 1 = safe route found, 0 = no route in horizon, -1 = out of time budget
+    int arrival_frame;  // earliest frame the player can reach the top sidewalk
+    int min_free_cells; // narrowest gap (in player x positions) the route squeezes through
+    int num_cells;      // player x positions per lane (for scaling min_free_cells)
+    int states;         // reachable (lane, x-cell, step) states expanded
+    long elapsed_us;    // time spent replaying traffic and searching
+} SolveResult;
+
+// search (lane, x-cell, tick) space against the traffic the game will actually run,
+// vehicles spawned later included, giving up after budget_us of wall clock time
+// (SOLVER_NO_BUDGET = never). the world is left as it was. returns out->solvable
+int solve_level(SolveResult *out, long budget_us);
+
+// the in-game budget for a level of this many lanes. the search is linear in lanes:
+// "./bench solve" measures it, ~30 us a lane at worst on a desktop x86, so a
+// cortex-a8 at about ten times that still has 3x headroom
+long solver_budget_us(int lanes);
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sprite.h"
+
+size_t sprite_storage(int width, int height, PixelFormat format) {
+    size_t count = (size_t)width * height;
+    return count * pixel_bytes(format) + count;
+}
+
+// rgb scaled by alpha, rounded, so blending is one multiply per channel
+static void premultiply(uint8_t *dst, const uint8_t *rgba, size_t n) {
+    for (size_t i = 0; i < n; i++, rgba += 4, dst += 4) {
+        unsigned a = rgba[3];
+        for (int c = 0; c < 3; c++) dst[c] = (uint8_t)((rgba[c] * a + 127) / 255);
+        dst[3] = (uint8_t)a;
+    }
+}
+
+#define PREMULTIPLY_CHUNK 256 // pixels converted per pass
+
+void sprite_convert(Sprite *s, const uint8_t *rgba, int width, int height, PixelFormat format,
+                    uint8_t *storage) {
+    size_t count = (size_t)width * height;
+    int bytes = pixel_bytes(format);
+    memset(s, 0, sizeof(*s));
+    s->width = width;
+    s->height = height;
+    s->format = format;
+    s->pixels = storage;
+    s->alpha = storage + count * bytes;
+
+    uint8_t chunk[PREMULTIPLY_CHUNK * 4];
+    for (size_t i = 0; i < count; i += PREMULTIPLY_CHUNK) {
+        size_t n = count - i < PREMULTIPLY_CHUNK ? count - i : PREMULTIPLY_CHUNK;
+        premultiply(chunk, rgba + i * 4, n);
+        pixel_convert_row(format, chunk, 4, s->pixels + i * bytes, (int)n);
+    }
+
+    // drawn pixels, and the box around them so drawing skips the transparent margin
+    int x0 = width, y0 = height, x1 = 0, y1 = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t i = (size_t)y * width + x;
+            s->alpha[i] = rgba[i * 4 + 3];
+            if (!s->alpha[i]) continue;
+            if (x < x0) x0 = x;
+            if (x >= x1) x1 = x + 1;
+            if (y < y0) y0 = y;
+            if (y >= y1) y1 = y + 1;
+        }
+    }
+    s->bounds = (x0 < x1) ? (SpriteRect){ x0, y0, x1 - x0, y1 - y0 } : (SpriteRect){ 0, 0, 0, 0 };
+}
+
+/******** INDEXED ********/
+
+// argb of image v at pixel i, transparent pixels all the same
+static uint32_t variant_key(const uint8_t *rgba, size_t i) {
+    const uint8_t *p = rgba + i * 4;
+    if (p[3] == 0) return 0;
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+// give every pixel the index of its combination of colours across the images. keys
+// (SPRITE_MAX_COLORS * count) gets the combinations, indices (if not NULL) the map.
+// returns the number of entries, -1 if they do not fit
+static int index_variants(const uint8_t *const *rgba, int count, int width, int height,
+                          uint32_t *keys, uint8_t *indices) {
+    int colors = 1; // entry 0: transparent everywhere
+    memset(keys, 0, sizeof(uint32_t) * count);
+    uint32_t key[SPRITE_MAX_VARIANTS];
+    size_t key_bytes = sizeof(uint32_t) * count;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        for (int v = 0; v < count; v++) key[v] = variant_key(rgba[v], i);
+
+        int k = 0;
+        while (k < colors && memcmp(&keys[k * count], key, key_bytes) != 0) k++;
+        if (k == colors) {
+            if (colors == SPRITE_MAX_COLORS) return -1;
+            memcpy(&keys[k * count], key, key_bytes);
+            colors++;
+        }
+        if (indices) indices[i] = (uint8_t)k;
+    }
+    return colors;
+}
+
+int sprite_variant_colors(const uint8_t *const *rgba, int count, int width, int height) {
+    if (count < 1 || count > SPRITE_MAX_VARIANTS) return -1;
+    uint32_t *keys = (uint32_t *)malloc(sizeof(uint32_t) * SPRITE_MAX_COLORS * count);
+    if (!keys) return -1;
+    int colors = index_variants(rgba, count, width, height, keys, NULL);
+    free(keys);
+    return colors;
+}
+
+size_t sprite_variant_storage(int count, int width, int height, int colors, PixelFormat format) {
+    return (size_t)count * colors * (pixel_bytes(format) + 1) + (size_t)width * height;
+}
+
+void sprite_convert_variants(Sprite *out, const uint8_t *const *rgba, int count, int width,
+                             int height, int colors, PixelFormat format, uint8_t *storage) {
+    // palettes first (they want alignment), then their alphas, then the shared map
+    size_t palette_bytes = (size_t)colors * pixel_bytes(format);
+    uint8_t *palettes = storage;
+    uint8_t *alphas = palettes + (size_t)count * palette_bytes;
+    uint8_t *indices = alphas + (size_t)count * colors;
+
+    uint32_t *keys = (uint32_t *)malloc(sizeof(uint32_t) * SPRITE_MAX_COLORS * count);
+    uint8_t *rgba_palette = (uint8_t *)malloc((size_t)colors * 4);
+    if (!keys || !rgba_palette) {
+        free(keys);
+        free(rgba_palette);
+        for (int v = 0; v < count; v++) memset(&out[v], 0, sizeof(Sprite));
+        return;
+    }
+    index_variants(rgba, count, width, height, keys, indices);
+
+    for (int v = 0; v < count; v++) {
+        Sprite *s = &out[v];
+        memset(s, 0, sizeof(*s));
+        s->width = width;
+        s->height = height;
+        s->format = format;
+        s->indices = indices;
+        s->palette = palettes + v * palette_bytes;
+        s->palette_alpha = alphas + (size_t)v * colors;
+
+        uint8_t *alpha = alphas + (size_t)v * colors;
+        for (int k = 0; k < colors; k++) {
+            uint32_t c = keys[k * count + v];
+            alpha[k] = (uint8_t)(c >> 24);
+            rgba_palette[k * 4] = (uint8_t)(c >> 16);
+            rgba_palette[k * 4 + 1] = (uint8_t)(c >> 8);
+            rgba_palette[k * 4 + 2] = (uint8_t)c;
+            rgba_palette[k * 4 + 3] = alpha[k];
+        }
+        premultiply(rgba_palette, rgba_palette, (size_t)colors);
+        pixel_convert_row(format, rgba_palette, 4, palettes + v * palette_bytes, colors);
+
+        int x0 = width, y0 = height, x1 = 0, y1 = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (!alpha[indices[(size_t)y * width + x]]) continue;
+                if (x < x0) x0 = x;
+                if (x >= x1) x1 = x + 1;
+                if (y < y0) y0 = y;
+                if (y >= y1) y1 = y + 1;
+            }
+        }
+        s->bounds = (x0 < x1) ? (SpriteRect){ x0, y0, x1 - x0, y1 - y0 } : (SpriteRect){ 0, 0, 0, 0 };
+    }
+    free(keys);
+    free(rgba_palette);
+}
+
+/******** DRAWING ********/
+
+// screen columns [*lo, *hi) and rows [*top, *bottom), relative to (x, y), that can hold
+// drawn pixels. mirrored, screen column x + i shows sprite column width - 1 - i
+static void drawn_span(const Sprite *s, int flip, int *lo, int *hi, int *top, int *bottom) {
+    *lo = flip ? s->width - s->bounds.x - s->bounds.w : s->bounds.x;
+    *hi = *lo + s->bounds.w;
+    *top = s->bounds.y;
+    *bottom = s->bounds.y + s->bounds.h;
+}
+
+int sprite_dirty(const Sprite *s, int x, int y, int flip) {
+    if ((!s->pixels && !s->indices) || s->bounds.w == 0) return 0;
+
+    int lo, hi, top, bottom;
+    drawn_span(s, flip, &lo, &hi, &top, &bottom);
+    int x0 = x + lo < 0 ? 0 : x + lo;
+    int x1 = x + hi > screen_width ? screen_width : x + hi;
+    int y0 = y + top < 0 ? 0 : y + top;
+    int y1 = y + bottom > screen_height ? screen_height : y + bottom;
+    if (x0 >= x1 || y0 >= y1) return 0;
+    framebuffer_dirty(x0, y0, x1 - x0, y1 - y0);
+    return 1;
+}
+
+// draw rows row_min .. row_max - 1 of a rows-high, screen-wide buffer (the back
+// buffer through framebuffer_row when buf is NULL)
+static void draw_rows(const Sprite *s, int x, int y, int flip, int row_min, int row_max,
+                      uint8_t *buf, size_t stride, int rows) {
+    if (!s->pixels && !s->indices) return;
+    if (row_min < 0) row_min = 0;
+    if (row_max > rows) row_max = rows;
+
+    // clip the drawn box once, then each row is a single kernel call
+    int lo, hi, top, bottom;
+    drawn_span(s, flip, &lo, &hi, &top, &bottom);
+    int x0 = x + lo < 0 ? -x : lo;
+    int x1 = x + hi > screen_width ? screen_width - x : hi;
+    int y0 = y + top < row_min ? row_min - y : top;
+    int y1 = y + bottom > row_max ? row_max - y : bottom;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    int bytes = pixel_bytes(s->format);
+    PixelBlitFn blit = pixel_blit_kernel(s->format);
+    PixelIndexedBlitFn blit_indexed = pixel_indexed_blit_kernel(s->format);
+    int step = flip ? -1 : 1;
+
+    for (int sy = y0; sy < y1; sy++) {
+        uint8_t *row = buf ? buf + (size_t)(y + sy) * stride : (uint8_t *)framebuffer_row(y + sy);
+        if (!row) continue;
+
+        int first = flip ? s->width - 1 - x0 : x0;
+        size_t src = (size_t)sy * s->width + first;
+        uint8_t *dst = row + (size_t)(x + x0) * bytes;
+        if (s->indices) {
+            blit_indexed(dst, s->indices + src, s->palette, s->palette_alpha, x1 - x0, step);
+        } else {
+            blit(dst, s->pixels + src * bytes, s->alpha + src, x1 - x0, step);
+        }
+    }
+}
+
+void sprite_draw_rows(const Sprite *s, int x, int y, int flip, int row_min, int row_max) {
+    draw_rows(s, x, y, flip, row_min, row_max, NULL, 0, screen_height);
+}
+
+void sprite_draw_to(const Sprite *s, uint8_t *buf, size_t stride, int rows, int x, int y,
+                    int flip) {
+    draw_rows(s, x, y, flip, 0, rows, buf, stride, rows);
+}
+
+void sprite_draw(const Sprite *s, int x, int y, int flip) {
+    if (sprite_dirty(s, x, y, flip)) {
+        sprite_draw_rows(s, x, y, flip, 0, screen_height);
+    }
+}
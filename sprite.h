@@ -0,0 +1,68 @@
+// sprite.h -- images converted to the display's pixel format at load, and drawing them
+
+#include <stddef.h>
+#include <stdint.h>
+#include "declarations.h"
+#include "pixel_format.h"
+
+#ifndef SPRITE_H
+#define SPRITE_H
+
+typedef struct {
+    int16_t x, y, w, h;
+} SpriteRect;
+
+typedef struct {
+    int width;
+    int height;
+    PixelFormat format;
+    uint8_t *pixels;   // width * height native pixels, premultiplied by their alpha
+    uint8_t *alpha;    // one byte per pixel, 0 = transparent .. 255 = opaque
+    SpriteRect bounds; // smallest rect holding every drawn pixel (w = 0 if none)
+
+    // recolourings of one shape share an index map and have a palette each; such a
+    // sprite has these instead of pixels and alpha
+    const uint8_t *indices;       // width * height palette indices
+    const uint8_t *palette;       // premultiplied colour per index, in format
+    const uint8_t *palette_alpha; // alpha per index
+} Sprite;
+
+#define SPRITE_MAX_COLORS 256  // palette entries, index 0 is transparent in every variant
+#define SPRITE_MAX_VARIANTS 16 // images sharing one index map
+
+// bytes of storage sprite_convert needs for a width x height sprite
+size_t sprite_storage(int width, int height, PixelFormat format);
+
+// convert rgba pixels into format, into storage (sprite_storage bytes, owned by the caller)
+void sprite_convert(Sprite *s, const uint8_t *rgba, int width, int height, PixelFormat format,
+                    uint8_t *storage);
+
+// palette entries count same-sized images need to share one index map (one entry per
+// distinct combination of their colours at a pixel), -1 if more than SPRITE_MAX_COLORS
+// or more than SPRITE_MAX_VARIANTS images
+int sprite_variant_colors(const uint8_t *const *rgba, int count, int width, int height);
+
+// bytes of storage sprite_convert_variants needs
+size_t sprite_variant_storage(int count, int width, int height, int colors, PixelFormat format);
+
+// convert count images into indexed sprites out[0 .. count - 1], sharing storage
+// (sprite_variant_storage bytes, owned by the caller)
+void sprite_convert_variants(Sprite *out, const uint8_t *const *rgba, int count, int width,
+                             int height, int colors, PixelFormat format, uint8_t *storage);
+
+// draw with the top left corner at screen (x, y), clipped to the screen.
+// flip = mirror left to right
+void sprite_draw(const Sprite *s, int x, int y, int flip);
+
+// the two halves of sprite_draw. sprite_dirty tells the display which screen rect is
+// about to change (0 = nothing on screen); sprite_draw_rows draws only the screen rows
+// row_min .. row_max - 1 and may run on several threads at once for disjoint rows
+int sprite_dirty(const Sprite *s, int x, int y, int flip);
+void sprite_draw_rows(const Sprite *s, int x, int y, int flip, int row_min, int row_max);
+
+// draw into an image of its own instead of the screen: rows rows of screen_width
+// pixels in the sprite's format, stride bytes apart (for prerendering)
+void sprite_draw_to(const Sprite *s, uint8_t *buf, size_t stride, int rows, int x, int y,
+                    int flip);
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include "upscale.h"
+#include "fb_copy.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// UPSCALING
+// the game always draws at its logical size; a bigger display gets that frame blown
+// up by a whole factor on the way out. each source row is expanded into a scratch
+// line (cached memory) and the scratch line is copied to its display rows, so the
+// display is only ever written, in long runs, which is what uncached/write-combined
+// framebuffer memory wants.
+
+static uint8_t *scratch[2] = { NULL, NULL };
+static size_t scratch_size = 0;
+
+static int ensure_scratch(size_t size) {
+    if (size <= scratch_size) return 0;
+    for (int i = 0; i < 2; i++) {
+        uint8_t *p = (uint8_t *)realloc(scratch[i], size);
+        if (!p) return -1;
+        scratch[i] = p;
+    }
+    scratch_size = size;
+    return 0;
+}
+
+int upscale_factor(int w, int h, int display_w, int display_h) {
+    int sx = display_w / w, sy = display_h / h;
+    int s = sx < sy ? sx : sy;
+    return s < 1 ? 1 : s;
+}
+
+/******** NEAREST ********/
+
+static void expand16(uint16_t *d, const uint16_t *s, int n, int scale) {
+    int i = 0;
+#ifdef __ARM_NEON
+    if (scale == 2) {
+        for (; i + 8 <= n; i += 8) {
+            uint16x8_t v = vld1q_u16(s + i);
+            uint16x8x2_t z = vzipq_u16(v, v);
+            vst1q_u16(d + 2 * i, z.val[0]);
+            vst1q_u16(d + 2 * i + 8, z.val[1]);
+        }
+    }
+#endif
+    if (scale == 2 && ((uintptr_t)d & 3) == 0) {
+        // a doubled pixel is one 32 bit store (both halves equal, so endian does not matter)
+        uint32_t *d32 = (uint32_t *)d;
+        for (; i < n; i++) d32[i] = s[i] * 0x10001u;
+        return;
+    }
+    for (; i < n; i++) {
+        for (int k = 0; k < scale; k++) d[i * scale + k] = s[i];
+    }
+}
+
+static void expand32(uint32_t *d, const uint32_t *s, int n, int scale) {
+    int i = 0;
+#ifdef __ARM_NEON
+    if (scale == 2) {
+        for (; i + 4 <= n; i += 4) {
+            uint32x4_t v = vld1q_u32(s + i);
+            uint32x4x2_t z = vzipq_u32(v, v);
+            vst1q_u32(d + 2 * i, z.val[0]);
+            vst1q_u32(d + 2 * i + 4, z.val[1]);
+        }
+    }
+#endif
+    if (scale == 2 && ((uintptr_t)d & 7) == 0) {
+        uint64_t *d64 = (uint64_t *)d;
+        for (; i < n; i++) d64[i] = s[i] * 0x100000001ull;
+        return;
+    }
+    for (; i < n; i++) {
+        for (int k = 0; k < scale; k++) d[i * scale + k] = s[i];
+    }
+}
+
+/******** SCALE2X ********/
+// each pixel E becomes four, taking the colour of a neighbour where two neighbours
+// agree along an edge:      B
+//                         D E F   ->   E0 E1
+//                           H          E2 E3
+
+#define DEFINE_SCALE2X(name, T)                                                          \
+static void name(T *d0, T *d1, const T *above, const T *row, const T *below, int n) {   \
+    for (int x = 0; x < n; x++) {                                                        \
+        T B = above[x], H = below[x], E = row[x];                                        \
+        T D = row[x > 0 ? x - 1 : x];                                                    \
+        T F = row[x < n - 1 ? x + 1 : x];                                                \
+        if (B != H && D != F) {                                                          \
+            d0[2 * x]     = (D == B) ? D : E;                                            \
+            d0[2 * x + 1] = (B == F) ? F : E;                                            \
+            d1[2 * x]     = (D == H) ? D : E;                                            \
+            d1[2 * x + 1] = (H == F) ? F : E;                                            \
+        } else {                                                                         \
+            d0[2 * x] = d0[2 * x + 1] = d1[2 * x] = d1[2 * x + 1] = E;                   \
+        }                                                                                \
+    }                                                                                    \
+}
+
+DEFINE_SCALE2X(scale2x16, uint16_t)
+DEFINE_SCALE2X(scale2x32, uint32_t)
+
+/******** FRAME ********/
+
+void upscale_frame(const uint8_t *src, size_t src_stride, int w, int h, int bytes,
+                   int scale, UpscaleFilter filter, UpscaleRowFn dst_row) {
+    size_t out_bytes = (size_t)w * scale * bytes;
+
+    if (scale == 1) {
+        for (int y = 0; y < h; y++) {
+            void *d = dst_row(y);
+            if (d) fb_copy(d, src + (size_t)y * src_stride, out_bytes);
+        }
+        return;
+    }
+    if (ensure_scratch(out_bytes) != 0) return;
+
+    if (filter == UPSCALE_SCALE2X && scale == 2) {
+        for (int y = 0; y < h; y++) {
+            const uint8_t *row = src + (size_t)y * src_stride;
+            const uint8_t *above = y > 0 ? row - src_stride : row;
+            const uint8_t *below = y < h - 1 ? row + src_stride : row;
+            if (bytes == 2) {
+                scale2x16((uint16_t *)scratch[0], (uint16_t *)scratch[1], (const uint16_t *)above,
+                          (const uint16_t *)row, (const uint16_t *)below, w);
+            } else {
+                scale2x32((uint32_t *)scratch[0], (uint32_t *)scratch[1], (const uint32_t *)above,
+                          (const uint32_t *)row, (const uint32_t *)below, w);
+            }
+            for (int k = 0; k < 2; k++) {
+                void *d = dst_row(y * 2 + k);
+                if (d) fb_copy(d, scratch[k], out_bytes);
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t *row = src + (size_t)y * src_stride;
+        if (bytes == 2) {
+            expand16((uint16_t *)scratch[0], (const uint16_t *)row, w, scale);
+        } else {
+            expand32((uint32_t *)scratch[0], (const uint32_t *)row, w, scale);
+        }
+        for (int k = 0; k < scale; k++) {
+            void *d = dst_row(y * scale + k);
+            if (d) fb_copy(d, scratch[0], out_bytes);
+        }
+    }
+}
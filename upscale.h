@@ -0,0 +1,27 @@
+// upscale.h -- integer upscaling of the logical frame into a bigger display
+
+#include <stddef.h>
+#include <stdint.h>
+#include "declarations.h"
+
+#ifndef UPSCALE_H
+#define UPSCALE_H
+
+typedef enum {
+    UPSCALE_NEAREST, // every pixel becomes a scale x scale block
+    UPSCALE_SCALE2X, // edge-directed 2x (falls back to nearest at other scales)
+} UpscaleFilter;
+
+// display row y (0 .. h * scale - 1) of the picture, already offset to its left edge
+typedef void *(*UpscaleRowFn)(int y);
+
+// blow up h rows of w pixels (bytes per pixel 2 or 4, src_stride bytes apart) by
+// scale into the rows dst_row hands out. each display row is written once, never
+// read, so dst may be uncached framebuffer memory
+void upscale_frame(const uint8_t *src, size_t src_stride, int w, int h, int bytes,
+                   int scale, UpscaleFilter filter, UpscaleRowFn dst_row);
+
+// largest whole factor that fits w x h into display_w x display_h (at least 1)
+int upscale_factor(int w, int h, int display_w, int display_h);
+
+#endif
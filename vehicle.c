@@ -1,3 +1,5 @@
+#include <string.h>
+#include <math.h>
 #include "vehicle.h"
 #include "declarations.h"
 
@@ -8,21 +10,37 @@
 // remove all active cars
 void reset_cars(void) {
     for (int i = 0; i < MAX_CARS; i++) {
-        cars[i].active = 0;
+        world.cars[i].active = 0;
     }
 }
 
 // remove active trains
 void reset_trains(void) { 
     for (int i = 0; i < MAX_TOTAL_LANES; i++) {
-        trains[i].active = 0;
+        world.trains[i].active = 0;
     }
 }
 
 // remove active special vehicles
 void reset_specials(void) { 
     for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
-        specials[i].active = 0;
+        world.specials[i].active = 0;
+    }
+}
+
+/******** STATIC OBSTACLES ********/
+
+SIM_STATE StaticObstacle static_obstacles[MAX_TOTAL_LANES];
+
+void build_static_obstacles(void) {
+    memset(static_obstacles, 0, sizeof(static_obstacles));
+    for (int i = 0; i < MAX_TOTAL_LANES; i++) {
+        const Train *t = &world.trains[i];
+        if (!t->active || t->moving) continue;
+        if (t->lane_index < 0 || t->lane_index >= MAX_TOTAL_LANES) continue;
+        static_obstacles[t->lane_index] = (StaticObstacle){
+            t->x + TRAIN_HITBOX_MARGIN, t->y, train_width - 2 * TRAIN_HITBOX_MARGIN, train_height
+        };
     }
 }
 
@@ -31,8 +49,7 @@ void reset_specials(void) {
 // check for collisions with cars, trains, and special vehicles (returns 1 if collision is detected)
 int check_car_collisions(void) {
     // player hitbox
-    //const int p_margin_x = 4;
-    const int p_margin_x = 16;
+    const int p_margin_x = PLAYER_HITBOX_MARGIN;
 
     int px = image_x_pos + p_margin_x;
     int py = image_y_pos;
@@ -42,11 +59,11 @@ int check_car_collisions(void) {
     // check each car
     for (int i = 0; i < MAX_CARS; i++) {
         // skip inactive ones
-        if (!cars[i].active) continue;
+        if (!world.cars[i].active) continue;
 
         // car hitbox
-        int cx = cars[i].x;
-        int cy = cars[i].y;
+        int cx = world.cars[i].x;
+        int cy = world.cars[i].y;
         int cw = car_width;
         int ch = car_height;
 
@@ -59,16 +76,16 @@ int check_car_collisions(void) {
     }
 
     // add extra margin for train hitbox
-    const int t_margin_x = 4;
+    const int t_margin_x = TRAIN_HITBOX_MARGIN;
 
-    // check each train
+    // check each moving train
     for (int i = 0; i < MAX_TOTAL_LANES; i++) {
-        // skip inactive ones
-        if (!trains[i].active) continue;
+        // skip inactive and parked ones
+        if (!world.trains[i].active || !world.trains[i].moving) continue;
 
         // train hitbox
-        int tx = trains[i].x + t_margin_x;
-        int ty = trains[i].y;
+        int tx = world.trains[i].x + t_margin_x;
+        int ty = world.trains[i].y;
         int tw = train_width - 2 * t_margin_x;
         int th = train_height;
 
@@ -80,10 +97,27 @@ int check_car_collisions(void) {
         if (overlap) return 1;
     }
 
+    // parked trains: only the lanes the player is in (and their neighbours, in case an
+    // obstacle hangs over its lane)
+    int lane_lo = py / LANE_HEIGHT - 1;
+    int lane_hi = (py + ph - 1) / LANE_HEIGHT + 1;
+    if (lane_lo < 0) lane_lo = 0;
+    if (lane_hi > MAX_TOTAL_LANES - 1) lane_hi = MAX_TOTAL_LANES - 1;
+    for (int lane = lane_lo; lane <= lane_hi; lane++) {
+        const StaticObstacle *o = &static_obstacles[lane];
+        if (o->w == 0) continue;
+
+        int overlap = (px < o->x + o->w) &&
+            (px + pw > o->x) &&
+            (py < o->y + o->h) &&
+            (py + ph > o->y);
+        if (overlap) return 1;
+    }
+
     // check special vehicles (bus, bike, scooter)
     for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
-        if (!specials[i].active) continue;
-        SpecialVehicle* sv = &specials[i];
+        if (!world.specials[i].active) continue;
+        SpecialVehicle* sv = &world.specials[i];
         int w = special_w[sv->type];
         int h = special_h[sv->type];
 
@@ -101,117 +135,238 @@ int check_car_collisions(void) {
     return 0;
 }
 
-void update_cars(void) {
-    // update position of existing cars
-    for (int i = 0; i < MAX_CARS; i++) {
-        if (!cars[i].active) continue;
-        cars[i].x += cars[i].dir * cars[i].speed;
-        if (cars[i].x > screen_width || cars[i].x < -car_width) {
-            cars[i].active = 0;
-        }
+/******** CAR FOLLOWING ********/
+// cars and special vehicles share lanes, so they move together with the intelligent
+// driver model (IDM). each frame the active vehicles are bucketed by lane (counting
+// sort) and ordered front to back, so every follower's leader is simply the slot
+// before it. the model itself then runs as flat branch-free loops over those slots,
+// with divisions replaced by reciprocal tables. everything is O(vehicles).
+
+#define FIX_ONE (1 << FIX_SHIFT)
+#define FIX(v) ((int)((v) * FIX_ONE))
+
+#define MAX_ROAD_VEHICLES (MAX_CARS + MAX_SPECIAL_VEHICLES)
+#define GAP_TABLE_SIZE 1024   // gaps are clamped to this many px
+#define SPEED_TABLE_SIZE 32   // desired speeds are clamped to this many px per frame
+#define MAX_GAP_RATIO FIX(64) // caps (s*/s) so its square cannot overflow
+
+// per vehicle kind driving style (fixed point; time in frames)
+typedef struct {
+    int accel;   // max acceleration, px/frame^2
+    int decel;   // comfortable braking, px/frame^2
+    int min_gap; // bumper gap when stopped, px
+    int headway; // desired time gap to the leader, frames
+} DriverParams;
+
+static const DriverParams car_driver = { FIX(0.10), FIX(0.20), FIX(8), 10 };
+
+static const DriverParams special_driver[TYPE_COUNT] = {
+    [BUS]     = { FIX(0.06), FIX(0.15), FIX(12), 14 }, // sluggish, keeps its distance
+    [BIKE]    = { FIX(0.15), FIX(0.30), FIX(4),  6 },
+    [SCOOTER] = { FIX(0.20), FIX(0.30), FIX(4),  5 },
+};
+
+// reciprocal tables (1/x in 1/65536 units) so the model needs no division. these and
+// the scratch arrays below are per thread like the world they are built from
+static SIM_STATE int inv_gap[GAP_TABLE_SIZE];
+static SIM_STATE int inv_speed[SPEED_TABLE_SIZE];
+// 1 / (2 sqrt(accel * decel)) per driver, fixed point
+static SIM_STATE int car_brake_k;
+static SIM_STATE int special_brake_k[TYPE_COUNT];
+static SIM_STATE int tables_ready = 0;
+
+// one road vehicle, bucketed by lane
+typedef struct {
+    int ref;   // car index, or MAX_CARS + special index
+    int lane;
+    int dir;
+    int front; // leading bumper measured along the direction of travel (fixed point)
+} RoadSlot;
+
+static SIM_STATE RoadSlot slots[MAX_ROAD_VEHICLES];
+static SIM_STATE RoadSlot sorted[MAX_ROAD_VEHICLES];
+static SIM_STATE int lane_first[MAX_TOTAL_LANES + 1];
+
+// structure-of-arrays for the model, in sorted (leader first) order
+static SIM_STATE int len[MAX_ROAD_VEHICLES];       // body length
+static SIM_STATE int vel[MAX_ROAD_VEHICLES];       // current speed
+static SIM_STATE int inv_v0[MAX_ROAD_VEHICLES];    // 1 / desired speed
+static SIM_STATE int accel[MAX_ROAD_VEHICLES];
+static SIM_STATE int min_gap[MAX_ROAD_VEHICLES];
+static SIM_STATE int headway[MAX_ROAD_VEHICLES];
+static SIM_STATE int brake_k[MAX_ROAD_VEHICLES];   // 1 / (2 sqrt(accel * decel))
+static SIM_STATE int gap[MAX_ROAD_VEHICLES];       // bumper gap to the leader
+static SIM_STATE int closing[MAX_ROAD_VEHICLES];   // how fast we close in on the leader
+static SIM_STATE int new_vel[MAX_ROAD_VEHICLES];
+
+// 1 / (2 sqrt(a b)) in fixed point, from the driver's accel and decel
+static int brake_factor(const DriverParams *p) {
+    float ab = ((float)p->accel / FIX_ONE) * ((float)p->decel / FIX_ONE);
+    return (int)(FIX_ONE / (2.0f * sqrtf(ab)));
+}
+
+static void init_follow_tables(void) {
+    inv_gap[0] = 1 << 16;
+    for (int g = 1; g < GAP_TABLE_SIZE; g++) inv_gap[g] = (1 << 16) / g;
+    inv_speed[0] = 1 << 16;
+    for (int v = 1; v < SPEED_TABLE_SIZE; v++) inv_speed[v] = (1 << 16) / v;
+
+    car_brake_k = brake_factor(&car_driver);
+    for (int t = 0; t < TYPE_COUNT; t++) special_brake_k[t] = brake_factor(&special_driver[t]);
+    tables_ready = 1;
+}
+
+static int clamp_int(int v, int lo, int hi) {
+    v = v < lo ? lo : v;
+    return v > hi ? hi : v;
+}
+
+// the model's per-vehicle inputs, looked up once per frame
+static void load_slot(int k, const RoadSlot *slot) {
+    const DriverParams *p;
+    int speed;
+    if (slot->ref < MAX_CARS) {
+        Car *c = &world.cars[slot->ref];
+        p = &car_driver;
+        len[k] = car_width << FIX_SHIFT;
+        vel[k] = c->fv;
+        speed = c->speed;
+        brake_k[k] = car_brake_k;
+    } else {
+        SpecialVehicle *sv = &world.specials[slot->ref - MAX_CARS];
+        p = &special_driver[sv->type];
+        len[k] = special_w[sv->type] << FIX_SHIFT;
+        vel[k] = sv->fv;
+        speed = sv->speed;
+        brake_k[k] = special_brake_k[sv->type];
     }
+    inv_v0[k]  = inv_speed[clamp_int(speed, 1, SPEED_TABLE_SIZE - 1)];
+    accel[k]   = p->accel;
+    min_gap[k] = p->min_gap;
+    headway[k] = p->headway;
+}
 
-    // make cars slow down for bus & other special vehicles
-    const int tailgate_gap = car_width; // min distance
+// bucket active road vehicles by lane, leader first within each lane
+static int sort_road_vehicles(void) {
+    int n = 0;
     for (int i = 0; i < MAX_CARS; i++) {
-        if (!cars[i].active) continue;
-        Car* c = &cars[i];
-        
-        int best_dist = screen_width;
-        int best_speed = c->speed;
-        int best_front_x = 0;
-        int found = 0;
-
-        // look for nearest special vehicle ahead in this lane
-        for (int s = 0; s < MAX_SPECIAL_VEHICLES; s++) {
-            SpecialVehicle* sv = &specials[s];
-            if (!specials[s].active) continue;
-            if (sv->lane_index != c->lane_index) continue;
-            if (sv->dir != c->dir) continue;
-
-            int dist;
-            if (c->dir > 0) {
-                // moving right: leader ahead has larger x (use its left edge)
-                if (sv->x <= c->x) continue;
-                dist = sv->x - c->x;
-                if (dist < best_dist) {
-                    best_dist    = dist;
-                    best_speed   = sv->speed;
-                    best_front_x = sv->x;                     // leader "front" = left edge
-                    found        = 1;
-                }
-            } else {
-                // moving left: leader ahead is to the LEFT; use its FRONT = right edge
-                int leader_front = sv->x + special_w[sv->type];  // bus right edge
-                if (leader_front >= c->x) continue;              // must be strictly ahead
-                dist = c->x - leader_front;                      // gap: follower left - bus front
-                if (dist < best_dist) {
-                    best_dist    = dist;
-                    best_speed   = sv->speed;
-                    best_front_x = leader_front;                 // store *front* (right edge)
-                    found        = 1;
-                }
-            }
-
-        }
+        if (!world.cars[i].active) continue;
+        Car *c = &world.cars[i];
+        slots[n].ref = i;
+        slots[n].lane = c->lane_index;
+        slots[n].dir = c->dir;
+        slots[n].front = c->dir > 0 ? c->fx + (car_width << FIX_SHIFT) : -c->fx;
+        n++;
+    }
+    for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
+        if (!world.specials[i].active) continue;
+        SpecialVehicle *sv = &world.specials[i];
+        slots[n].ref = MAX_CARS + i;
+        slots[n].lane = sv->lane_index;
+        slots[n].dir = sv->dir;
+        slots[n].front = sv->dir > 0 ? sv->fx + (special_w[sv->type] << FIX_SHIFT) : -sv->fx;
+        n++;
+    }
 
-        // now look for nearest car ahead in this lane
-        for (int j = 0; j < MAX_CARS; j++) {
-            if (j == i) continue;
-            Car* c2 = &cars[j];
-            
-            if (!c2->active) continue;
-            if (c2->lane_index != c->lane_index) continue;
-            if (c2->dir != c->dir) continue;
-
-            int dist;
-
-            if (c->dir > 0) {
-                // moving right: leader ahead to the right, use left edge
-                if (c2->x <= c->x) continue;
-                dist = c2->x - c->x;
-                if (dist < best_dist) {
-                    best_dist    = dist;
-                    best_speed   = c2->speed;
-                    best_front_x = c2->x;                  // leader "front" = left edge
-                    found        = 1;
-                }
-            } else {
-                // moving left: leader ahead to the LEFT; FRONT = right edge
-                int leader_front = c2->x + car_width;      // car right edge
-                if (leader_front >= c->x) continue;        // must be to the left (ahead)
-                dist = c->x - leader_front;
-                if (dist < best_dist) {
-                    best_dist    = dist;
-                    best_speed   = c2->speed;
-                    best_front_x = leader_front;           // store *front* (right edge)
-                    found        = 1;
-                }
+    // counting sort by lane
+    int count[MAX_TOTAL_LANES] = {0};
+    for (int k = 0; k < n; k++) count[slots[k].lane]++;
+    lane_first[0] = 0;
+    for (int lane = 0; lane < MAX_TOTAL_LANES; lane++) {
+        lane_first[lane + 1] = lane_first[lane] + count[lane];
+    }
+    int fill[MAX_TOTAL_LANES];
+    memcpy(fill, lane_first, sizeof(fill));
+    for (int k = 0; k < n; k++) sorted[fill[slots[k].lane]++] = slots[k];
+
+    // order each lane front to back; lanes are nearly sorted from last frame
+    // (nobody overtakes), so insertion sort stays linear in practice
+    for (int lane = 0; lane < MAX_TOTAL_LANES; lane++) {
+        for (int k = lane_first[lane] + 1; k < lane_first[lane + 1]; k++) {
+            RoadSlot v = sorted[k];
+            int j = k - 1;
+            while (j >= lane_first[lane] &&
+                   (sorted[j].dir < v.dir || (sorted[j].dir == v.dir && sorted[j].front < v.front))) {
+                sorted[j + 1] = sorted[j];
+                j--;
             }
-
+            sorted[j + 1] = v;
         }
-        
+    }
+    return n;
+}
 
-        // match speed of the slowpoke
-        if (found && best_dist < tailgate_gap) {
+// move every car and special vehicle one frame along its lane
+static void follow_traffic(void) {
+    if (!tables_ready) init_follow_tables();
+
+    int n = sort_road_vehicles();
+    if (n == 0) return;
+
+    for (int k = 0; k < n; k++) load_slot(k, &sorted[k]);
+
+    // the vehicle in the slot ahead leads us if it shares our lane and direction,
+    // otherwise we see an empty road
+    const int free_road = (GAP_TABLE_SIZE - 1) << FIX_SHIFT;
+    gap[0] = free_road;
+    closing[0] = 0;
+    for (int k = 1; k < n; k++) {
+        int led = (sorted[k - 1].lane == sorted[k].lane) & (sorted[k - 1].dir == sorted[k].dir);
+        int bumper_gap = (sorted[k - 1].front - len[k - 1]) - sorted[k].front;
+        gap[k] = led ? bumper_gap : free_road;
+        closing[k] = led ? vel[k] - vel[k - 1] : 0;
+    }
 
-            if (c->dir > 0) {
-                // leader front = left edge; put follower so its right edge touches that:
-                // follower_left = leader_left - car_width
-                c->x = best_front_x - tailgate_gap;    // tailgate_gap == car_width
-            } else {
-                // leader front = right edge; put follower so its left edge touches that:
-                // follower_left = leader_right
-                c->x = best_front_x;
-            }
+    // IDM: a = accel * (1 - (v/v0)^4 - (s*/s)^2), s* = s0 + v*T + v*dv / (2 sqrt(a b))
+    for (int k = 0; k < n; k++) {
+        int v = vel[k];
+        int r = (int)(((int64_t)v * inv_v0[k]) >> 16);
+        int r2 = (r * r) >> FIX_SHIFT;
+        int r4 = (r2 * r2) >> FIX_SHIFT;
+
+        int64_t dyn = (int64_t)v * headway[k] +
+                      ((((int64_t)v * closing[k]) >> FIX_SHIFT) * brake_k[k] >> FIX_SHIFT);
+        dyn = dyn > 0 ? dyn : 0;
+        int64_t s_star = min_gap[k] + dyn;
+
+        int g = clamp_int(gap[k] >> FIX_SHIFT, 1, GAP_TABLE_SIZE - 1);
+        int64_t q = (s_star * inv_gap[g]) >> 16;
+        q = q < MAX_GAP_RATIO ? q : MAX_GAP_RATIO;
+        int q2 = (int)((q * q) >> FIX_SHIFT);
+
+        int a = (int)(((int64_t)accel[k] * (FIX_ONE - r4 - q2)) >> FIX_SHIFT);
+        int nv = v + a;
+        nv = nv > 0 ? nv : 0;
+        // never drive into the leader's bumper this frame
+        int room = gap[k] > 0 ? gap[k] : 0;
+        new_vel[k] = nv < room ? nv : room;
+    }
 
-            c->speed = best_speed;
+    // write back and retire vehicles that left the screen
+    for (int k = 0; k < n; k++) {
+        int ref = sorted[k].ref;
+        if (ref < MAX_CARS) {
+            Car *c = &world.cars[ref];
+            c->fv = new_vel[k];
+            c->fx += c->dir * new_vel[k];
+            c->x = c->fx >> FIX_SHIFT;
+            if (c->x > screen_width || c->x < -car_width) c->active = 0;
+        } else {
+            SpecialVehicle *sv = &world.specials[ref - MAX_CARS];
+            sv->fv = new_vel[k];
+            sv->fx += sv->dir * new_vel[k];
+            sv->x = sv->fx >> FIX_SHIFT;
+            if (sv->x > screen_width || sv->x < -special_w[sv->type]) sv->active = 0;
         }
-
     }
+}
+
+// move all road traffic and roll the dice for a car spawn
+void update_cars(void) {
+    follow_traffic();
 
-    frame_counter++;
-    if (frame_counter > 1000000) frame_counter = 0; // occasional reset
+    world.frame_counter++;
+    if (world.frame_counter > 1000000) world.frame_counter = 0; // occasional reset
 
     // spawnable lane range
     int index_min = 2;
@@ -221,7 +376,7 @@ void update_cars(void) {
     // count spawnable lanes (non-mbta)
     int spawnable_lanes = 0;
     for (int lane = index_min; lane <= index_max; lane++) {
-        if (mbta_lane_indices[lane] != 1) spawnable_lanes++;
+        if (world.mbta_lane_indices[lane] != 1) spawnable_lanes++;
     }
     if (spawnable_lanes <= 0) return;
 
@@ -238,11 +393,11 @@ void update_cars(void) {
     if (spawn_interval < 2) spawn_interval = 2;
 
     // spawn?
-    if (frame_counter % spawn_interval == 0) {
+    if (world.frame_counter % spawn_interval == 0) {
         for (int attempts = 0; attempts < 3; attempts++) {
-            int lane_index = index_min + rand() % (index_max - index_min + 1);
-            if (mbta_lane_indices[lane_index] == 1) continue; // skip rail
-            int dir = lane_direction[lane_index];
+            int lane_index = index_min + game_rand() % (index_max - index_min + 1);
+            if (world.mbta_lane_indices[lane_index] == 1) continue; // skip rail
+            int dir = world.lane_direction[lane_index];
             spawn_car_in_lane(lane_index, dir);
             break;
         }
@@ -251,7 +406,7 @@ void update_cars(void) {
 
 void update_trains(void) {
     for (int i = 0; i < MAX_TOTAL_LANES; i++) {
-        Train* t = &trains[i];
+        Train* t = &world.trains[i];
         // skip if parked or not active
         if (!t->active) continue;
         if (!t->moving) continue;
@@ -268,28 +423,14 @@ void update_trains(void) {
 }
 
 
-// update the bus positions and roll the dice for a spawn
+// roll the dice for a bus spawn (buses move with the cars in update_cars)
 void update_specials(void) {
-    // move existing ones
-    for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {                                                          
-        if (!specials[i].active) continue;
-
-        SpecialVehicle* sv = &specials[i];
-        int w = special_w[sv->type];
-
-        sv->x += sv->dir * sv->speed;
-        // check bounds
-        if (sv->x > screen_width || sv->x < -w) {
-            sv->active = 0;
-        }
-    }
-
     // spawn timing
-    special_frame_counter++;
-    if (special_frame_counter > 1000000) special_frame_counter = 0;
+    world.special_frame_counter++;
+    if (world.special_frame_counter > 1000000) world.special_frame_counter = 0;
 
     const int special_interval = 150;
-    if (special_frame_counter % special_interval != 0) return;
+    if (world.special_frame_counter % special_interval != 0) return;
 
     int index_min = 2;
     int index_max = total_lanes_current - 3;
@@ -297,10 +438,10 @@ void update_specials(void) {
 
     // only on non-MBTA road lanes, like cars
     for (int attempts = 0; attempts < 3; attempts++) {
-        int lane = index_min + rand() % (index_max - index_min + 1);
-        if (mbta_lane_indices[lane] == 1) continue;  // skip MBTA rails
+        int lane = index_min + game_rand() % (index_max - index_min + 1);
+        if (world.mbta_lane_indices[lane] == 1) continue;  // skip MBTA rails
 
-        int dir = lane_direction[lane];
+        int dir = world.lane_direction[lane];
         spawn_special_in_lane(lane, dir);
         break;
     }
@@ -316,19 +457,19 @@ void spawn_car_in_lane(int lane_index, int dir) {
     // check proximity to other cars
     for (int i = 0; i < MAX_CARS; i++) {
         // skip inactive cars
-        if (!cars[i].active) continue;
+        if (!world.cars[i].active) continue;
         // find the lane in question
-        if (cars[i].lane_index != lane_index) continue;
+        if (world.cars[i].lane_index != lane_index) continue;
 
         // check left edge proximity
         if (dir > 0) {
-            if (cars[i].x > -prox_gap && cars[i].x < prox_gap) {
+            if (world.cars[i].x > -prox_gap && world.cars[i].x < prox_gap) {
                 return; // skip bc too close
             }
         }
         // check right edge proximity
         else {
-            if (cars[i].x > screen_width - prox_gap && cars[i].x <= screen_width + prox_gap) {
+            if (world.cars[i].x > screen_width - prox_gap && world.cars[i].x <= screen_width + prox_gap) {
                 return; // skip bc too close
             }
         }
@@ -336,11 +477,11 @@ void spawn_car_in_lane(int lane_index, int dir) {
 
     // check proximity to special vehicles
     for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
-        if (!specials[i].active) continue;
-        if (specials[i].lane_index != lane_index) continue;
+        if (!world.specials[i].active) continue;
+        if (world.specials[i].lane_index != lane_index) continue;
 
-        int w = special_w[specials[i].type];
-        int sx = specials[i].x;
+        int w = special_w[world.specials[i].type];
+        int sx = world.specials[i].x;
 
         if (dir > 0) {
             if (sx > -w && sx < prox_gap) {
@@ -356,24 +497,26 @@ void spawn_car_in_lane(int lane_index, int dir) {
     // use next free slot
     for (int i = 0; i < MAX_CARS; i++) {
         // mark as active and set lane, direction, and speed
-        if (!cars[i].active) {
-            cars[i].active = 1;
-            cars[i].lane_index = lane_index;
-            cars[i].dir = dir;
-            cars[i].speed = car_speed;
+        if (!world.cars[i].active) {
+            world.cars[i].active = 1;
+            world.cars[i].lane_index = lane_index;
+            world.cars[i].dir = dir;
+            world.cars[i].speed = car_speed;
+            world.cars[i].fv = car_speed << FIX_SHIFT; // enter at cruising speed
 
             // randomly pick sprite (color)
-            cars[i].sprite_index = rand() % NUM_CAR_SPRITES;
+            world.cars[i].sprite_index = game_rand() % NUM_CAR_SPRITES;
 
             // center the car vertically in this lane
-            cars[i].y = lane_index * LANE_HEIGHT + ((LANE_HEIGHT - car_height) / 2);
+            world.cars[i].y = lane_index * LANE_HEIGHT + ((LANE_HEIGHT - car_height) / 2);
 
             // start offscreen on either side
             if (dir > 0) {
-                cars[i].x = -car_width;
+                world.cars[i].x = -car_width;
             } else {
-                cars[i].x = screen_width;
+                world.cars[i].x = screen_width;
             }
+            world.cars[i].fx = world.cars[i].x << FIX_SHIFT;
             return;
         }
     }
@@ -390,16 +533,16 @@ void spawn_special_in_lane(int lane_index, int dir) {
     // simple proximity check vs. other specials in same lane
     const int prox_gap = w;
     for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
-        if (!specials[i].active) continue;
-        if (specials[i].lane_index != lane_index) continue;
+        if (!world.specials[i].active) continue;
+        if (world.specials[i].lane_index != lane_index) continue;
 
         if (dir > 0) {
-            if (specials[i].x > -prox_gap && specials[i].x < prox_gap) {
+            if (world.specials[i].x > -prox_gap && world.specials[i].x < prox_gap) {
                 return;
             }
         } else {
-            if (specials[i].x > screen_width - prox_gap &&
-                specials[i].x < screen_width + prox_gap) {
+            if (world.specials[i].x > screen_width - prox_gap &&
+                world.specials[i].x < screen_width + prox_gap) {
                 return;
             }
         }
@@ -407,10 +550,10 @@ void spawn_special_in_lane(int lane_index, int dir) {
 
     // also proximity check against cars in this lane
     for (int i = 0; i < MAX_CARS; i++) {
-        if (!cars[i].active) continue;
-        if (cars[i].lane_index != lane_index) continue;
+        if (!world.cars[i].active) continue;
+        if (world.cars[i].lane_index != lane_index) continue;
 
-        int cx = cars[i].x;
+        int cx = world.cars[i].x;
 
         if (dir > 0) {
             if (cx > -prox_gap && cx < prox_gap) {
@@ -426,18 +569,20 @@ void spawn_special_in_lane(int lane_index, int dir) {
 
     // find free slot
     for (int i = 0; i < MAX_SPECIAL_VEHICLES; i++) {
-        if (!specials[i].active) {
-            specials[i].active     = 1;
-            specials[i].lane_index = lane_index;
-            //specials[i].dir        = dir;
-            specials[i].dir        = 1;
-            specials[i].type       = type;
-            specials[i].speed      = special_speed[type];
-
-            specials[i].y = lane_index * LANE_HEIGHT + ((LANE_HEIGHT - h) / 2);
-
-            if (dir > 0) specials[i].x = -w;
-            else specials[i].x = screen_width;
+        if (!world.specials[i].active) {
+            world.specials[i].active     = 1;
+            world.specials[i].lane_index = lane_index;
+            //world.specials[i].dir        = dir;
+            world.specials[i].dir        = 1;
+            world.specials[i].type       = type;
+            world.specials[i].speed      = special_speed[type];
+            world.specials[i].fv         = special_speed[type] << FIX_SHIFT;
+
+            world.specials[i].y = lane_index * LANE_HEIGHT + ((LANE_HEIGHT - h) / 2);
+
+            if (dir > 0) world.specials[i].x = -w;
+            else world.specials[i].x = screen_width;
+            world.specials[i].fx = world.specials[i].x << FIX_SHIFT;
 
             return;
         }
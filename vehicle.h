@@ -18,6 +18,18 @@ void update_cars(void);
 void update_trains(void);
 void update_specials(void);
 
+/******** STATIC OBSTACLES ********/
+// parked trains never move: they are drawn into the level background and collide
+// through this table, one hitbox per lane (w = 0 if the lane has none)
+typedef struct {
+    int x, y, w, h;
+} StaticObstacle;
+
+extern SIM_STATE StaticObstacle static_obstacles[MAX_TOTAL_LANES];
+
+// fill the table from the parked trains of the level just generated
+void build_static_obstacles(void);
+
 /******** RESET ********/
 // these functions remove all active instances of the vehicle type
 void reset_cars(void);